@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "address.h"
+
+/**
+ * Stores an IPv4 address as an IPv4-mapped IPv6 address
+ * @param address - *in6_addr: where the address is stored
+ * @param ipv4 - in_addr_t: address in network byte order
+ */
+void address_from_ipv4(struct in6_addr *address, in_addr_t ipv4) {
+    memset(address, 0, sizeof (struct in6_addr));
+    address->s6_addr[10] = 0xFF;
+    address->s6_addr[11] = 0xFF;
+    memcpy(&address->s6_addr[12], &ipv4, sizeof (in_addr_t));
+}
+
+bool address_is_ipv4(const struct in6_addr *address) {
+    return IN6_IS_ADDR_V4MAPPED(address);
+}
+
+/**
+ * @param address - *in6_addr: IPv4-mapped address
+ * @return IPv4 address in network byte order
+ */
+in_addr_t address_to_ipv4(const struct in6_addr *address) {
+    in_addr_t ipv4;
+
+    memcpy(&ipv4, &address->s6_addr[12], sizeof (in_addr_t));
+    return ipv4;
+}
+
+bool address_equal(const struct in6_addr *first, const struct in6_addr *second) {
+    return memcmp(first, second, sizeof (struct in6_addr)) == 0;
+}
+
+/**
+ * Tables take the low bits of the hash, so the last multiply is folded back onto them: alone, the low bits of a product
+ * only depend on the low bits of its operand, where a v4-mapped address keeps its constant ::ffff prefix
+ */
+uint32_t address_hash(const struct in6_addr *address) {
+    uint64_t high, low, hash;
+
+    memcpy(&high, &address->s6_addr[0], sizeof (high));
+    memcpy(&low, &address->s6_addr[8], sizeof (low));
+    hash = ((high * 0x9E3779B97F4A7C15ull) ^ low) * 0x9E3779B97F4A7C15ull;
+    return (uint32_t) (hash >> 32 ^ hash >> 51);
+}
+
+/**
+ * @param address
+ * @return last 64 bits of the address, as a host byte order number
+ */
+uint64_t address_low_bits(const struct in6_addr *address) {
+    uint64_t value = 0;
+
+    for (int i = 8; i < 16; i++)
+        value = value << 8 | address->s6_addr[i];
+    return value;
+}
+
+/**
+ * Replaces the last 64 bits of an address
+ * @param address
+ * @param value - uint64_t: host byte order number
+ */
+void address_set_low_bits(struct in6_addr *address, uint64_t value) {
+    for (int i = 15; i >= 8; i--, value >>= 8)
+        address->s6_addr[i] = (uint8_t) value;
+}
+
+/**
+ * Parses an IPv4 or an IPv6 address
+ * @param text - *char: address without a prefix length
+ * @param address - *in6_addr: where the address is stored
+ * @return True, if @param text is an address of either family
+ *         False, otherwise
+ */
+bool address_parse(const char *text, struct in6_addr *address) {
+    in_addr_t ipv4;
+
+    if (inet_pton(AF_INET, text, &ipv4) == 1) {
+        address_from_ipv4(address, ipv4);
+        return true;
+    }
+    return inet_pton(AF_INET6, text, address) == 1;
+}
+
+/**
+ * Checks allowed IPs as written in a config file: addresses of either family, each with an optional prefix length in
+ * the range of its family, separated by commas and optional spaces, e.g. "10.0.0.0/24, fd00::/64". Text from clients
+ * goes through it before it can reach a config file, so it can not carry anything else.
+ * @param text - *char
+ * @return True, if @param text is a non empty list of valid entries
+ *         False, otherwise
+ */
+bool address_valid_allowed_ips(const char *text) {
+    char entry[INET6_ADDRSTRLEN + 4];
+
+    do {
+        size_t length;
+        char *prefix, *end;
+        struct in6_addr address;
+
+        while (*text == ' ')
+            text++;
+        length = strcspn(text, ", ");
+        if (length == 0 || length >= sizeof (entry))
+            return false;
+        memcpy(entry, text, length);
+        entry[length] = '\0';
+        text += length;
+        while (*text == ' ')
+            text++;
+
+        prefix = strchr(entry, '/');
+        if (prefix != NULL)
+            *prefix++ = '\0';
+        if (!address_parse(entry, &address))
+            return false;
+        if (prefix != NULL) {
+            unsigned long prefix_length;
+
+            if (*prefix < '0' || *prefix > '9')
+                return false;
+            prefix_length = strtoul(prefix, &end, 10);
+            if (*end != '\0' || prefix_length > (address_is_ipv4(&address) ? 32ul : 128ul))
+                return false;
+        }
+    } while (*text++ == ',');
+
+    return text[-1] == '\0';
+}
+
+/**
+ * Formats an address in the notation of its family, IPv4-mapped addresses are written as IPv4
+ * @param address
+ * @param buffer - *char: at least INET6_ADDRSTRLEN bytes
+ * @param size - size_t: size of @param buffer
+ * @return @param buffer
+ */
+const char *address_format(const struct in6_addr *address, char *buffer, size_t size) {
+    if (address_is_ipv4(address))
+        return inet_ntop(AF_INET, &address->s6_addr[12], buffer, (socklen_t) size);
+    return inet_ntop(AF_INET6, address, buffer, (socklen_t) size);
+}
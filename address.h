@@ -0,0 +1,25 @@
+#ifndef DHCP_V1_ADDRESS_H
+#define DHCP_V1_ADDRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/*
+ * Leased addresses of both families are kept as struct in6_addr: an IPv4 address is stored IPv4-mapped (::ffff:a.b.c.d),
+ * so pools, indexes, leases and routes handle one type only.
+ */
+
+void address_from_ipv4(struct in6_addr *address, in_addr_t ipv4);
+bool address_is_ipv4(const struct in6_addr *address);
+in_addr_t address_to_ipv4(const struct in6_addr *address);
+bool address_equal(const struct in6_addr *first, const struct in6_addr *second);
+uint32_t address_hash(const struct in6_addr *address);
+uint64_t address_low_bits(const struct in6_addr *address);
+void address_set_low_bits(struct in6_addr *address, uint64_t value);
+bool address_parse(const char *text, struct in6_addr *address);
+bool address_valid_allowed_ips(const char *text);
+const char *address_format(const struct in6_addr *address, char *buffer, size_t size);
+
+#endif //DHCP_V1_ADDRESS_H
@@ -0,0 +1,373 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "address_pool.h"
+#include "address.h"
+
+static uint64_t offset_mask(const struct AddressPool *pool) {
+    return pool->offset_bits == 64 ? UINT64_MAX : ((uint64_t) 1 << pool->offset_bits) - 1;
+}
+
+static uint64_t offset_of(const struct AddressPool *pool, const struct in6_addr *address) {
+    return address_low_bits(address) & offset_mask(pool);
+}
+
+static void offset_to_address(const struct AddressPool *pool, uint64_t offset, struct in6_addr *address) {
+    *address = pool->network;
+    address_set_low_bits(address, address_low_bits(&pool->network) | offset);
+}
+
+/**
+ * Finds the shard whose range holds an offset
+ */
+static struct AddressShard *shard_of(const struct AddressPool *pool, uint64_t offset) {
+    uint32_t index;
+
+    if (pool->is_sparse)
+        return &pool->shards[pool->shard_bits == 64 ? 0 : offset >> pool->shard_bits];
+
+    index = (uint32_t) (offset * pool->shard_count / address_pool_size(pool));
+    while (index + 1 < pool->shard_count && offset >= pool->shards[index + 1].first)
+        index++;
+    while (offset < pool->shards[index].first)
+        index--;
+    return &pool->shards[index];
+}
+
+static bool shard_init(struct AddressPool *pool, struct AddressShard *shard, uint64_t first, uint64_t size) {
+    shard->first = first;
+    shard->size = size;
+    shard->owned = true;
+    pthread_mutex_init(&shard->lock, NULL);
+
+    if (pool->is_sparse)
+        return sparse_allocator_init(&shard->sparse, pool->shard_bits);
+    return allocator_init(&shard->dense, (uint32_t) size);
+}
+
+static void shard_destroy(struct AddressPool *pool, struct AddressShard *shard) {
+    if (pool->is_sparse)
+        sparse_allocator_destroy(&shard->sparse);
+    else
+        allocator_destroy(&shard->dense);
+    pthread_mutex_destroy(&shard->lock);
+}
+
+/**
+ * Number of offsets of the shard that are not allocated, the lock of the shard is held
+ */
+static uint64_t shard_free(const struct AddressPool *pool, const struct AddressShard *shard) {
+    return shard->size - (pool->is_sparse ? shard->sparse.used : shard->dense.used);
+}
+
+/**
+ * Allocates an offset of a shard
+ * @param pool
+ * @param shard
+ * @param offset - *uint64_t: where the offset, relative to the pool, is stored
+ * @return True, if the shard had a free offset
+ *         False, otherwise
+ */
+static bool shard_allocate(struct AddressPool *pool, struct AddressShard *shard, uint64_t *offset) {
+    uint32_t dense_offset;
+    bool allocated;
+
+    pthread_mutex_lock(&shard->lock);
+    if (pool->is_sparse) {
+        allocated = sparse_allocator_allocate(&shard->sparse, offset);
+    } else {
+        allocated = allocator_allocate(&shard->dense, &dense_offset);
+        *offset = dense_offset;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    *offset += shard->first;
+    return allocated;
+}
+
+static bool reserve_offset(struct AddressPool *pool, uint64_t offset) {
+    struct AddressShard *shard = shard_of(pool, offset);
+    bool reserved;
+
+    pthread_mutex_lock(&shard->lock);
+    if (pool->is_sparse)
+        reserved = sparse_allocator_reserve(&shard->sparse, offset - shard->first);
+    else
+        reserved = allocator_reserve(&shard->dense, (uint32_t) (offset - shard->first));
+    pthread_mutex_unlock(&shard->lock);
+    return reserved;
+}
+
+/**
+ * Splits the offsets in shards: dense pools in shard_count ranges as equal as possible, sparse pools in the smallest
+ * power of 2 of ranges that is at least shard_count
+ */
+static bool build_shards(struct AddressPool *pool, uint32_t shard_count) {
+    uint64_t size = address_pool_size(pool);
+    int index_bits = 0;
+
+    if (shard_count == 0)
+        shard_count = 1;
+    if (pool->is_sparse) {
+        while (((uint32_t) 1 << index_bits) < shard_count && index_bits < pool->offset_bits)
+            index_bits++;
+        shard_count = (uint32_t) 1 << index_bits;
+        pool->shard_bits = pool->offset_bits - index_bits;
+    } else if (shard_count > size) {
+        shard_count = (uint32_t) size;
+    }
+
+    pool->shards = (struct AddressShard *) calloc(shard_count, sizeof (struct AddressShard));
+    if (pool->shards == NULL)
+        return false;
+
+    for (uint32_t i = 0; i < shard_count; i++) {
+        uint64_t first, shard_size;
+        bool built;
+
+        if (pool->is_sparse) {
+            first = (uint64_t) i << pool->shard_bits;
+            shard_size = pool->shard_bits == 64 ? UINT64_MAX : (uint64_t) 1 << pool->shard_bits;
+        } else {
+            first = size * i / shard_count;
+            shard_size = size * (i + 1) / shard_count - first;
+        }
+
+        built = shard_init(pool, &pool->shards[i], first, shard_size);
+        pool->shard_count = i + 1;
+        if (!built)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Builds the pool of the network an interface address belongs to. The network address, the IPv4 broadcast address and
+ * the address of the interface itself are never leased.
+ * @param pool
+ * @param interface_address - *in6_addr: address of the interface, IPv4-mapped for IPv4
+ * @param prefix_length - int: mask of the network, at least ADDRESS_POOL_MIN_PREFIX_IPV4 for IPv4 and
+ *        ADDRESS_POOL_MIN_PREFIX_IPV6 for IPv6
+ * @param shard_count - uint32_t: number of workers that allocate from the pool
+ * @return True, if the pool could be built
+ *         False, if the prefix length is out of range or memory could not be allocated
+ */
+bool address_pool_init(struct AddressPool *pool, const struct in6_addr *interface_address, int prefix_length,
+                       uint32_t shard_count) {
+    int host_bits;
+
+    memset(pool, 0, sizeof (struct AddressPool));
+    pool->ipv6 = !address_is_ipv4(interface_address);
+    pool->prefix_length = prefix_length;
+
+    if (pool->ipv6) {
+        if (prefix_length < ADDRESS_POOL_MIN_PREFIX_IPV6 || prefix_length > 128)
+            return false;
+        host_bits = 128 - prefix_length;
+    } else {
+        if (prefix_length < ADDRESS_POOL_MIN_PREFIX_IPV4 || prefix_length > 32)
+            return false;
+        host_bits = 32 - prefix_length;
+    }
+    pool->offset_bits = host_bits < ADDRESS_POOL_MAX_OFFSET_BITS ? host_bits : ADDRESS_POOL_MAX_OFFSET_BITS;
+
+    pool->network = *interface_address;
+    address_set_low_bits(&pool->network, address_low_bits(interface_address) & ~offset_mask(pool));
+
+    pool->is_sparse = pool->offset_bits > ADDRESS_POOL_DENSE_MAX_BITS;
+    if (!build_shards(pool, shard_count)) {
+        address_pool_destroy(pool);
+        return false;
+    }
+
+    if (pool->ipv6 ? pool->offset_bits > 0 : pool->offset_bits > 1) {
+        reserve_offset(pool, 0);
+        if (!pool->ipv6)
+            reserve_offset(pool, offset_mask(pool));
+    }
+    reserve_offset(pool, offset_of(pool, interface_address));
+    return true;
+}
+
+void address_pool_destroy(struct AddressPool *pool) {
+    for (uint32_t i = 0; i < pool->shard_count; i++)
+        shard_destroy(pool, &pool->shards[i]);
+    free(pool->shards);
+    pool->shards = NULL;
+    pool->shard_count = 0;
+}
+
+/**
+ * @param pool
+ * @param address
+ * @return True, if the address belongs to the pool
+ *         False, otherwise
+ */
+bool address_pool_contains(const struct AddressPool *pool, const struct in6_addr *address) {
+    return memcmp(address->s6_addr, pool->network.s6_addr, 8) == 0 &&
+           (address_low_bits(address) & ~offset_mask(pool)) == address_low_bits(&pool->network);
+}
+
+/**
+ * Takes a free address out of a shard of the pool. When the shard is exhausted or not owned, the address is stolen from
+ * the owned shard with the most free addresses.
+ * @param pool
+ * @param shard - uint32_t: shard of the worker, taken modulo the number of shards
+ * @param address - *in6_addr: where the allocated address is stored
+ * @return True, if an address was allocated
+ *         False, if the pool is exhausted
+ */
+bool address_pool_allocate(struct AddressPool *pool, uint32_t shard, struct in6_addr *address) {
+    struct AddressShard *home = &pool->shards[shard % pool->shard_count];
+    uint64_t offset;
+
+    if (__atomic_load_n(&home->owned, __ATOMIC_RELAXED) && shard_allocate(pool, home, &offset)) {
+        offset_to_address(pool, offset, address);
+        return true;
+    }
+
+    for (uint32_t attempt = 0; attempt < pool->shard_count; attempt++) {
+        struct AddressShard *richest = NULL;
+        uint64_t most_free = 0;
+
+        for (uint32_t i = 0; i < pool->shard_count; i++) {
+            uint64_t free_count;
+
+            if (!__atomic_load_n(&pool->shards[i].owned, __ATOMIC_RELAXED))
+                continue;
+            pthread_mutex_lock(&pool->shards[i].lock);
+            free_count = shard_free(pool, &pool->shards[i]);
+            pthread_mutex_unlock(&pool->shards[i].lock);
+            if (free_count > most_free) {
+                most_free = free_count;
+                richest = &pool->shards[i];
+            }
+        }
+        if (richest == NULL)
+            return false;
+
+        if (shard_allocate(pool, richest, &offset)) {
+            __atomic_fetch_add(&pool->steals, 1, __ATOMIC_RELAXED);
+            offset_to_address(pool, offset, address);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Marks a specific address as leased
+ * @param pool
+ * @param address
+ * @return True, if the address belongs to the pool, was free and is now leased
+ *         False, otherwise
+ */
+bool address_pool_reserve(struct AddressPool *pool, const struct in6_addr *address) {
+    return address_pool_contains(pool, address) && reserve_offset(pool, offset_of(pool, address));
+}
+
+/**
+ * Returns an address to the shard it belongs to
+ * @param pool
+ * @param address
+ * @return True, if the address was leased and is now free
+ *         False, otherwise
+ */
+bool address_pool_release(struct AddressPool *pool, const struct in6_addr *address) {
+    struct AddressShard *shard;
+    uint64_t offset;
+    bool released;
+
+    if (!address_pool_contains(pool, address))
+        return false;
+    offset = offset_of(pool, address);
+    shard = shard_of(pool, offset);
+
+    pthread_mutex_lock(&shard->lock);
+    if (pool->is_sparse)
+        released = sparse_allocator_release(&shard->sparse, offset - shard->first);
+    else
+        released = allocator_release(&shard->dense, (uint32_t) (offset - shard->first));
+    pthread_mutex_unlock(&shard->lock);
+    return released;
+}
+
+bool address_pool_is_allocated(struct AddressPool *pool, const struct in6_addr *address) {
+    struct AddressShard *shard;
+    uint64_t offset;
+    bool allocated;
+
+    if (!address_pool_contains(pool, address))
+        return false;
+    offset = offset_of(pool, address);
+    shard = shard_of(pool, offset);
+
+    pthread_mutex_lock(&shard->lock);
+    if (pool->is_sparse)
+        allocated = sparse_allocator_is_allocated(&shard->sparse, offset - shard->first);
+    else
+        allocated = allocator_is_allocated(&shard->dense, (uint32_t) (offset - shard->first));
+    pthread_mutex_unlock(&shard->lock);
+    return allocated;
+}
+
+/**
+ * Gives the last address of the pool
+ * @param pool
+ * @param address - *in6_addr: where the address is stored
+ */
+void address_pool_last(const struct AddressPool *pool, struct in6_addr *address) {
+    offset_to_address(pool, offset_mask(pool), address);
+}
+
+/**
+ * @return number of addresses in the pool, UINT64_MAX for a 64 bit pool
+ */
+uint64_t address_pool_size(const struct AddressPool *pool) {
+    return pool->offset_bits == 64 ? UINT64_MAX : (uint64_t) 1 << pool->offset_bits;
+}
+
+/**
+ * @return number of addresses leased or reserved
+ */
+uint64_t address_pool_used(struct AddressPool *pool) {
+    uint64_t used = 0;
+
+    for (uint32_t i = 0; i < pool->shard_count; i++) {
+        pthread_mutex_lock(&pool->shards[i].lock);
+        used += pool->is_sparse ? pool->shards[i].sparse.used : pool->shards[i].dense.used;
+        pthread_mutex_unlock(&pool->shards[i].lock);
+    }
+    return used;
+}
+
+/**
+ * @return number of times an allocation had to search again, see Allocator and SparseAllocator
+ */
+uint64_t address_pool_retries(struct AddressPool *pool) {
+    uint64_t retries = 0;
+
+    for (uint32_t i = 0; i < pool->shard_count; i++) {
+        pthread_mutex_lock(&pool->shards[i].lock);
+        retries += pool->is_sparse ? pool->shards[i].sparse.retries : pool->shards[i].dense.retries;
+        pthread_mutex_unlock(&pool->shards[i].lock);
+    }
+    return retries;
+}
+
+/**
+ * @return number of allocations served by a shard other than the one asked for
+ */
+uint64_t address_pool_steals(const struct AddressPool *pool) {
+    return __atomic_load_n(&pool->steals, __ATOMIC_RELAXED);
+}
+
+/**
+ * Gives a shard to this server or takes it away, addresses already allocated from it stay allocated
+ * @param pool
+ * @param shard - uint32_t: index of the shard, taken modulo the number of shards
+ * @param owned - bool: True, if this server allocates from the shard
+ */
+void address_pool_set_owned(struct AddressPool *pool, uint32_t shard, bool owned) {
+    __atomic_store_n(&pool->shards[shard % pool->shard_count].owned, owned, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,80 @@
+#ifndef DHCP_V1_ADDRESS_POOL_H
+#define DHCP_V1_ADDRESS_POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "allocator.h"
+#include "sparse_allocator.h"
+
+#define ADDRESS_POOL_MIN_PREFIX_IPV4 8
+#define ADDRESS_POOL_MIN_PREFIX_IPV6 48
+#define ADDRESS_POOL_MAX_OFFSET_BITS 64
+#define ADDRESS_POOL_DENSE_MAX_BITS 24
+
+/**
+ * AddressShard structure, a contiguous range of offsets of the pool with its own allocator and lock
+ *  - lock - pthread_mutex_t: taken by the worker that owns the shard, and by other workers only to give back or steal
+ *  - owned - bool: True, if this server allocates from the shard; in a cluster the shard is a partition that may
+ *    belong to another node, whose addresses are only reserved and released here as that node replicates its leases
+ *  - first - uint64_t: first offset of the range
+ *  - size - uint64_t: number of offsets of the range, UINT64_MAX for 2^64
+ *  - dense - Allocator: allocator of dense pools, slot i is offset first + i
+ *  - sparse - SparseAllocator: allocator of sparse pools, offset i is offset first + i
+ */
+struct AddressShard {
+    pthread_mutex_t lock;
+    bool owned;
+    uint64_t first;
+    uint64_t size;
+    struct Allocator dense;
+    struct SparseAllocator sparse;
+};
+
+/**
+ * AddressPool structure, addresses of the network of the interface that can be leased. An address is identified by
+ * its offset from the network address. Pools of up to 2^ADDRESS_POOL_DENSE_MAX_BITS addresses use the bitmap
+ * allocator, larger IPv6 pools use the sparse allocator. An IPv6 pool shorter than /64 leases from the /64 of the
+ * interface address, so offsets are never wider than 64 bits.
+ * The offsets are split in shards, one per worker, so workers allocate without sharing a lock. A worker whose shard is
+ * exhausted steals from the owned shard with the most free addresses.
+ *  - network - in6_addr: first address of the pool, IPv4-mapped for IPv4 pools
+ *  - prefix_length - int: mask of the network, as written in the config file
+ *  - ipv6 - bool: True, if the pool holds IPv6 addresses
+ *  - offset_bits - int: number of host bits covered by offsets
+ *  - is_sparse - bool: True, if the shards use the sparse allocator
+ *  - shards - *AddressShard: ranges of the pool, in offset order
+ *  - shard_count - uint32_t: number of shards, a power of 2 for sparse pools
+ *  - shard_bits - int: sparse pools only, number of low offset bits inside a shard
+ *  - steals - uint64_t: allocations served by a shard other than the one asked for
+ */
+struct AddressPool {
+    struct in6_addr network;
+    int prefix_length;
+    bool ipv6;
+    int offset_bits;
+    bool is_sparse;
+    struct AddressShard *shards;
+    uint32_t shard_count;
+    int shard_bits;
+    uint64_t steals;
+};
+
+bool address_pool_init(struct AddressPool *pool, const struct in6_addr *interface_address, int prefix_length,
+                       uint32_t shard_count);
+void address_pool_destroy(struct AddressPool *pool);
+bool address_pool_contains(const struct AddressPool *pool, const struct in6_addr *address);
+bool address_pool_allocate(struct AddressPool *pool, uint32_t shard, struct in6_addr *address);
+bool address_pool_reserve(struct AddressPool *pool, const struct in6_addr *address);
+bool address_pool_release(struct AddressPool *pool, const struct in6_addr *address);
+bool address_pool_is_allocated(struct AddressPool *pool, const struct in6_addr *address);
+void address_pool_last(const struct AddressPool *pool, struct in6_addr *address);
+uint64_t address_pool_size(const struct AddressPool *pool);
+uint64_t address_pool_used(struct AddressPool *pool);
+uint64_t address_pool_retries(struct AddressPool *pool);
+uint64_t address_pool_steals(const struct AddressPool *pool);
+void address_pool_set_owned(struct AddressPool *pool, uint32_t shard, bool owned);
+
+#endif //DHCP_V1_ADDRESS_POOL_H
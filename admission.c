@@ -0,0 +1,93 @@
+#include <stdlib.h>
+
+#include "admission.h"
+
+#define HASH_MULTIPLIER 0x9E3779B1u
+
+static uint32_t home_slot(const struct Admission *admission, in_addr_t source) {
+    uint32_t hash = (uint32_t) source * HASH_MULTIPLIER;
+
+    return (hash ^ hash >> 16) & admission->mask;
+}
+
+/**
+ * Finds the bucket of a source, or gives it a free bucket or the least recently used one among its probes
+ */
+static struct AdmissionBucket *find_bucket(struct Admission *admission, in_addr_t source, uint64_t now) {
+    struct AdmissionBucket *oldest = NULL;
+    uint32_t slot = home_slot(admission, source);
+
+    for (int i = 0; i < ADMISSION_PROBES; i++, slot = (slot + 1) & admission->mask) {
+        struct AdmissionBucket *bucket = &admission->buckets[slot];
+
+        if (bucket->in_use && bucket->source == source)
+            return bucket;
+        if (!bucket->in_use) {
+            oldest = bucket;
+            break;
+        }
+        if (oldest == NULL || bucket->updated < oldest->updated)
+            oldest = bucket;
+    }
+
+    if (oldest->in_use)
+        admission->evictions++;
+    *oldest = (struct AdmissionBucket) {.source = source, .in_use = true, .tokens = admission->burst, .updated = now};
+    return oldest;
+}
+
+/**
+ * Builds the token buckets
+ * @param admission
+ * @param buckets - uint32_t: number of sources tracked at once, rounded up to a power of 2
+ * @param rate - double: requests per second a source is allowed, 0 if sources are not limited
+ * @param burst - double: requests a quiet source can send at once, at least 1
+ * @return True, if the buckets could be allocated
+ *         False, otherwise
+ */
+bool admission_init(struct Admission *admission, uint32_t buckets, double rate, double burst) {
+    uint32_t size = ADMISSION_PROBES;
+
+    while (size < buckets && size < (1u << 31))
+        size <<= 1;
+
+    admission->mask = size - 1;
+    admission->rate = rate;
+    admission->burst = burst < 1 ? 1 : burst;
+    admission->evictions = 0;
+    admission->buckets = (struct AdmissionBucket *) calloc(size, sizeof (struct AdmissionBucket));
+    return admission->buckets != NULL;
+}
+
+void admission_destroy(struct Admission *admission) {
+    free(admission->buckets);
+    admission->buckets = NULL;
+}
+
+/**
+ * Takes a token from the bucket of a source, after refilling it for the time elapsed since its last request
+ * @param admission
+ * @param source - in_addr_t: source address of the request, in network byte order
+ * @param now - uint64_t: CLOCK_MONOTONIC time, in nanoseconds
+ * @return True, if the request is admitted
+ *         False, if the source sent more than its rate allows
+ */
+bool admission_allow(struct Admission *admission, in_addr_t source, uint64_t now) {
+    struct AdmissionBucket *bucket;
+
+    if (admission->rate <= 0)
+        return true;
+
+    bucket = find_bucket(admission, source, now);
+    if (now > bucket->updated) {
+        bucket->tokens += (double) (now - bucket->updated) * admission->rate / 1e9;
+        if (bucket->tokens > admission->burst)
+            bucket->tokens = admission->burst;
+        bucket->updated = now;
+    }
+
+    if (bucket->tokens < 1)
+        return false;
+    bucket->tokens -= 1;
+    return true;
+}
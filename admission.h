@@ -0,0 +1,46 @@
+#ifndef DHCP_V1_ADMISSION_H
+#define DHCP_V1_ADMISSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define ADMISSION_PROBES 8
+
+/**
+ * AdmissionBucket structure, token bucket of one source address
+ *  - source - in_addr_t: source address, in network byte order
+ *  - in_use - bool: True, if the bucket belongs to a source
+ *  - tokens - double: requests the source can still send right away, at most the burst
+ *  - updated - uint64_t: CLOCK_MONOTONIC time the tokens were last refilled at, in nanoseconds
+ */
+struct AdmissionBucket {
+    in_addr_t source;
+    bool in_use;
+    double tokens;
+    uint64_t updated;
+};
+
+/**
+ * Admission structure, token buckets of the sources a worker hears from, in a hash table of fixed size. A source is
+ * looked up in ADMISSION_PROBES slots from its home slot; when none of them is free, the bucket that was used least
+ * recently is given to the new source. Nothing is allocated after admission_init().
+ *  - buckets - *AdmissionBucket: hash table
+ *  - mask - uint32_t: number of buckets - 1, the number of buckets is a power of 2
+ *  - rate - double: tokens added to every bucket per second, 0 if sources are not limited
+ *  - burst - double: tokens of a full bucket
+ *  - evictions - uint64_t: buckets given to another source
+ */
+struct Admission {
+    struct AdmissionBucket *buckets;
+    uint32_t mask;
+    double rate;
+    double burst;
+    uint64_t evictions;
+};
+
+bool admission_init(struct Admission *admission, uint32_t buckets, double rate, double burst);
+void admission_destroy(struct Admission *admission);
+bool admission_allow(struct Admission *admission, in_addr_t source, uint64_t now);
+
+#endif //DHCP_V1_ADMISSION_H
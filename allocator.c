@@ -0,0 +1,220 @@
+#include <stdlib.h>
+
+#include "allocator.h"
+
+#define WORD_BITS 64
+#define FULL_WORD (~(uint64_t) 0)
+
+/**
+ * Marks as used the bits of the last word of a level that do not map to a real slot, so they are never handed out
+ * @param allocator
+ * @param level
+ * @param bits - uint32_t: number of meaningful bits on this level
+ */
+static void mark_padding(struct Allocator *allocator, int level, uint32_t bits) {
+    uint32_t remainder = bits % WORD_BITS;
+
+    if (remainder != 0)
+        allocator->words[level][allocator->word_count[level] - 1] |= FULL_WORD << remainder;
+}
+
+/**
+ * Sets a bit on the given level and propagates the fullness of its word to the upper levels
+ * @param allocator
+ * @param level
+ * @param bit - uint32_t: index of the bit on the level
+ */
+static void set_bit(struct Allocator *allocator, int level, uint32_t bit) {
+    for (; level < allocator->levels; level++) {
+        uint64_t *word = &allocator->words[level][bit / WORD_BITS];
+
+        *word |= (uint64_t) 1 << (bit % WORD_BITS);
+        if (*word != FULL_WORD)
+            return;
+        bit /= WORD_BITS;
+    }
+}
+
+/**
+ * Clears a bit on the given level and marks its word as not full on the upper levels
+ * @param allocator
+ * @param level
+ * @param bit - uint32_t: index of the bit on the level
+ */
+static void clear_bit(struct Allocator *allocator, int level, uint32_t bit) {
+    for (; level < allocator->levels; level++) {
+        uint64_t *word = &allocator->words[level][bit / WORD_BITS];
+        bool was_full = *word == FULL_WORD;
+
+        *word &= ~((uint64_t) 1 << (bit % WORD_BITS));
+        if (!was_full)
+            return;
+        bit /= WORD_BITS;
+    }
+}
+
+/**
+ * Finds first clear bit on a level, starting from a given bit. Full words are skipped by looking at the upper level.
+ * @param allocator
+ * @param level
+ * @param bit - uint64_t: first bit that can be returned
+ * @return index of the clear bit
+ *         -1, if every bit starting from @param bit is set
+ */
+static int64_t find_next_zero(const struct Allocator *allocator, int level, uint64_t bit) {
+    uint64_t word_index = bit / WORD_BITS, free_bits;
+    int64_t parent;
+
+    if (word_index >= allocator->word_count[level])
+        return -1;
+
+    free_bits = ~allocator->words[level][word_index] & (FULL_WORD << (bit % WORD_BITS));
+    if (free_bits == 0) {
+        if (level + 1 == allocator->levels)
+            return -1;
+
+        parent = find_next_zero(allocator, level + 1, word_index + 1);
+        if (parent < 0)
+            return -1;
+
+        word_index = (uint64_t) parent;
+        free_bits = ~allocator->words[level][word_index];
+    }
+
+    return (int64_t) (word_index * WORD_BITS + __builtin_ctzll(free_bits));
+}
+
+/**
+ * Builds the bitmap levels for a pool of the given size, every slot starts free
+ * @param allocator
+ * @param size - uint32_t: number of slots in the pool
+ * @return True, if the allocator could be built
+ *         False, otherwise
+ */
+bool allocator_init(struct Allocator *allocator, uint32_t size) {
+    uint32_t bits = size;
+
+    allocator->size = size;
+    allocator->used = 0;
+    allocator->cursor = 0;
+    allocator->retries = 0;
+    allocator->levels = 0;
+
+    if (size == 0)
+        return false;
+
+    do {
+        uint32_t words = (bits + WORD_BITS - 1) / WORD_BITS;
+
+        allocator->word_count[allocator->levels] = words;
+        allocator->words[allocator->levels] = (uint64_t *) calloc(words, sizeof (uint64_t));
+        if (allocator->words[allocator->levels] == NULL) {
+            allocator_destroy(allocator);
+            return false;
+        }
+        allocator->levels++;
+        bits = words;
+    } while (bits > 1);
+
+    bits = size;
+    for (int level = 0; level < allocator->levels; level++) {
+        mark_padding(allocator, level, bits);
+
+        if (level + 1 < allocator->levels)
+            for (uint32_t i = 0; i < allocator->word_count[level]; i++)
+                if (allocator->words[level][i] == FULL_WORD)
+                    allocator->words[level + 1][i / WORD_BITS] |= (uint64_t) 1 << (i % WORD_BITS);
+
+        bits = allocator->word_count[level];
+    }
+
+    return true;
+}
+
+/**
+ * Deallocates the memory held by the bitmap levels
+ * @param allocator
+ */
+void allocator_destroy(struct Allocator *allocator) {
+    for (int level = 0; level < allocator->levels; level++)
+        free(allocator->words[level]);
+
+    allocator->levels = 0;
+    allocator->size = 0;
+    allocator->used = 0;
+}
+
+/**
+ * Allocates the first free slot found after the cursor, wrapping around to the start of the pool
+ * @param allocator
+ * @param offset - *uint32_t: where the allocated offset is stored
+ * @return True, if a slot was allocated
+ *         False, if the pool is exhausted
+ */
+bool allocator_allocate(struct Allocator *allocator, uint32_t *offset) {
+    int64_t found;
+
+    if (allocator->used >= allocator->size)
+        return false;
+
+    found = find_next_zero(allocator, 0, allocator->cursor);
+    if (found < 0) {
+        allocator->retries++;
+        found = find_next_zero(allocator, 0, 0);
+    }
+    if (found < 0)
+        return false;
+
+    set_bit(allocator, 0, (uint32_t) found);
+    allocator->used++;
+    allocator->cursor = (uint32_t) found + 1 < allocator->size ? (uint32_t) found + 1 : 0;
+
+    *offset = (uint32_t) found;
+    return true;
+}
+
+/**
+ * Marks a specific slot as allocated
+ * @param allocator
+ * @param offset - uint32_t: slot that needs to be reserved
+ * @return True, if the slot was free and is now allocated
+ *         False, if the slot is out of the pool or already allocated
+ */
+bool allocator_reserve(struct Allocator *allocator, uint32_t offset) {
+    if (offset >= allocator->size || allocator_is_allocated(allocator, offset))
+        return false;
+
+    set_bit(allocator, 0, offset);
+    allocator->used++;
+    return true;
+}
+
+/**
+ * Returns a slot to the pool
+ * @param allocator
+ * @param offset - uint32_t: slot that needs to be released
+ * @return True, if the slot was allocated and is now free
+ *         False, if the slot is out of the pool or was not allocated
+ */
+bool allocator_release(struct Allocator *allocator, uint32_t offset) {
+    if (offset >= allocator->size || !allocator_is_allocated(allocator, offset))
+        return false;
+
+    clear_bit(allocator, 0, offset);
+    allocator->used--;
+    return true;
+}
+
+/**
+ * Checks wether a slot is allocated or not
+ * @param allocator
+ * @param offset - uint32_t: searched slot
+ * @return True, if the slot is allocated
+ *         False, otherwise
+ */
+bool allocator_is_allocated(const struct Allocator *allocator, uint32_t offset) {
+    if (offset >= allocator->size)
+        return false;
+
+    return (allocator->words[0][offset / WORD_BITS] >> (offset % WORD_BITS)) & 1;
+}
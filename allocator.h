@@ -0,0 +1,36 @@
+#ifndef DHCP_V1_ALLOCATOR_H
+#define DHCP_V1_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ALLOCATOR_MAX_LEVELS 6
+
+/**
+ * Hierarchical bitmap allocator, hands out slots identified by their offset inside the pool.
+ *  - size - uint32_t: number of slots managed by the allocator
+ *  - used - uint32_t: number of slots currently allocated
+ *  - cursor - uint32_t: offset where the next search starts, so released slots are not reused right away
+ *  - retries - uint64_t: searches that found nothing after the cursor and had to start again from the beginning
+ *  - levels - int: number of bitmap levels, level 0 holds one bit per slot
+ *  - word_count - uint32_t[]: number of 64 bit words on every level
+ *  - words - uint64_t*[]: bitmap of every level; a set bit on level i + 1 means that the matching word on level i is full
+ */
+struct Allocator {
+    uint32_t size;
+    uint32_t used;
+    uint32_t cursor;
+    uint64_t retries;
+    int levels;
+    uint32_t word_count[ALLOCATOR_MAX_LEVELS];
+    uint64_t *words[ALLOCATOR_MAX_LEVELS];
+};
+
+bool allocator_init(struct Allocator *allocator, uint32_t size);
+void allocator_destroy(struct Allocator *allocator);
+bool allocator_allocate(struct Allocator *allocator, uint32_t *offset);
+bool allocator_reserve(struct Allocator *allocator, uint32_t offset);
+bool allocator_release(struct Allocator *allocator, uint32_t offset);
+bool allocator_is_allocated(const struct Allocator *allocator, uint32_t offset);
+
+#endif //DHCP_V1_ALLOCATOR_H
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "apply_queue.h"
+
+/**
+ * Grows an array of a job to hold @param count elements, arrays never shrink
+ * @return True, if the array holds @param count elements
+ *         False, otherwise; the array is unchanged
+ */
+static bool ensure_capacity(void **array, size_t *capacity, size_t count, size_t size) {
+    size_t grown = *capacity == 0 ? 1 : *capacity;
+    void *resized;
+
+    if (count <= *capacity)
+        return true;
+    while (grown < count)
+        grown *= 2;
+
+    resized = realloc(*array, grown * size);
+    if (resized == NULL)
+        return false;
+    *array = resized;
+    *capacity = grown;
+    return true;
+}
+
+/**
+ * Builds an empty queue
+ * @param queue
+ * @param capacity - size_t: maximum number of jobs queued or being applied, at least 1
+ * @return True, if the slots could be allocated
+ *         False, otherwise
+ */
+bool apply_queue_init(struct ApplyQueue *queue, size_t capacity) {
+    memset(queue, 0, sizeof (struct ApplyQueue));
+    queue->capacity = capacity == 0 ? 1 : capacity;
+    queue->jobs = (struct ApplyJob *) calloc(queue->capacity, sizeof (struct ApplyJob));
+    if (queue->jobs == NULL)
+        return false;
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    return true;
+}
+
+void apply_queue_destroy(struct ApplyQueue *queue) {
+    for (size_t i = 0; i < queue->capacity; i++) {
+        free(queue->jobs[i].changes);
+        free(queue->jobs[i].routes);
+        free(queue->jobs[i].detached);
+    }
+    free(queue->jobs);
+    queue->jobs = NULL;
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+/**
+ * Reserves a slot for the next job of a worker, waiting while the queue is full: a worker that commits faster than the
+ * interface is updated stops reading its socket until the apply thread catches up. No other lock may be held.
+ * @param queue
+ */
+void apply_queue_reserve(struct ApplyQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count + queue->reserved >= queue->capacity) {
+        queue->stalls++;
+        while (queue->count + queue->reserved >= queue->capacity)
+            pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    queue->reserved++;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Gives back a reserved slot, the batch had nothing to apply
+ * @param queue
+ */
+void apply_queue_cancel(struct ApplyQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->reserved--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Copies the changes, routes and detached peers of a batch in the slot reserved by apply_queue_reserve(). Called under
+ * the lock of the state the changes apply to, so the jobs of a state are applied in the order they were committed.
+ * @param queue
+ * @param batch - *Batch: committed batch, its changes can be reset once the job is published
+ * @param context - *void: what the changes apply to, kept in the job
+ * @param now - uint64_t: CLOCK_MONOTONIC time, in nanoseconds
+ * @return sequence of the job, to wait for with apply_queue_wait()
+ *         0, if the job could not be stored; the slot is given back
+ */
+uint64_t apply_queue_publish(struct ApplyQueue *queue, const struct Batch *batch, void *context, uint64_t now) {
+    struct ApplyJob *job;
+    uint64_t sequence = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    job = &queue->jobs[(queue->head + queue->count) % queue->capacity];
+    queue->reserved--;
+
+    if (ensure_capacity((void **) &job->changes, &job->change_capacity, batch->change_count,
+                        sizeof (struct DataplaneChange)) &&
+        ensure_capacity((void **) &job->routes, &job->route_capacity, batch->route_count, sizeof (struct RouteChange)) &&
+        ensure_capacity((void **) &job->detached, &job->detached_capacity, batch->detached_count,
+                        sizeof (struct Peer *))) {
+        memcpy(job->changes, batch->changes, batch->change_count * sizeof (struct DataplaneChange));
+        memcpy(job->routes, batch->routes, batch->route_count * sizeof (struct RouteChange));
+        memcpy(job->detached, batch->detached, batch->detached_count * sizeof (struct Peer *));
+        job->change_count = batch->change_count;
+        job->route_count = batch->route_count;
+        job->detached_count = batch->detached_count;
+        job->published = now;
+        job->context = context;
+        job->sequence = sequence = ++queue->published;
+        queue->count++;
+    }
+
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return sequence;
+}
+
+/**
+ * Waits for the oldest job, used by the apply thread
+ * @param queue
+ * @return *ApplyJob, valid until apply_queue_complete()
+ *         NULL, if the queue is closed and empty
+ */
+struct ApplyJob *apply_queue_take(struct ApplyQueue *queue) {
+    struct ApplyJob *job = NULL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !(queue->closed && queue->reserved == 0))
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    if (queue->count > 0)
+        job = &queue->jobs[queue->head];
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+/**
+ * Frees the slot of the job given by apply_queue_take() and notifies the threads waiting for it
+ * @param queue
+ */
+void apply_queue_complete(struct ApplyQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->completed = queue->jobs[queue->head].sequence;
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Waits until a job, and every job published before it, is applied
+ * @param queue
+ * @param sequence - uint64_t: value returned by apply_queue_publish()
+ */
+void apply_queue_wait(struct ApplyQueue *queue, uint64_t sequence) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->completed < sequence)
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * No job is published anymore, the apply thread applies the jobs left and stops
+ * @param queue
+ */
+void apply_queue_close(struct ApplyQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @param queue
+ * @return number of jobs published and not applied yet
+ */
+uint64_t apply_queue_backlog(struct ApplyQueue *queue) {
+    uint64_t backlog;
+
+    pthread_mutex_lock(&queue->lock);
+    backlog = queue->published - queue->completed;
+    pthread_mutex_unlock(&queue->lock);
+    return backlog;
+}
+
+/**
+ * @param queue
+ * @return number of reservations that waited for room
+ */
+uint64_t apply_queue_stalls(struct ApplyQueue *queue) {
+    uint64_t stalls;
+
+    pthread_mutex_lock(&queue->lock);
+    stalls = queue->stalls;
+    pthread_mutex_unlock(&queue->lock);
+    return stalls;
+}
@@ -0,0 +1,82 @@
+#ifndef DHCP_V1_APPLY_QUEUE_H
+#define DHCP_V1_APPLY_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "batch.h"
+
+/**
+ * ApplyJob structure, the interface work of one committed batch. Its arrays grow to the largest batch they held and are
+ * reused by the next jobs of the slot.
+ *  - sequence - uint64_t: number of the job, jobs are applied in this order
+ *  - published - uint64_t: CLOCK_MONOTONIC time the job was queued at, in nanoseconds
+ *  - context - *void: what the changes apply to, given to apply_queue_publish()
+ *  - changes - *DataplaneChange: peer changes of the batch
+ *  - change_count, change_capacity - size_t
+ *  - routes - *RouteChange: host route changes of the batch
+ *  - route_count, route_capacity - size_t
+ *  - detached - **Peer: peers the batch took out of the peer table, released once the changes are applied
+ *  - detached_count, detached_capacity - size_t
+ */
+struct ApplyJob {
+    uint64_t sequence;
+    uint64_t published;
+    void *context;
+    struct DataplaneChange *changes;
+    size_t change_count;
+    size_t change_capacity;
+    struct RouteChange *routes;
+    size_t route_count;
+    size_t route_capacity;
+    struct Peer **detached;
+    size_t detached_count;
+    size_t detached_capacity;
+};
+
+/**
+ * ApplyQueue structure, bounded queue of jobs between the workers, which commit batches, and the apply thread, which
+ * applies them to the interfaces. A worker reserves a slot before it takes the lock of a shared state, so it waits for
+ * room while holding no other lock; jobs are published under the lock of the state they apply to, so the jobs of one
+ * state are in commit order.
+ *  - jobs - *ApplyJob: ring of capacity slots
+ *  - capacity - size_t: maximum number of jobs queued or being applied
+ *  - head - size_t: slot of the oldest job
+ *  - count - size_t: jobs queued or being applied
+ *  - reserved - size_t: slots reserved by workers and not published yet
+ *  - published - uint64_t: sequence of the last job published
+ *  - completed - uint64_t: sequence of the last job applied
+ *  - stalls - uint64_t: reservations that had to wait for room
+ *  - closed - bool: True, once no job is published anymore; the apply thread stops when the queue is empty
+ *  - lock - pthread_mutex_t
+ *  - changed - pthread_cond_t: signaled when a job is published or completed, a slot released or the queue closed
+ */
+struct ApplyQueue {
+    struct ApplyJob *jobs;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t reserved;
+    uint64_t published;
+    uint64_t completed;
+    uint64_t stalls;
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+bool apply_queue_init(struct ApplyQueue *queue, size_t capacity);
+void apply_queue_destroy(struct ApplyQueue *queue);
+void apply_queue_reserve(struct ApplyQueue *queue);
+void apply_queue_cancel(struct ApplyQueue *queue);
+uint64_t apply_queue_publish(struct ApplyQueue *queue, const struct Batch *batch, void *context, uint64_t now);
+struct ApplyJob *apply_queue_take(struct ApplyQueue *queue);
+void apply_queue_complete(struct ApplyQueue *queue);
+void apply_queue_wait(struct ApplyQueue *queue, uint64_t sequence);
+void apply_queue_close(struct ApplyQueue *queue);
+uint64_t apply_queue_backlog(struct ApplyQueue *queue);
+uint64_t apply_queue_stalls(struct ApplyQueue *queue);
+
+#endif //DHCP_V1_APPLY_QUEUE_H
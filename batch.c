@@ -0,0 +1,209 @@
+#include <stdlib.h>
+
+#include "batch.h"
+
+/**
+ * Allocates the storage of a batch
+ * @param batch
+ * @param capacity - size_t: maximum number of requests in a batch, at least 1
+ * @param window_ms - long: how long a batch stays open after its first request
+ * @return True, if the batch could be allocated
+ *         False, otherwise
+ */
+bool batch_init(struct Batch *batch, size_t capacity, long window_ms) {
+    if (capacity == 0)
+        capacity = 1;
+
+    batch->capacity = capacity;
+    batch->change_capacity = capacity;
+    batch->detached_count = 0;
+    batch->window_ms = window_ms < 0 ? 0 : window_ms;
+    batch->requests = (struct BatchRequest *) calloc(capacity, sizeof (struct BatchRequest));
+    batch->changes = (struct DataplaneChange *) calloc(capacity, sizeof (struct DataplaneChange));
+    batch->detached = (struct Peer **) calloc(capacity, sizeof (struct Peer *));
+    batch->routes = (struct RouteChange *) calloc(2 * capacity, sizeof (struct RouteChange));
+    batch->replicas = (struct DataplaneChange *) calloc(capacity, sizeof (struct DataplaneChange));
+
+    if (batch->requests == NULL || batch->changes == NULL || batch->detached == NULL || batch->routes == NULL ||
+        batch->replicas == NULL) {
+        batch_destroy(batch);
+        return false;
+    }
+
+    batch_reset(batch);
+    return true;
+}
+
+void batch_destroy(struct Batch *batch) {
+    free(batch->requests);
+    free(batch->changes);
+    free(batch->detached);
+    free(batch->routes);
+    free(batch->replicas);
+    batch->requests = NULL;
+    batch->changes = NULL;
+    batch->detached = NULL;
+    batch->routes = NULL;
+    batch->replicas = NULL;
+}
+
+/**
+ * Gives the slot in which the next request is received
+ * @param batch
+ * @return *BatchRequest, the request is part of the batch only after batch_push()
+ *         NULL, if the batch is full
+ */
+struct BatchRequest *batch_next_request(struct Batch *batch) {
+    if (batch_is_full(batch))
+        return NULL;
+
+    batch->requests[batch->count].from_length = sizeof (struct sockaddr_in);
+    batch->requests[batch->count].pool = 0;
+    batch->requests[batch->count].address = in6addr_any;
+    batch->requests[batch->count].status = REPLY_OK;
+    batch->requests[batch->count].lease_time = 0;
+    batch->requests[batch->count].answer = false;
+    return &batch->requests[batch->count];
+}
+
+/**
+ * Adds the request received in the slot given by batch_next_request() to the batch, the first request opens the window
+ * @param batch
+ */
+void batch_push(struct Batch *batch) {
+    if (batch->count == 0)
+        clock_gettime(CLOCK_MONOTONIC, &batch->opened);
+    batch->count++;
+}
+
+bool batch_is_full(const struct Batch *batch) {
+    return batch->count >= batch->capacity;
+}
+
+/**
+ * Computes how long the batch may still wait for requests
+ * @param batch
+ * @return milliseconds until the window closes, 0 if it is already closed
+ *         -1, if the batch is empty and no window is open
+ */
+long batch_remaining_ms(const struct Batch *batch) {
+    struct timespec now;
+    long elapsed_ms;
+
+    if (batch->count == 0)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed_ms = (now.tv_sec - batch->opened.tv_sec) * 1000 + (now.tv_nsec - batch->opened.tv_nsec) / 1000000;
+
+    return elapsed_ms >= batch->window_ms ? 0 : batch->window_ms - elapsed_ms;
+}
+
+/**
+ * Grows the changes of a batch so that @param changes more peers can be detached, changed or replicated, used when more
+ * peers than requests are changed at once
+ * @param batch
+ * @param changes - size_t: number of peer changes about to be added
+ * @return True, if there is room for them
+ *         False, otherwise; the batch is unchanged
+ */
+bool batch_make_room(struct Batch *batch, size_t changes) {
+    size_t needed = batch->change_count, capacity = batch->change_capacity;
+    struct DataplaneChange *grown_changes, *grown_replicas;
+    struct Peer **grown_detached;
+    struct RouteChange *grown_routes;
+
+    if (batch->detached_count > needed)
+        needed = batch->detached_count;
+    if (batch->replica_count > needed)
+        needed = batch->replica_count;
+    needed += changes;
+    if (needed <= capacity && batch->route_count + 2 * changes <= 2 * capacity)
+        return true;
+    while (capacity < needed || 2 * capacity < batch->route_count + 2 * changes)
+        capacity *= 2;
+
+    grown_changes = (struct DataplaneChange *) realloc(batch->changes, capacity * sizeof (struct DataplaneChange));
+    if (grown_changes == NULL)
+        return false;
+    batch->changes = grown_changes;
+    grown_detached = (struct Peer **) realloc(batch->detached, capacity * sizeof (struct Peer *));
+    if (grown_detached == NULL)
+        return false;
+    batch->detached = grown_detached;
+    grown_routes = (struct RouteChange *) realloc(batch->routes, 2 * capacity * sizeof (struct RouteChange));
+    if (grown_routes == NULL)
+        return false;
+    batch->routes = grown_routes;
+    grown_replicas = (struct DataplaneChange *) realloc(batch->replicas, capacity * sizeof (struct DataplaneChange));
+    if (grown_replicas == NULL)
+        return false;
+    batch->replicas = grown_replicas;
+
+    batch->change_capacity = capacity;
+    return true;
+}
+
+/**
+ * Records a peer change that is applied to the interface when the batch is committed
+ * @param batch
+ * @param peer - *Peer: peer that stays valid until the commit
+ * @param remove - bool: True, if the peer is removed
+ */
+void batch_add_change(struct Batch *batch, const struct Peer *peer, bool remove) {
+    batch->changes[batch->change_count].peer = peer;
+    batch->changes[batch->change_count++].remove = remove;
+}
+
+/**
+ * Keeps a peer taken out of the peer table until the commit, the data plane still needs it to remove the peer
+ * @param batch
+ * @param peer
+ */
+void batch_detach(struct Batch *batch, struct Peer *peer) {
+    batch->detached[batch->detached_count++] = peer;
+}
+
+/**
+ * Records a host route change that is applied when the batch is committed
+ * @param batch
+ * @param address - *in6_addr: leased address
+ * @param remove - bool: True, if the route is deleted
+ */
+void batch_add_route(struct Batch *batch, const struct in6_addr *address, bool remove) {
+    batch->routes[batch->route_count].address = *address;
+    batch->routes[batch->route_count++].remove = remove;
+}
+
+/**
+ * Records a lease that is replicated to the other nodes of the cluster when the batch is committed
+ * @param batch
+ * @param peer - *Peer: peer that stays valid until the commit
+ * @param remove - bool: True, if the lease was given back
+ */
+void batch_add_replica(struct Batch *batch, const struct Peer *peer, bool remove) {
+    batch->replicas[batch->replica_count].peer = peer;
+    batch->replicas[batch->replica_count++].remove = remove;
+}
+
+/**
+ * Forgets the changes of the batch and keeps its requests, used once the changes of one pool are published
+ * @param batch
+ */
+void batch_reset_changes(struct Batch *batch) {
+    batch->change_count = 0;
+    batch->detached_count = 0;
+    batch->route_count = 0;
+    batch->replica_count = 0;
+    batch->first_new = NULL;
+    batch->rewrite_config = false;
+}
+
+/**
+ * Empties the batch, its changes have to be published to the apply queue before
+ * @param batch
+ */
+void batch_reset(struct Batch *batch) {
+    batch->count = 0;
+    batch_reset_changes(batch);
+}
@@ -0,0 +1,95 @@
+#ifndef DHCP_V1_BATCH_H
+#define DHCP_V1_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#include "protocol.h"
+#include "dataplane.h"
+#include "route_manager.h"
+
+/**
+ * BatchRequest structure, one request waiting for the commit of its batch
+ *  - datagram - char[]: request as received from the client
+ *  - length - size_t: length of the datagram
+ *  - request - Request: decoded datagram
+ *  - from - sockaddr_in: where the request came from
+ *  - from_length - socklen_t: length of from
+ *  - destination - in_addr: local address the request was sent to, INADDR_ANY if unknown
+ *  - pool - uint32_t: interface the request is served by, set once the request is decoded
+ *  - address - in6_addr: address leased to the client, valid when status is REPLY_OK
+ *  - status - uint8_t: outcome of the request, REPLY_OK, REPLY_POOL_EXHAUSTED or REPLY_NOT_LEASED
+ *  - lease_time - uint32_t: seconds the lease is valid for, 0 if it never expires
+ *  - answer - bool: True, if the client gets a reply once the batch is committed
+ */
+struct BatchRequest {
+    char datagram[PROTOCOL_MAX_DATAGRAM];
+    size_t length;
+    struct Request request;
+    struct sockaddr_in from;
+    socklen_t from_length;
+    struct in_addr destination;
+    uint32_t pool;
+    struct in6_addr address;
+    uint8_t status;
+    uint32_t lease_time;
+    bool answer;
+};
+
+/**
+ * Batch structure, requests gathered during a window that share one config commit and one data plane apply
+ *  - requests - *BatchRequest: requests in arrival order
+ *  - count - size_t: number of requests in the batch
+ *  - capacity - size_t: maximum number of requests in a batch
+ *  - window_ms - long: how long a batch stays open after its first request
+ *  - opened - timespec: arrival of the first request
+ *  - changes - *DataplaneChange: peer changes applied at commit
+ *  - change_count - size_t: number of changes
+ *  - change_capacity - size_t: maximum number of changes and detached peers, half the maximum number of route changes
+ *  - detached - **Peer: peers taken out of the peer table, released to it once the apply thread applied the batch
+ *  - detached_count - size_t: number of detached peers
+ *  - routes - *RouteChange: host routes of the leased addresses, added and deleted at commit
+ *  - route_count - size_t: number of route changes, at most two per change
+ *  - replicas - *DataplaneChange: leases changed by requests of clients or of the control socket, replicated to the
+ *    other nodes of the cluster at commit; remove is set for leases given back
+ *  - replica_count - size_t: number of replicated leases, at most change_capacity
+ *  - first_new - *Peer: first peer added by this batch, the config file is appended from here when nothing was removed
+ *  - rewrite_config - bool: True, if a peer was removed and the config file has to be rewritten
+ */
+struct Batch {
+    struct BatchRequest *requests;
+    size_t count;
+    size_t capacity;
+    long window_ms;
+    struct timespec opened;
+
+    struct DataplaneChange *changes;
+    size_t change_count;
+    size_t change_capacity;
+    struct Peer **detached;
+    size_t detached_count;
+    struct RouteChange *routes;
+    size_t route_count;
+    struct DataplaneChange *replicas;
+    size_t replica_count;
+    struct Peer *first_new;
+    bool rewrite_config;
+};
+
+bool batch_init(struct Batch *batch, size_t capacity, long window_ms);
+void batch_destroy(struct Batch *batch);
+struct BatchRequest *batch_next_request(struct Batch *batch);
+void batch_push(struct Batch *batch);
+bool batch_is_full(const struct Batch *batch);
+long batch_remaining_ms(const struct Batch *batch);
+bool batch_make_room(struct Batch *batch, size_t changes);
+void batch_add_change(struct Batch *batch, const struct Peer *peer, bool remove);
+void batch_detach(struct Batch *batch, struct Peer *peer);
+void batch_add_route(struct Batch *batch, const struct in6_addr *address, bool remove);
+void batch_add_replica(struct Batch *batch, const struct Peer *peer, bool remove);
+void batch_reset_changes(struct Batch *batch);
+void batch_reset(struct Batch *batch);
+
+#endif //DHCP_V1_BATCH_H
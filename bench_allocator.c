@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "address.h"
+#include "address_pool.h"
+
+#define DEFAULT_SEED 1
+#define DEFAULT_OPERATIONS 100000
+#define DEFAULT_SHARDS 1
+#define SPARSE_REFERENCE_SIZE (1u << 20)
+
+/**
+ * Pool benchmarked: an interface address and its mask, as they would be written in the config file
+ */
+static const struct {
+    const char *address;
+    int prefix_length;
+} POOLS[] = {
+        {"10.0.0.1", 24},
+        {"10.0.0.1", 20},
+        {"10.0.0.1", 16},
+        {"10.0.0.1", 12},
+        {"fd00::1", 104},
+        {"fd00::1", 64},
+};
+
+static const double OCCUPANCIES[] = {0.10, 0.50, 0.90, 0.99, 0.999};
+
+/**
+ * Options of a run
+ */
+struct Options {
+    uint64_t seed;
+    uint64_t operations;
+    uint32_t shards;
+};
+
+/**
+ * Outcome of one pool at one occupancy
+ */
+struct Results {
+    uint64_t leased;
+    double fill_ns;
+    double churn_ns;
+    uint64_t retries;
+    uint64_t steals;
+};
+
+static uint64_t now_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static void fail(const char *message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * xorshift64*, the same seed gives the same sequence on every machine
+ */
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+/**
+ * Fills a pool to an occupancy, then releases a random leased address and allocates another one, operations times.
+ * The occupancy of a sparse pool is taken relative to SPARSE_REFERENCE_SIZE addresses.
+ */
+static void run_case(struct AddressPool *pool, double occupancy, const struct Options *options, struct Results *results) {
+    uint64_t size = pool->is_sparse ? SPARSE_REFERENCE_SIZE : address_pool_size(pool);
+    uint64_t target = (uint64_t) ((double) size * occupancy), random_state = options->seed, started;
+    struct in6_addr *leases;
+
+    if (target == 0)
+        target = 1;
+    leases = (struct in6_addr *) malloc(target * sizeof (struct in6_addr));
+    if (leases == NULL)
+        fail("malloc() - run_case");
+
+    memset(results, 0, sizeof (struct Results));
+    started = now_ns();
+    for (; results->leased < target; results->leased++)
+        if (!address_pool_allocate(pool, (uint32_t) (results->leased % options->shards), &leases[results->leased]))
+            break;
+    results->fill_ns = results->leased == 0 ? 0 : (double) (now_ns() - started) / (double) results->leased;
+
+    started = now_ns();
+    for (uint64_t i = 0; i < options->operations && results->leased > 0; i++) {
+        uint64_t victim = next_random(&random_state) % results->leased;
+
+        address_pool_release(pool, &leases[victim]);
+        if (!address_pool_allocate(pool, (uint32_t) (i % options->shards), &leases[victim]))
+            fail("address_pool_allocate() - run_case - pool exhausted after a release");
+    }
+    results->churn_ns = (double) (now_ns() - started) / (double) options->operations;
+    results->retries = address_pool_retries(pool);
+    results->steals = address_pool_steals(pool);
+    free(leases);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-s seed] [-n release and allocate pairs per case] [-j shards]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_options(int argc, char *argv[], struct Options *options) {
+    int option;
+
+    *options = (struct Options) {
+            .seed = DEFAULT_SEED,
+            .operations = DEFAULT_OPERATIONS,
+            .shards = DEFAULT_SHARDS,
+    };
+
+    while ((option = getopt(argc, argv, "s:n:j:")) != -1) {
+        switch (option) {
+            case 's':
+                options->seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'n':
+                options->operations = strtoull(optarg, NULL, 10);
+                break;
+            case 'j':
+                options->shards = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (options->seed == 0)
+        options->seed = DEFAULT_SEED;
+    if (options->operations == 0 || options->shards == 0)
+        usage(argv[0]);
+}
+
+/**
+ * Benchmarks the address pool at several sizes and occupancies. Every case prints one JSON object on its own line:
+ * nanoseconds per allocation while the pool fills, nanoseconds per release and allocation pair once it is full, and
+ * the retries and steals of the allocators.
+ */
+int main(int argc, char *argv[]) {
+    struct Options options;
+
+    parse_options(argc, argv, &options);
+
+    for (size_t i = 0; i < sizeof (POOLS) / sizeof (POOLS[0]); i++) {
+        for (size_t j = 0; j < sizeof (OCCUPANCIES) / sizeof (OCCUPANCIES[0]); j++) {
+            struct in6_addr interface_address;
+            struct AddressPool pool;
+            struct Results results;
+
+            if (!address_parse(POOLS[i].address, &interface_address) ||
+                !address_pool_init(&pool, &interface_address, POOLS[i].prefix_length, options.shards))
+                fail("address_pool_init() - main");
+
+            run_case(&pool, OCCUPANCIES[j], &options, &results);
+            printf("{\"benchmark\":\"allocator\",\"pool\":\"%s/%d\",\"allocator\":\"%s\",\"shards\":%u,\"size\":%llu,"
+                   "\"occupancy\":%.3f,\"leased\":%llu,\"seed\":%llu,\"operations\":%llu,\"fill_ns_per_op\":%.1f,"
+                   "\"churn_ns_per_op\":%.1f,\"retries\":%llu,\"steals\":%llu}\n",
+                   POOLS[i].address, POOLS[i].prefix_length, pool.is_sparse ? "sparse" : "bitmap", options.shards,
+                   (unsigned long long) address_pool_size(&pool), OCCUPANCIES[j],
+                   (unsigned long long) results.leased, (unsigned long long) options.seed,
+                   (unsigned long long) options.operations, results.fill_ns, results.churn_ns,
+                   (unsigned long long) results.retries, (unsigned long long) results.steals);
+            fflush(stdout);
+            address_pool_destroy(&pool);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "address.h"
+#include "config_writer.h"
+#include "key.h"
+#include "peer_table.h"
+
+#define DEFAULT_SEED 1
+#define DEFAULT_REPETITIONS 5
+#define DEFAULT_DIRECTORY "/tmp"
+#define PEER_TABLE_BUCKETS 1024
+#define LOOKUPS 100000
+
+static const uint32_t PEER_COUNTS[] = {100, 1000, 10000, 50000};
+
+static const char CONFIG_BASE[] = "[Interface]\nAddress = 10.0.0.1/8\nListenPort = 51820\n"
+                                  "PrivateKey = AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=\n";
+
+/**
+ * Options of a run
+ */
+struct Options {
+    uint64_t seed;
+    uint32_t repetitions;
+    const char *directory;
+};
+
+/**
+ * Outcome of one peer count, durations are the median of the repetitions
+ */
+struct Results {
+    uint64_t rewrite_ns;
+    uint64_t append_ns;
+    uint64_t remove_ns;
+    double lookup_key_ns;
+    double lookup_address_ns;
+    size_t config_bytes;
+};
+
+static uint64_t now_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static void fail(const char *message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * xorshift64*, the same seed gives the same sequence on every machine
+ */
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static int compare_durations(const void *first, const void *second) {
+    uint64_t a = *(const uint64_t *) first, b = *(const uint64_t *) second;
+
+    return (a > b) - (a < b);
+}
+
+static uint64_t median(uint64_t *durations, uint32_t count) {
+    qsort(durations, count, sizeof (uint64_t), compare_durations);
+    return durations[count / 2];
+}
+
+/**
+ * Adds the peer number @param index, with a random public key and the index-th address of 10.0.0.0/8
+ */
+static struct Peer *add_peer(struct PeerTable *peers, uint32_t index, uint64_t *random_state) {
+    char public_key[KEY_BASE64_LENGTH + 1], allowed_ips[PEER_ALLOWED_IPS_LENGTH], endpoint[PEER_ENDPOINT_LENGTH];
+    uint8_t key[KEY_LENGTH];
+    struct in6_addr address;
+    struct Peer *peer;
+
+    for (size_t i = 0; i < KEY_LENGTH; i += sizeof (uint64_t)) {
+        uint64_t value = next_random(random_state);
+
+        memcpy(key + i, &value, sizeof (value));
+    }
+    key_to_base64(key, public_key);
+    address_from_ipv4(&address, htonl(0x0A000002u + index));
+    address_format(&address, allowed_ips, sizeof (allowed_ips));
+    strcat(allowed_ips, "/32");
+    snprintf(endpoint, sizeof (endpoint), "192.0.2.%u", index % 250 + 1);
+
+    peer = peer_table_add(peers, public_key, allowed_ips, endpoint, "51820", &address);
+    if (peer == NULL)
+        fail("peer_table_add() - add_peer");
+    return peer;
+}
+
+/**
+ * Measures, for a table of @param count peers: a rewrite of the whole config file, the append of one new peer, the
+ * removal of a random peer followed by the rewrite it needs, and lookups by public key and by address
+ */
+static void run_case(uint32_t count, const struct Options *options, const char *path, struct Results *results) {
+    uint64_t *durations = (uint64_t *) malloc(options->repetitions * sizeof (uint64_t));
+    uint64_t random_state = options->seed, started;
+    struct Peer **peers = (struct Peer **) malloc((count + options->repetitions) * sizeof (struct Peer *));
+    struct ConfigWriter writer;
+    struct PeerTable table;
+    uint32_t total = count;
+
+    if (durations == NULL || peers == NULL || !peer_table_init(&table, PEER_TABLE_BUCKETS) ||
+        !config_writer_init(&writer, path))
+        fail("run_case - initialization");
+    for (uint32_t i = 0; i < count; i++)
+        peers[i] = add_peer(&table, i, &random_state);
+
+    for (uint32_t i = 0; i < options->repetitions; i++) {
+        started = now_ns();
+        if (!config_writer_write(&writer, CONFIG_BASE, sizeof (CONFIG_BASE) - 1, &table))
+            fail("config_writer_write() - run_case");
+        durations[i] = now_ns() - started;
+    }
+    results->rewrite_ns = median(durations, options->repetitions);
+    results->config_bytes = writer.length;
+
+    for (uint32_t i = 0; i < options->repetitions; i++) {
+        struct Peer *peer = add_peer(&table, total, &random_state);
+
+        peers[total++] = peer;
+        started = now_ns();
+        if (!config_writer_append(&writer, peer))
+            fail("config_writer_append() - run_case");
+        durations[i] = now_ns() - started;
+    }
+    results->append_ns = median(durations, options->repetitions);
+
+    started = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        if (peer_table_find_by_key(&table, peers[next_random(&random_state) % total]->public_key) == NULL)
+            fail("peer_table_find_by_key() - run_case");
+    results->lookup_key_ns = (double) (now_ns() - started) / LOOKUPS;
+    started = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        if (peer_table_find_by_address(&table, &peers[next_random(&random_state) % total]->address) == NULL)
+            fail("peer_table_find_by_address() - run_case");
+    results->lookup_address_ns = (double) (now_ns() - started) / LOOKUPS;
+
+    for (uint32_t i = 0; i < options->repetitions; i++) {
+        uint32_t victim = (uint32_t) (next_random(&random_state) % total);
+        struct Peer *peer = peers[victim];
+
+        peers[victim] = peers[--total];
+        started = now_ns();
+        peer_table_detach(&table, peer);
+        if (!config_writer_write(&writer, CONFIG_BASE, sizeof (CONFIG_BASE) - 1, &table))
+            fail("config_writer_write() - run_case");
+        durations[i] = now_ns() - started;
+        peer_table_release(&table, peer);
+    }
+    results->remove_ns = median(durations, options->repetitions);
+
+    config_writer_destroy(&writer);
+    peer_table_destroy(&table);
+    unlink(path);
+    free(peers);
+    free(durations);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-s seed] [-r repetitions per measure] [-d directory of the config file]\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_options(int argc, char *argv[], struct Options *options) {
+    int option;
+
+    *options = (struct Options) {
+            .seed = DEFAULT_SEED,
+            .repetitions = DEFAULT_REPETITIONS,
+            .directory = DEFAULT_DIRECTORY,
+    };
+
+    while ((option = getopt(argc, argv, "s:r:d:")) != -1) {
+        switch (option) {
+            case 's':
+                options->seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'r':
+                options->repetitions = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                options->directory = optarg;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (options->seed == 0)
+        options->seed = DEFAULT_SEED;
+    if (options->repetitions == 0)
+        usage(argv[0]);
+}
+
+/**
+ * Benchmarks the config file and the peer table at several peer counts. Every count prints one JSON object on its own
+ * line. The config file is written in a directory of its own, removed at the end.
+ */
+int main(int argc, char *argv[]) {
+    char directory[PATH_MAX], path[PATH_MAX + sizeof ("/wg_bench.conf")];
+    struct Options options;
+
+    parse_options(argc, argv, &options);
+    if (snprintf(directory, sizeof (directory), "%s/bench_config.XXXXXX", options.directory) >= (int) sizeof (directory) ||
+        mkdtemp(directory) == NULL)
+        fail("mkdtemp() - main");
+    snprintf(path, sizeof (path), "%s/wg_bench.conf", directory);
+
+    for (size_t i = 0; i < sizeof (PEER_COUNTS) / sizeof (PEER_COUNTS[0]); i++) {
+        struct Results results;
+
+        run_case(PEER_COUNTS[i], &options, path, &results);
+        printf("{\"benchmark\":\"config\",\"peers\":%u,\"seed\":%llu,\"repetitions\":%u,\"config_bytes\":%zu,"
+               "\"rewrite_ns\":%llu,\"append_ns\":%llu,\"remove_ns\":%llu,\"lookup_key_ns\":%.1f,"
+               "\"lookup_address_ns\":%.1f}\n",
+               PEER_COUNTS[i], (unsigned long long) options.seed, options.repetitions, results.config_bytes,
+               (unsigned long long) results.rewrite_ns, (unsigned long long) results.append_ns,
+               (unsigned long long) results.remove_ns, results.lookup_key_ns, results.lookup_address_ns);
+        fflush(stdout);
+    }
+    rmdir(directory);
+    return 0;
+}
@@ -0,0 +1,616 @@
+#include <endian.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "cluster.h"
+#include "event_log.h"
+
+#define CLUSTER_MAGIC 0x57474443u
+#define CLUSTER_VERSION 1
+#define CLUSTER_TICK_MS 10
+#define CLUSTER_HEARTBEAT_MS 100
+#define CLUSTER_RETRANSMIT_MS 200
+#define CLUSTER_DEAD_MS 1000
+#define CLUSTER_WINDOW 4096
+#define CLUSTER_MAX_DATAGRAM 1400
+#define CLUSTER_MIN_EVENT_LENGTH (1 + 2 + 4 + 16 + 4)
+#define CLUSTER_MAX_EVENT_LENGTH (CLUSTER_MIN_EVENT_LENGTH + PEER_PUBLIC_KEY_LENGTH + PEER_ALLOWED_IPS_LENGTH + \
+                                  PEER_ENDPOINT_LENGTH + PEER_PORT_LENGTH)
+#define CLUSTER_INITIAL_LOG (64 * CLUSTER_MAX_EVENT_LENGTH)
+
+/**
+ * ClusterHeader structure, starts every datagram between nodes, every field is in network byte order. It is followed
+ * by event_count encoded events, numbered from first_sequence in the session of the sender.
+ *  - magic - uint32_t: CLUSTER_MAGIC
+ *  - version - uint8_t: CLUSTER_VERSION
+ *  - node - uint8_t: index of the sender
+ *  - event_count - uint16_t: number of events that follow
+ *  - incarnation - uint64_t: incarnation of the sender
+ *  - session - uint64_t: stream the events belong to
+ *  - acknowledged_session - uint64_t: stream of the receiver the acknowledgement is for
+ *  - acknowledged - uint64_t: last sequence number of that stream the sender received in order
+ *  - first_sequence - uint64_t: sequence number of the first event
+ */
+struct ClusterHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t node;
+    uint16_t event_count;
+    uint64_t incarnation;
+    uint64_t session;
+    uint64_t acknowledged_session;
+    uint64_t acknowledged;
+    uint64_t first_sequence;
+} __attribute__((packed));
+
+static uint64_t now_ms() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+/**
+ * Gives a number that no earlier session or incarnation of any node used: the wall clock in nanoseconds
+ */
+static uint64_t next_identifier(uint64_t previous) {
+    struct timespec now;
+    uint64_t identifier;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    identifier = (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+    return identifier > previous ? identifier : previous + 1;
+}
+
+static size_t put_text(uint8_t *buffer, const char *text) {
+    size_t length = strlen(text);
+
+    buffer[0] = (uint8_t) length;
+    memcpy(buffer + 1, text, length);
+    return 1 + length;
+}
+
+/**
+ * Encodes an event: type, pool, expiry and address, then the text fields, each after its length on one byte
+ * @return number of bytes written, at most CLUSTER_MAX_EVENT_LENGTH
+ */
+static size_t encode_event(uint8_t *buffer, uint8_t type, uint16_t pool, const struct Peer *peer) {
+    uint16_t network_pool = htons(pool);
+    uint32_t expires = htonl(type == CLUSTER_LEASE ? peer->expires : 0);
+    size_t length = 0;
+
+    buffer[length++] = type;
+    memcpy(buffer + length, &network_pool, sizeof (network_pool));
+    length += sizeof (network_pool);
+    memcpy(buffer + length, &expires, sizeof (expires));
+    length += sizeof (expires);
+    memcpy(buffer + length, peer->address.s6_addr, sizeof (peer->address.s6_addr));
+    length += sizeof (peer->address.s6_addr);
+    length += put_text(buffer + length, peer->public_key);
+    length += put_text(buffer + length, peer->allowed_ips);
+    length += put_text(buffer + length, peer->endpoint);
+    length += put_text(buffer + length, peer->port);
+    return length;
+}
+
+static bool get_text(const uint8_t *buffer, size_t length, size_t *offset, char *text, size_t size) {
+    size_t text_length;
+
+    if (*offset >= length)
+        return false;
+    text_length = buffer[(*offset)++];
+    if (text_length >= size || *offset + text_length > length)
+        return false;
+    memcpy(text, buffer + *offset, text_length);
+    text[text_length] = '\0';
+    *offset += text_length;
+    return true;
+}
+
+/**
+ * Decodes the event at @param offset, which is moved past it
+ * @return True, if a whole event was decoded
+ *         False, if the event is malformed
+ */
+static bool decode_event(const uint8_t *buffer, size_t length, size_t *offset, struct ClusterEvent *event) {
+    uint16_t pool;
+    uint32_t expires;
+
+    if (*offset + 1 + sizeof (pool) + sizeof (expires) + sizeof (event->address.s6_addr) > length)
+        return false;
+    event->type = buffer[(*offset)++];
+    memcpy(&pool, buffer + *offset, sizeof (pool));
+    *offset += sizeof (pool);
+    memcpy(&expires, buffer + *offset, sizeof (expires));
+    *offset += sizeof (expires);
+    memcpy(event->address.s6_addr, buffer + *offset, sizeof (event->address.s6_addr));
+    *offset += sizeof (event->address.s6_addr);
+    event->pool = ntohs(pool);
+    event->expires = ntohl(expires);
+
+    return (event->type == CLUSTER_LEASE || event->type == CLUSTER_RELEASE) &&
+           get_text(buffer, length, offset, event->public_key, sizeof (event->public_key)) &&
+           get_text(buffer, length, offset, event->allowed_ips, sizeof (event->allowed_ips)) &&
+           get_text(buffer, length, offset, event->endpoint, sizeof (event->endpoint)) &&
+           get_text(buffer, length, offset, event->port, sizeof (event->port));
+}
+
+/**
+ * Length of the encoded event at @param offset of a log, the log only holds events this node encoded
+ */
+static size_t event_length(const uint8_t *log, size_t offset) {
+    size_t length = CLUSTER_MIN_EVENT_LENGTH - 4;
+
+    for (int i = 0; i < 4; i++)
+        length += 1 + log[offset + length];
+    return length;
+}
+
+/**
+ * Drops the log of a link and starts a new session, the node gets the leases again through ClusterChange. The lock is
+ * held.
+ */
+static void reset_stream(struct ClusterLink *link) {
+    link->session = next_identifier(link->session);
+    link->log_start = 0;
+    link->log_length = 0;
+    link->acknowledged = 0;
+    link->published = 0;
+    link->sent = 0;
+    link->sent_offset = 0;
+}
+
+/**
+ * Appends an event to the log of a link, the lock is held. An event that does not fit in memory is dropped.
+ */
+static void append_event(struct ClusterLink *link, uint8_t type, uint16_t pool, const struct Peer *peer) {
+    if (link->log_length + CLUSTER_MAX_EVENT_LENGTH > link->log_capacity) {
+        if (link->log_start > 0) {
+            memmove(link->log, link->log + link->log_start, link->log_length - link->log_start);
+            link->log_length -= link->log_start;
+            link->sent_offset -= link->log_start;
+            link->log_start = 0;
+        }
+        if (link->log_length + CLUSTER_MAX_EVENT_LENGTH > link->log_capacity) {
+            size_t capacity = link->log_capacity == 0 ? CLUSTER_INITIAL_LOG : 2 * link->log_capacity;
+            uint8_t *log = (uint8_t *) realloc(link->log, capacity);
+
+            if (log == NULL) {
+                perror("realloc() - append_event");
+                return;
+            }
+            link->log = log;
+            link->log_capacity = capacity;
+        }
+    }
+
+    link->log_length += encode_event(link->log + link->log_length, type, pool, peer);
+    link->published++;
+}
+
+/**
+ * Forgets the events a node acknowledged, the lock is held
+ */
+static void acknowledge_events(struct ClusterLink *link, uint64_t acknowledged) {
+    if (acknowledged <= link->acknowledged || acknowledged > link->published)
+        return;
+
+    for (; link->acknowledged < acknowledged; link->acknowledged++)
+        link->log_start += event_length(link->log, link->log_start);
+    if (link->sent < acknowledged) {
+        link->sent = acknowledged;
+        link->sent_offset = link->log_start;
+    }
+    if (link->log_start == link->log_length) {
+        link->log_start = 0;
+        link->log_length = 0;
+        link->sent_offset = 0;
+    }
+}
+
+/**
+ * Sends a datagram to a node: the header, with the acknowledgement of its stream, then @param count events of the log
+ * from the offset of @param sequence. The lock is held.
+ */
+static void send_datagram(struct Cluster *cluster, struct ClusterLink *link, uint64_t sequence, size_t offset,
+                          size_t length, uint16_t count, uint64_t now) {
+    uint8_t datagram[CLUSTER_MAX_DATAGRAM];
+    struct ClusterHeader header = {
+            .magic = htonl(CLUSTER_MAGIC),
+            .version = CLUSTER_VERSION,
+            .node = (uint8_t) cluster->node,
+            .event_count = htons(count),
+            .incarnation = htobe64(cluster->incarnation),
+            .session = htobe64(link->session),
+            .acknowledged_session = htobe64(link->remote_session),
+            .acknowledged = htobe64(link->received),
+            .first_sequence = htobe64(sequence),
+    };
+
+    memcpy(datagram, &header, sizeof (header));
+    if (length > 0)
+        memcpy(datagram + sizeof (header), link->log + offset, length);
+    if (sendto(cluster->fd, datagram, sizeof (header) + length, MSG_DONTWAIT, (struct sockaddr *) &link->address,
+               sizeof (link->address)) < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+        perror("sendto() - send_datagram");
+    link->acknowledge = false;
+    link->spoken_ms = now;
+}
+
+/**
+ * Sends the events of a link that are not in flight yet, up to CLUSTER_WINDOW in flight, packed in as few datagrams as
+ * possible. The lock is held.
+ * @return True, if something was sent
+ *         False, otherwise
+ */
+static bool send_events(struct Cluster *cluster, struct ClusterLink *link, uint64_t now) {
+    bool sent = false;
+
+    while (link->sent < link->published && link->sent - link->acknowledged < CLUSTER_WINDOW) {
+        size_t offset = link->sent_offset, length = 0;
+        uint16_t count = 0;
+
+        while (link->sent + count < link->published && link->sent + count - link->acknowledged < CLUSTER_WINDOW) {
+            size_t next = event_length(link->log, offset + length);
+
+            if (sizeof (struct ClusterHeader) + length + next > CLUSTER_MAX_DATAGRAM)
+                break;
+            length += next;
+            count++;
+        }
+        send_datagram(cluster, link, link->sent + 1, offset, length, count, now);
+        stats_add(&cluster->stats, STATS_CLUSTER_EVENTS_SENT, count);
+        link->sent += count;
+        link->sent_offset += length;
+        link->sent_ms = now;
+        sent = true;
+    }
+    return sent;
+}
+
+/**
+ * Runs the timers of every link: declares dead the nodes that were not heard from, sends again the events that were not
+ * acknowledged in time, sends the new events, then the acknowledgements and heartbeats still due
+ * @param cluster
+ * @param now - uint64_t: milliseconds
+ */
+static void tick(struct Cluster *cluster, uint64_t now) {
+    bool died[CLUSTER_MAX_NODES] = {false};
+
+    pthread_mutex_lock(&cluster->lock);
+    for (uint32_t i = 0; i < cluster->node_count; i++) {
+        struct ClusterLink *link = &cluster->links[i];
+
+        if (i == cluster->node)
+            continue;
+        if (link->alive && now - link->heard_ms > CLUSTER_DEAD_MS) {
+            link->alive = false;
+            reset_stream(link);
+            died[i] = true;
+        }
+
+        if (link->alive && link->sent > link->acknowledged && now - link->sent_ms >= CLUSTER_RETRANSMIT_MS) {
+            stats_add(&cluster->stats, STATS_CLUSTER_RETRANSMITS, link->sent - link->acknowledged);
+            link->sent = link->acknowledged;
+            link->sent_offset = link->log_start;
+        }
+        if (link->alive && send_events(cluster, link, now))
+            continue;
+        if (link->acknowledge || now - link->spoken_ms >= CLUSTER_HEARTBEAT_MS)
+            send_datagram(cluster, link, link->sent + 1, 0, 0, 0, now);
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    for (uint32_t i = 0; i < cluster->node_count; i++) {
+        if (died[i]) {
+            event_log(EVENT_LOG_WARNING, EVENT_NODE_DEAD, i, 0, 0, NULL, NULL);
+            cluster->change(cluster->context, i, false);
+        }
+    }
+    stats_set(&cluster->stats, STATS_CLUSTER_NODES_ALIVE, cluster_nodes_alive(cluster));
+}
+
+/**
+ * Handles a datagram of another node: the node is alive, the events of its stream that follow the last one received
+ * are applied and the events it acknowledged are forgotten. A node that was dead or restarted joins again. Every node
+ * sends from the address it listens on, a datagram from any other source is dropped.
+ */
+static void receive_datagram(struct Cluster *cluster, const struct sockaddr_in *source, const uint8_t *datagram,
+                             size_t length, uint64_t now) {
+    struct ClusterHeader header;
+    struct ClusterLink *link;
+    uint64_t first_sequence;
+    size_t offset = sizeof (header), applied = 0;
+    uint16_t event_count;
+    bool joined;
+
+    if (length < sizeof (header))
+        return;
+    memcpy(&header, datagram, sizeof (header));
+    if (ntohl(header.magic) != CLUSTER_MAGIC || header.version != CLUSTER_VERSION || header.node >= cluster->node_count ||
+        header.node == cluster->node)
+        return;
+    link = &cluster->links[header.node];
+    if (source->sin_addr.s_addr != link->address.sin_addr.s_addr || source->sin_port != link->address.sin_port)
+        return;
+    first_sequence = be64toh(header.first_sequence);
+    event_count = ntohs(header.event_count);
+
+    pthread_mutex_lock(&cluster->lock);
+    joined = !link->alive || link->incarnation != be64toh(header.incarnation);
+    if (joined) {
+        link->alive = true;
+        link->incarnation = be64toh(header.incarnation);
+        reset_stream(link);
+    }
+    link->heard_ms = now;
+    if (be64toh(header.session) != link->remote_session) {
+        link->remote_session = be64toh(header.session);
+        link->received = 0;
+    }
+    if (be64toh(header.acknowledged_session) == link->session)
+        acknowledge_events(link, be64toh(header.acknowledged));
+    pthread_mutex_unlock(&cluster->lock);
+
+    if (joined) {
+        event_log(EVENT_LOG_INFO, EVENT_NODE_JOINED, header.node, 0, 0, NULL, NULL);
+        stats_add(&cluster->stats, STATS_CLUSTER_RESYNCS, 1);
+        cluster->change(cluster->context, header.node, true);
+    }
+    if (event_count == 0)
+        return;
+
+    /* events already received are skipped, events after a gap are dropped and sent again by the node */
+    link->acknowledge = true;
+    if (first_sequence == 0 || first_sequence > link->received + 1)
+        return;
+    for (uint64_t sequence = first_sequence; sequence < first_sequence + event_count; sequence++) {
+        struct ClusterEvent *event = &cluster->events[applied];
+
+        if (!decode_event(datagram, length, &offset, event))
+            break;
+        /* the fields of a peer end up in the config file, an event whose fields are not valid is skipped */
+        if (sequence == link->received + 1) {
+            link->received++;
+            if (peer_table_valid_fields(event->public_key, event->allowed_ips, event->endpoint, event->port))
+                applied++;
+        }
+    }
+    if (applied > 0) {
+        cluster->apply(cluster->context, cluster->events, applied);
+        stats_add(&cluster->stats, STATS_CLUSTER_EVENTS_RECEIVED, applied);
+    }
+}
+
+static void *serve_cluster(void *argument) {
+    struct Cluster *cluster = (struct Cluster *) argument;
+    struct pollfd descriptors[2] = {
+            {.fd = cluster->fd, .events = POLLIN},
+            {.fd = cluster->stop, .events = POLLIN},
+    };
+    uint64_t next_tick = now_ms();
+
+    for (;;) {
+        uint64_t now = now_ms();
+
+        if (now >= next_tick) {
+            tick(cluster, now);
+            next_tick = now + CLUSTER_TICK_MS;
+        }
+        if (poll(descriptors, 2, (int) (next_tick - now)) < 0)
+            continue;
+        if (descriptors[1].revents != 0)
+            return NULL;
+        if (descriptors[0].revents == 0)
+            continue;
+
+        for (;;) {
+            uint8_t datagram[CLUSTER_MAX_DATAGRAM];
+            struct sockaddr_in source;
+            socklen_t source_length = sizeof (source);
+            ssize_t received = recvfrom(cluster->fd, datagram, sizeof (datagram), MSG_DONTWAIT,
+                                        (struct sockaddr *) &source, &source_length);
+
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received < 0)
+                break;
+            if (source_length == sizeof (source) && source.sin_family == AF_INET)
+                receive_datagram(cluster, &source, datagram, (size_t) received, now_ms());
+        }
+    }
+}
+
+/**
+ * Parses "host:port,host:port,..." into the addresses of the links
+ * @return number of nodes, 0 if the list is invalid
+ */
+static uint32_t parse_nodes(struct Cluster *cluster, const char *nodes) {
+    uint32_t count = 0;
+
+    while (*nodes != '\0') {
+        const char *end = strchr(nodes, ','), *separator;
+        char host[INET_ADDRSTRLEN];
+        size_t length = end == NULL ? strlen(nodes) : (size_t) (end - nodes);
+        long port;
+
+        separator = memchr(nodes, ':', length);
+        if (count == CLUSTER_MAX_NODES || separator == NULL || (size_t) (separator - nodes) >= sizeof (host))
+            return 0;
+        memcpy(host, nodes, (size_t) (separator - nodes));
+        host[separator - nodes] = '\0';
+        port = strtol(separator + 1, NULL, 10);
+        if (port <= 0 || port > 65535)
+            return 0;
+
+        cluster->links[count].address.sin_family = AF_INET;
+        cluster->links[count].address.sin_port = htons((uint16_t) port);
+        if (inet_pton(AF_INET, host, &cluster->links[count].address.sin_addr) != 1)
+            return 0;
+        count++;
+        nodes += length;
+        if (*nodes == ',')
+            nodes++;
+    }
+    return count;
+}
+
+/**
+ * Binds the socket of this node, the thread is started by cluster_start() once the events can be applied. Every other
+ * node is presumed alive until it had CLUSTER_DEAD_MS to be heard from.
+ * @param cluster
+ * @param nodes - *char: "host:port" of every node of the cluster, separated by commas, in the same order on every node
+ * @param node - uint32_t: index of this node in the list
+ * @param apply - ClusterApply: applies the events received
+ * @param change - ClusterChange: told when nodes join or leave
+ * @param context - *void: given to apply and change
+ * @return True, if the socket is bound
+ *         False, otherwise
+ */
+bool cluster_open(struct Cluster *cluster, const char *nodes, uint32_t node, ClusterApply apply, ClusterChange change,
+                  void *context) {
+    uint64_t now = now_ms();
+
+    memset(cluster, 0, sizeof (struct Cluster));
+    cluster->node_count = parse_nodes(cluster, nodes);
+    if (cluster->node_count == 0 || node >= cluster->node_count) {
+        fprintf(stderr, "cluster_open - invalid node list or node index\n");
+        return false;
+    }
+    cluster->node = node;
+    cluster->incarnation = next_identifier(0);
+    cluster->apply = apply;
+    cluster->change = change;
+    cluster->context = context;
+    stats_init(&cluster->stats);
+    for (uint32_t i = 0; i < cluster->node_count; i++) {
+        cluster->links[i].alive = true;
+        cluster->links[i].heard_ms = now;
+        reset_stream(&cluster->links[i]);
+    }
+
+    cluster->events = (struct ClusterEvent *) calloc(CLUSTER_MAX_DATAGRAM / CLUSTER_MIN_EVENT_LENGTH,
+                                                        sizeof (struct ClusterEvent));
+    if (cluster->events == NULL)
+        return false;
+    cluster->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (cluster->fd < 0)
+        goto FREE;
+    if (bind(cluster->fd, (struct sockaddr *) &cluster->links[node].address, sizeof (struct sockaddr_in)) < 0) {
+        perror("bind() - cluster_open");
+        goto FAIL;
+    }
+    cluster->stop = eventfd(0, EFD_CLOEXEC);
+    if (cluster->stop < 0)
+        goto FAIL;
+    pthread_mutex_init(&cluster->lock, NULL);
+    return true;
+
+    FAIL:
+    close(cluster->fd);
+    FREE:
+    free(cluster->events);
+    return false;
+}
+
+bool cluster_start(struct Cluster *cluster) {
+    return pthread_create(&cluster->thread, NULL, serve_cluster, cluster) == 0;
+}
+
+/**
+ * Stops the thread, events that were not acknowledged are lost; the nodes get the leases again when this node rejoins
+ * @param cluster
+ */
+void cluster_close(struct Cluster *cluster) {
+    eventfd_write(cluster->stop, 1);
+    pthread_join(cluster->thread, NULL);
+    close(cluster->stop);
+    close(cluster->fd);
+    for (uint32_t i = 0; i < cluster->node_count; i++)
+        free(cluster->links[i].log);
+    free(cluster->events);
+    pthread_mutex_destroy(&cluster->lock);
+}
+
+/**
+ * Replicates the leases changed by a commit to every node alive, they are sent by the next tick
+ * @param cluster
+ * @param pool - uint16_t: pool ID of the interface
+ * @param leases - *DataplaneChange: peers that got or kept an address, and peers that gave it back with remove set;
+ *        they are read before the function returns
+ * @param count - size_t: number of leases
+ */
+void cluster_publish(struct Cluster *cluster, uint16_t pool, const struct DataplaneChange *leases, size_t count) {
+    if (count == 0)
+        return;
+
+    pthread_mutex_lock(&cluster->lock);
+    for (uint32_t i = 0; i < cluster->node_count; i++) {
+        if (i == cluster->node || !cluster->links[i].alive)
+            continue;
+        for (size_t j = 0; j < count; j++)
+            append_event(&cluster->links[i], leases[j].remove ? CLUSTER_RELEASE : CLUSTER_LEASE, pool, leases[j].peer);
+    }
+    pthread_mutex_unlock(&cluster->lock);
+}
+
+/**
+ * Replicates the lease of a peer to one node, used to send every lease to a node that joined
+ * @param cluster
+ * @param node - uint32_t: index of the node
+ * @param pool - uint16_t: pool ID of the interface
+ * @param peer
+ */
+void cluster_publish_to(struct Cluster *cluster, uint32_t node, uint16_t pool, const struct Peer *peer) {
+    pthread_mutex_lock(&cluster->lock);
+    if (cluster->links[node].alive)
+        append_event(&cluster->links[node], CLUSTER_LEASE, pool, peer);
+    pthread_mutex_unlock(&cluster->lock);
+}
+
+static bool node_alive(const struct Cluster *cluster, uint32_t node) {
+    return node == cluster->node || cluster->links[node].alive;
+}
+
+/**
+ * Finds the node a partition belongs to: its home node while that node is alive, otherwise one of the nodes alive,
+ * chosen by the rank of the partition among the partitions of its home node. Called by the thread of the cluster, or
+ * before it starts.
+ * @param cluster
+ * @param partition - uint32_t: index of the partition
+ * @return index of the node
+ */
+uint32_t cluster_owner(const struct Cluster *cluster, uint32_t partition) {
+    uint32_t home = partition % cluster->node_count, rank;
+
+    if (node_alive(cluster, home))
+        return home;
+    rank = partition / cluster->node_count % cluster_nodes_alive(cluster);
+    for (uint32_t i = 0; i < cluster->node_count; i++) {
+        if (!node_alive(cluster, i))
+            continue;
+        if (rank == 0)
+            return i;
+        rank--;
+    }
+    return cluster->node;
+}
+
+/**
+ * @return number of nodes alive, this one included
+ */
+uint32_t cluster_nodes_alive(const struct Cluster *cluster) {
+    uint32_t alive = 0;
+
+    for (uint32_t i = 0; i < cluster->node_count; i++)
+        alive += node_alive(cluster, i);
+    return alive;
+}
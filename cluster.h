@@ -0,0 +1,144 @@
+#ifndef DHCP_V1_CLUSTER_H
+#define DHCP_V1_CLUSTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "dataplane.h"
+#include "peer_table.h"
+#include "stats.h"
+
+#define CLUSTER_MAX_NODES 16
+#define CLUSTER_LEASE 1
+#define CLUSTER_RELEASE 2
+
+/**
+ * ClusterEvent structure, a lease change replicated between the nodes of a cluster
+ *  - type - uint8_t: CLUSTER_LEASE when a peer got or kept an address, CLUSTER_RELEASE when it gave it back
+ *  - pool - uint16_t: pool ID of the interface the lease belongs to
+ *  - expires - uint32_t: when the lease expires, in seconds since the epoch, 0 if it never does
+ *  - address - in6_addr: leased address, IPv4-mapped for IPv4
+ *  - public_key, allowed_ips, endpoint, port - char[]: fields of the peer, as written in the config file
+ */
+struct ClusterEvent {
+    uint8_t type;
+    uint16_t pool;
+    uint32_t expires;
+    struct in6_addr address;
+    char public_key[PEER_PUBLIC_KEY_LENGTH];
+    char allowed_ips[PEER_ALLOWED_IPS_LENGTH];
+    char endpoint[PEER_ENDPOINT_LENGTH];
+    char port[PEER_PORT_LENGTH];
+};
+
+/**
+ * Applies events received from another node, in the order that node published them
+ * @param context - *void: context given to cluster_open()
+ * @param events - *ClusterEvent
+ * @param count - size_t: number of events
+ */
+typedef void (*ClusterApply)(void *context, const struct ClusterEvent *events, size_t count);
+
+/**
+ * Tells that a node joined or left the cluster, the owners of the partitions changed. A node that joins, or comes back
+ * after a restart, has to be sent every lease it may have missed.
+ * @param context - *void: context given to cluster_open()
+ * @param node - uint32_t: index of the node
+ * @param joined - bool: True, if the node joined
+ */
+typedef void (*ClusterChange)(void *context, uint32_t node, bool joined);
+
+/**
+ * ClusterLink structure, the replication stream between this node and another one. Events sent to the node are kept,
+ * encoded, until the node acknowledges them; a node that is not heard from for CLUSTER_DEAD_MS is dead and its
+ * events are dropped, it gets every lease again when it comes back.
+ *  - address - sockaddr_in: where the node listens
+ *  - alive - bool: True, while the node is heard from; nodes are presumed alive until they had time to speak
+ *  - incarnation - uint64_t: incarnation of the node, changes when it restarts, 0 until it is heard from
+ *  - heard_ms - uint64_t: last time a datagram of the node was received
+ *  - session - uint64_t: stream of events sent to the node, a new one starts whenever the log is dropped
+ *  - remote_session - uint64_t: stream of events received from the node
+ *  - log - *uint8_t: encoded events not acknowledged yet, from log_start to log_length
+ *  - log_start, log_length, log_capacity - size_t: bytes of log
+ *  - acknowledged - uint64_t: last sequence number the node received, the log starts after it
+ *  - published - uint64_t: last sequence number given to an event for the node
+ *  - sent - uint64_t: last sequence number sent, the events up to it are in flight
+ *  - sent_offset - size_t: offset in the log of the first event after sent
+ *  - sent_ms - uint64_t: last time events were sent, the in flight events are sent again after CLUSTER_RETRANSMIT_MS
+ *  - received - uint64_t: last sequence number received from the node in order
+ *  - acknowledge - bool: True, if events were received since the last acknowledgement
+ *  - spoken_ms - uint64_t: last time a datagram was sent to the node
+ */
+struct ClusterLink {
+    struct sockaddr_in address;
+    bool alive;
+    uint64_t incarnation;
+    uint64_t heard_ms;
+    uint64_t session;
+    uint64_t remote_session;
+
+    uint8_t *log;
+    size_t log_start;
+    size_t log_length;
+    size_t log_capacity;
+    uint64_t acknowledged;
+    uint64_t published;
+    uint64_t sent;
+    size_t sent_offset;
+    uint64_t sent_ms;
+
+    uint64_t received;
+    bool acknowledge;
+    uint64_t spoken_ms;
+};
+
+/**
+ * Cluster structure, a node of an active/active cluster. Every node serves clients from the partitions of the address
+ * pools it owns, replicates the leases it changes to every other node over UDP, and takes over the partitions of the
+ * nodes that die. Partition p belongs to node p % node_count while it is alive; the partitions of dead nodes are shared
+ * between the nodes alive, in an order every node computes the same way.
+ * A thread serves the socket: it sends the events published since its last tick in as few datagrams as possible,
+ * acknowledges the events received once per tick and sends a heartbeat when it has nothing else to say.
+ *  - fd - int: UDP socket bound to the address of this node
+ *  - stop - int: eventfd that asks the thread to stop
+ *  - thread - pthread_t: thread that serves the socket
+ *  - lock - pthread_mutex_t: protects the logs of the links, taken by the threads that publish events
+ *  - node - uint32_t: index of this node
+ *  - node_count - uint32_t: number of nodes, this one included
+ *  - incarnation - uint64_t: incarnation of this node
+ *  - links - ClusterLink[]: indexed by node, the link of this node is not used
+ *  - apply - ClusterApply: applies the events received
+ *  - change - ClusterChange: told when nodes join or leave
+ *  - context - *void: given to apply and change
+ *  - events - *ClusterEvent: events of the datagram being applied
+ *  - stats - Stats: counters of the replication, written by the thread of the socket
+ */
+struct Cluster {
+    int fd;
+    int stop;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    uint32_t node;
+    uint32_t node_count;
+    uint64_t incarnation;
+    struct ClusterLink links[CLUSTER_MAX_NODES];
+    ClusterApply apply;
+    ClusterChange change;
+    void *context;
+    struct ClusterEvent *events;
+    struct Stats stats;
+};
+
+bool cluster_open(struct Cluster *cluster, const char *nodes, uint32_t node, ClusterApply apply, ClusterChange change,
+                  void *context);
+bool cluster_start(struct Cluster *cluster);
+void cluster_close(struct Cluster *cluster);
+void cluster_publish(struct Cluster *cluster, uint16_t pool, const struct DataplaneChange *leases, size_t count);
+void cluster_publish_to(struct Cluster *cluster, uint32_t node, uint16_t pool, const struct Peer *peer);
+uint32_t cluster_owner(const struct Cluster *cluster, uint32_t partition);
+uint32_t cluster_nodes_alive(const struct Cluster *cluster);
+
+#endif //DHCP_V1_CLUSTER_H
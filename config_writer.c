@@ -0,0 +1,165 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config_writer.h"
+
+#define PEER_SECTION_LENGTH (PEER_PUBLIC_KEY_LENGTH + PEER_ALLOWED_IPS_LENGTH + PEER_ENDPOINT_LENGTH + \
+                             PEER_PORT_LENGTH + 64)
+
+/**
+ * Makes room for @param length more bytes in the buffer
+ */
+static bool reserve(struct ConfigWriter *writer, size_t length) {
+    size_t capacity = writer->capacity == 0 ? 4096 : writer->capacity;
+    char *buffer;
+
+    if (writer->length + length <= writer->capacity)
+        return true;
+
+    while (capacity < writer->length + length)
+        capacity *= 2;
+    buffer = (char *) realloc(writer->buffer, capacity);
+    if (buffer == NULL)
+        return false;
+
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    return true;
+}
+
+/**
+ * Formats the [Peer] section of a peer in the format expected by wg-quick, IPv6 endpoints are bracketed
+ */
+static bool format_peer(struct ConfigWriter *writer, const struct Peer *peer) {
+    bool ipv6 = strchr(peer->endpoint, ':') != NULL;
+
+    if (!reserve(writer, PEER_SECTION_LENGTH))
+        return false;
+
+    writer->length += (size_t) snprintf(writer->buffer + writer->length, PEER_SECTION_LENGTH,
+                                        "\n[Peer]\nPublicKey = %s\nAllowedIPs = %s\nEndpoint = %s%s%s:%s\n",
+                                        peer->public_key, peer->allowed_ips, ipv6 ? "[" : "", peer->endpoint,
+                                        ipv6 ? "]" : "", peer->port);
+    return true;
+}
+
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        length -= (size_t) written;
+    }
+    return true;
+}
+
+/**
+ * Prepares a writer for a config file, the directory of the file has to exist
+ * @param writer
+ * @param path - *char: config file
+ * @return True, if the directory of the config file could be opened
+ *         False, otherwise
+ */
+bool config_writer_init(struct ConfigWriter *writer, const char *path) {
+    char directory[PATH_MAX];
+
+    writer->directory_fd = -1;
+    writer->buffer = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+    if (snprintf(writer->path, sizeof (writer->path), "%s", path) >= (int) sizeof (writer->path) ||
+        snprintf(writer->temporary_path, sizeof (writer->temporary_path), "%s%s", path,
+                 CONFIG_WRITER_TEMPORARY_SUFFIX) >= (int) sizeof (writer->temporary_path))
+        return false;
+
+    snprintf(directory, sizeof (directory), "%s", path);
+    writer->directory_fd = open(dirname(directory), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return writer->directory_fd >= 0;
+}
+
+void config_writer_destroy(struct ConfigWriter *writer) {
+    if (writer->directory_fd >= 0)
+        close(writer->directory_fd);
+    free(writer->buffer);
+    writer->directory_fd = -1;
+    writer->buffer = NULL;
+    writer->capacity = 0;
+}
+
+/**
+ * Replaces the config file: @param base followed by every peer of the table is written to a temporary file, synced and
+ * renamed over the config file, so readers see either the old or the new config, never a partial one
+ * @param writer
+ * @param base - *char: configuration of the interface
+ * @param base_length - size_t: length of @param base
+ * @param peers - *PeerTable: peers written in insertion order
+ * @return True, if the config file was replaced
+ *         False, otherwise; the previous config file is left untouched
+ */
+bool config_writer_write(struct ConfigWriter *writer, const char *base, size_t base_length,
+                         const struct PeerTable *peers) {
+    int fd;
+
+    writer->length = 0;
+    if (!reserve(writer, base_length))
+        return false;
+    memcpy(writer->buffer, base, base_length);
+    writer->length = base_length;
+
+    for (const struct Peer *peer = peers->head; peer != NULL; peer = peer->next)
+        if (!format_peer(writer, peer))
+            return false;
+
+    fd = open(writer->temporary_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return false;
+
+    if (!write_all(fd, writer->buffer, writer->length) || fsync(fd) != 0) {
+        close(fd);
+        unlink(writer->temporary_path);
+        return false;
+    }
+    close(fd);
+
+    if (rename(writer->temporary_path, writer->path) != 0) {
+        unlink(writer->temporary_path);
+        return false;
+    }
+    fsync(writer->directory_fd);
+    return true;
+}
+
+/**
+ * Appends to the config file the peers added since @param first_peer, with one write
+ * @param writer
+ * @param first_peer - *Peer: first new peer, followed by the other new peers in insertion order
+ * @return True, if the peers were appended
+ *         False, otherwise
+ */
+bool config_writer_append(struct ConfigWriter *writer, const struct Peer *first_peer) {
+    bool written;
+    int fd;
+
+    writer->length = 0;
+    for (const struct Peer *peer = first_peer; peer != NULL; peer = peer->next)
+        if (!format_peer(writer, peer))
+            return false;
+
+    fd = open(writer->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    written = write_all(fd, writer->buffer, writer->length) && fdatasync(fd) == 0;
+    close(fd);
+    return written;
+}
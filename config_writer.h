@@ -0,0 +1,36 @@
+#ifndef DHCP_V1_CONFIG_WRITER_H
+#define DHCP_V1_CONFIG_WRITER_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "peer_table.h"
+
+#define CONFIG_WRITER_TEMPORARY_SUFFIX ".tmp"
+
+/**
+ * ConfigWriter structure, writes a wg-quick config file from the peer model without forking
+ *  - path - char[]: config file
+ *  - temporary_path - char[]: file the config is written to before it is renamed over path
+ *  - directory_fd - int: directory of the config file, synced so the rename survives a crash
+ *  - buffer - *char: config being formatted, reused by every write
+ *  - length - size_t: length of the formatted config
+ *  - capacity - size_t: size of buffer
+ */
+struct ConfigWriter {
+    char path[PATH_MAX];
+    char temporary_path[PATH_MAX];
+    int directory_fd;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+};
+
+bool config_writer_init(struct ConfigWriter *writer, const char *path);
+void config_writer_destroy(struct ConfigWriter *writer);
+bool config_writer_write(struct ConfigWriter *writer, const char *base, size_t base_length,
+                         const struct PeerTable *peers);
+bool config_writer_append(struct ConfigWriter *writer, const struct Peer *first_peer);
+
+#endif //DHCP_V1_CONFIG_WRITER_H
@@ -0,0 +1,323 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "control_socket.h"
+#include "address.h"
+#include "key.h"
+
+#define CONTROL_CLIENT_TIMEOUT_MS 10000
+#define CONTROL_REQUEST_MAX_LENGTH (16 * 1024 * 1024)
+#define CONTROL_INITIAL_LENGTH 4096
+#define CONTROL_SEPARATORS " \t\r"
+
+static const char *RESULT_NAMES[] = {
+        [CONTROL_OK] = "ok",
+        [CONTROL_INVALID] = "invalid line",
+        [CONTROL_NO_ADDRESS] = "no address available",
+        [CONTROL_NOT_FOUND] = "no such peer",
+        [CONTROL_NO_INTERFACE] = "no such interface",
+};
+
+/**
+ * Reads the request until the client shuts down its side
+ * @return length of the request, which is NUL terminated in control->text
+ *         -1, if the client timed out, failed or sent more than CONTROL_REQUEST_MAX_LENGTH bytes
+ */
+static ssize_t read_request(struct ControlSocket *control, int client) {
+    size_t length = 0;
+
+    for (;;) {
+        ssize_t received;
+
+        if (length + 1 == control->text_capacity) {
+            char *text;
+
+            if (control->text_capacity >= CONTROL_REQUEST_MAX_LENGTH)
+                return -1;
+            text = (char *) realloc(control->text, control->text_capacity * 2);
+            if (text == NULL)
+                return -1;
+            control->text = text;
+            control->text_capacity *= 2;
+        }
+
+        received = recv(client, control->text + length, control->text_capacity - 1 - length, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received < 0)
+            return -1;
+        if (received == 0)
+            break;
+        length += (size_t) received;
+    }
+    control->text[length] = '\0';
+    return (ssize_t) length;
+}
+
+static bool copy_token(char *destination, size_t size, const char *token) {
+    if (token == NULL || strlen(token) >= size)
+        return false;
+    strcpy(destination, token);
+    return true;
+}
+
+/**
+ * Splits "host:port" or "[host]:port" in the endpoint and port of an entry
+ */
+static bool parse_endpoint(struct ControlEntry *entry, char *token) {
+    char *separator, *end;
+    long port;
+
+    if (token == NULL)
+        return false;
+    separator = strrchr(token, ':');
+    if (separator == NULL || separator == token)
+        return false;
+    *separator = '\0';
+    if (token[0] == '[') {
+        if (separator[-1] != ']')
+            return false;
+        separator[-1] = '\0';
+        token++;
+    }
+
+    port = strtol(separator + 1, &end, 10);
+    if (end == separator + 1 || *end != '\0' || port <= 0 || port > 65535)
+        return false;
+    snprintf(entry->port, sizeof (entry->port), "%ld", port);
+    return *token != '\0' && copy_token(entry->endpoint, sizeof (entry->endpoint), token);
+}
+
+/**
+ * Parses the end of a line: nothing, or "on" followed by the name of an interface
+ */
+static bool parse_interface(struct ControlEntry *entry, char *token, char **context) {
+    if (token == NULL)
+        return true;
+    if (strcmp(token, "on") != 0 ||
+        !copy_token(entry->interface_name, sizeof (entry->interface_name), strtok_r(NULL, CONTROL_SEPARATORS, context)))
+        return false;
+    return strtok_r(NULL, CONTROL_SEPARATORS, context) == NULL;
+}
+
+/**
+ * Parses one line of the request
+ * @return True, if the line is valid
+ *         False, otherwise
+ */
+static bool parse_entry(struct ControlEntry *entry, char *line) {
+    uint8_t key[KEY_LENGTH];
+    char *context, *command = strtok_r(line, CONTROL_SEPARATORS, &context);
+    char *public_key = strtok_r(NULL, CONTROL_SEPARATORS, &context), *token;
+
+    memset(entry, 0, sizeof (struct ControlEntry));
+    if (command == NULL || public_key == NULL || !key_from_base64(public_key, key) ||
+        !copy_token(entry->public_key, sizeof (entry->public_key), public_key))
+        return false;
+
+    if (strcmp(command, "remove") == 0) {
+        entry->remove = true;
+        return parse_interface(entry, strtok_r(NULL, CONTROL_SEPARATORS, &context), &context);
+    }
+    if (strcmp(command, "add") != 0 ||
+        !copy_token(entry->allowed_ips, sizeof (entry->allowed_ips), strtok_r(NULL, CONTROL_SEPARATORS, &context)) ||
+        !address_valid_allowed_ips(entry->allowed_ips) || !parse_endpoint(entry, strtok_r(NULL, CONTROL_SEPARATORS, &context)))
+        return false;
+
+    token = strtok_r(NULL, CONTROL_SEPARATORS, &context);
+    if (token != NULL && strcmp(token, "on") != 0) {
+        if (!address_parse(token, &entry->address))
+            return false;
+        entry->pinned = true;
+        token = strtok_r(NULL, CONTROL_SEPARATORS, &context);
+    }
+    return parse_interface(entry, token, &context);
+}
+
+/**
+ * Splits the request in lines, blank lines and lines starting with '#' are skipped
+ * @return number of entries
+ *         -1, if the entries could not be allocated
+ */
+static ssize_t parse_request(struct ControlSocket *control, size_t length) {
+    char *current = control->text, *end = control->text + length;
+    size_t count = 0;
+
+    while (current < end) {
+        char *newline = strchr(current, '\n'), *line = current;
+
+        if (newline != NULL)
+            *newline = '\0';
+        current = newline != NULL ? newline + 1 : end;
+        line += strspn(line, CONTROL_SEPARATORS);
+        if (*line == '\0' || *line == '#')
+            continue;
+
+        if (count == control->entry_capacity) {
+            size_t capacity = control->entry_capacity == 0 ? 64 : control->entry_capacity * 2;
+            struct ControlEntry *entries = (struct ControlEntry *) realloc(control->entries,
+                                                                           capacity * sizeof (struct ControlEntry));
+            if (entries == NULL)
+                return -1;
+            control->entries = entries;
+            control->entry_capacity = capacity;
+        }
+        if (!parse_entry(&control->entries[count], line))
+            control->entries[count].result = CONTROL_INVALID;
+        count++;
+    }
+    return (ssize_t) count;
+}
+
+/**
+ * Executes the request of one client and answers it, the connection is closed by the caller
+ * @param control
+ * @param client - int: connected socket
+ */
+static void serve_client(struct ControlSocket *control, int client) {
+    struct timeval timeout = {.tv_sec = CONTROL_CLIENT_TIMEOUT_MS / 1000, .tv_usec = CONTROL_CLIENT_TIMEOUT_MS % 1000 * 1000};
+    size_t succeeded = 0;
+    ssize_t length, count;
+    FILE *reply;
+    int reply_fd;
+
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+    length = read_request(control, client);
+    count = length < 0 ? -1 : parse_request(control, (size_t) length);
+    if (count < 0) {
+        dprintf(client, "error request too long or unreadable\n");
+        return;
+    }
+    control->execute(control->context, control->entries, (size_t) count);
+
+    reply_fd = dup(client);
+    reply = reply_fd < 0 ? NULL : fdopen(reply_fd, "w");
+    if (reply == NULL) {
+        if (reply_fd >= 0)
+            close(reply_fd);
+        return;
+    }
+    for (ssize_t i = 0; i < count; i++) {
+        const struct ControlEntry *entry = &control->entries[i];
+        char address[INET6_ADDRSTRLEN];
+
+        if (entry->result != CONTROL_OK) {
+            fprintf(reply, "error %s\n", RESULT_NAMES[entry->result]);
+            continue;
+        }
+        succeeded++;
+        if (entry->remove)
+            fprintf(reply, "ok\n");
+        else
+            fprintf(reply, "ok %s\n", address_format(&entry->address, address, sizeof (address)));
+    }
+    fprintf(reply, "done %zu %zu\n", succeeded, (size_t) count - succeeded);
+    fclose(reply);
+}
+
+static void *serve_control(void *argument) {
+    struct ControlSocket *control = (struct ControlSocket *) argument;
+    struct pollfd descriptors[2] = {
+            {.fd = control->fd, .events = POLLIN},
+            {.fd = control->stop, .events = POLLIN},
+    };
+
+    for (;;) {
+        int client;
+
+        if (poll(descriptors, 2, -1) < 0)
+            continue;
+        if (descriptors[1].revents != 0)
+            return NULL;
+        if (descriptors[0].revents == 0)
+            continue;
+
+        client = accept4(control->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0)
+            continue;
+        serve_client(control, client);
+        close(client);
+    }
+}
+
+/**
+ * Creates the control socket and starts the thread that serves it. A socket file left behind by a previous run is
+ * replaced. Only the owner of the server can connect. Requests are executed one at a time, on the thread of the socket.
+ * @param control
+ * @param path - *char: path of the socket
+ * @param execute - ControlExecutor: applies the entries of a request
+ * @param context - *void: given to execute
+ * @return True, if the socket is served
+ *         False, otherwise
+ */
+bool control_socket_open(struct ControlSocket *control, const char *path, ControlExecutor execute, void *context) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof (address.sun_path)) {
+        fprintf(stderr, "control_socket_open - path of the socket is too long\n");
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    strcpy(control->path, path);
+    control->execute = execute;
+    control->context = context;
+    control->entries = NULL;
+    control->entry_capacity = 0;
+    control->text_capacity = CONTROL_INITIAL_LENGTH;
+    control->text = (char *) malloc(control->text_capacity);
+    if (control->text == NULL)
+        return false;
+
+    control->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (control->fd < 0) {
+        perror("socket() - control_socket_open");
+        goto FREE;
+    }
+
+    unlink(path);
+    if (bind(control->fd, (struct sockaddr *) &address, sizeof (address)) < 0 || chmod(path, S_IRUSR | S_IWUSR) < 0 ||
+        listen(control->fd, 16) < 0) {
+        perror("bind() - control_socket_open");
+        goto FAIL;
+    }
+
+    control->stop = eventfd(0, EFD_CLOEXEC);
+    if (control->stop < 0)
+        goto FAIL;
+    if (pthread_create(&control->thread, NULL, serve_control, control) != 0) {
+        close(control->stop);
+        goto FAIL;
+    }
+    return true;
+
+    FAIL:
+    close(control->fd);
+    unlink(path);
+    FREE:
+    free(control->text);
+    return false;
+}
+
+/**
+ * Stops the thread once the current request is answered, closes the socket and removes its file
+ * @param control
+ */
+void control_socket_close(struct ControlSocket *control) {
+    eventfd_write(control->stop, 1);
+    pthread_join(control->thread, NULL);
+    close(control->stop);
+    close(control->fd);
+    unlink(control->path);
+    free(control->text);
+    free(control->entries);
+}
@@ -0,0 +1,90 @@
+#ifndef DHCP_V1_CONTROL_SOCKET_H
+#define DHCP_V1_CONTROL_SOCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+#include "peer_table.h"
+
+/**
+ * Outcome of one line of a control request
+ */
+enum ControlResult {
+    CONTROL_OK,
+    CONTROL_INVALID,
+    CONTROL_NO_ADDRESS,
+    CONTROL_NOT_FOUND,
+    CONTROL_NO_INTERFACE
+};
+
+/**
+ * ControlEntry structure, one line of a control request once parsed
+ *  - remove - bool: True for "remove", False for "add"
+ *  - pinned - bool: True, if the line asks for a specific address
+ *  - public_key, allowed_ips, endpoint, port - char[]: fields of the peer, as written in the config file
+ *  - address - in6_addr: pinned address, then the address the peer holds once the request is executed
+ *  - interface_name - char[]: interface the line is meant for, empty for the default one
+ *  - pool - uint32_t: left to the executor, which resolves interface_name in it
+ *  - result - ControlResult: CONTROL_INVALID when the line could not be parsed, otherwise set by the executor
+ */
+struct ControlEntry {
+    bool remove;
+    bool pinned;
+    char public_key[PEER_PUBLIC_KEY_LENGTH];
+    char allowed_ips[PEER_ALLOWED_IPS_LENGTH];
+    char endpoint[PEER_ENDPOINT_LENGTH];
+    char port[PEER_PORT_LENGTH];
+    struct in6_addr address;
+    char interface_name[IF_NAMESIZE];
+    uint32_t pool;
+    enum ControlResult result;
+};
+
+/**
+ * Executes every valid entry of a request, as one transaction per interface
+ * @param context - *void: context given to control_socket_open()
+ * @param entries - *ControlEntry
+ * @param count - size_t: number of entries
+ */
+typedef void (*ControlExecutor)(void *context, struct ControlEntry *entries, size_t count);
+
+/**
+ * ControlSocket structure, UNIX domain stream socket served by its own thread, used to add and remove many peers at
+ * once. A client sends one line per peer, then shuts down its side:
+ *      add <public key> <allowed ips> <endpoint>:<port> [pinned address] [on <interface>]
+ *      remove <public key> [on <interface>]
+ * Allowed IPs are separated by commas without spaces, an IPv6 endpoint is written in brackets. Lines without an
+ * interface are meant for the default one. The client gets one line per request line, "ok <address>" or
+ * "error <reason>", then "done <ok> <failed>"; the answer is sent once the peers are on their interfaces.
+ *  - fd - int: listening socket
+ *  - stop - int: eventfd that asks the thread to stop
+ *  - thread - pthread_t: thread that serves the socket
+ *  - execute - ControlExecutor: applies the entries of a request
+ *  - context - *void: given to execute
+ *  - text - *char: request of the current client
+ *  - text_capacity - size_t: allocated length of text
+ *  - entries - *ControlEntry: parsed lines of the current client
+ *  - entry_capacity - size_t: allocated number of entries
+ *  - path - char[]: path of the socket, removed when the socket is closed
+ */
+struct ControlSocket {
+    int fd;
+    int stop;
+    pthread_t thread;
+    ControlExecutor execute;
+    void *context;
+    char *text;
+    size_t text_capacity;
+    struct ControlEntry *entries;
+    size_t entry_capacity;
+    char path[sizeof (((struct sockaddr_un *) 0)->sun_path)];
+};
+
+bool control_socket_open(struct ControlSocket *control, const char *path, ControlExecutor execute, void *context);
+void control_socket_close(struct ControlSocket *control);
+
+#endif //DHCP_V1_CONTROL_SOCKET_H
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dataplane.h"
+
+#define APPLIED_PEERS_BUCKETS 1024
+
+static const struct DataplaneBackend *BACKENDS[] = {
+        &WIREGUARD_DATAPLANE_BACKEND,
+        &STUB_DATAPLANE_BACKEND,
+};
+
+static bool stub_open(struct Dataplane *dataplane) {
+    (void) dataplane;
+    return true;
+}
+
+static bool stub_apply(struct Dataplane *dataplane, const struct DataplaneChange *changes, size_t count,
+                       bool *accepted) {
+    (void) dataplane;
+    (void) changes;
+    for (size_t i = 0; i < count; i++)
+        accepted[i] = true;
+    return true;
+}
+
+static void stub_close(struct Dataplane *dataplane) {
+    (void) dataplane;
+}
+
+/**
+ * In process backend, it only keeps track of what would be applied. Used to exercise and benchmark the request path
+ * without a WireGuard interface.
+ */
+const struct DataplaneBackend STUB_DATAPLANE_BACKEND = {
+        .name = "stub",
+        .open = stub_open,
+        .apply = stub_apply,
+        .close = stub_close,
+};
+
+/**
+ * Checks wether the interface already has the peer exactly as described
+ * @param applied - *Peer: peer as it was applied to the interface
+ * @param peer - *Peer: peer as it should be
+ * @return True, if nothing needs to be changed
+ *         False, otherwise
+ */
+static bool same_peer(const struct Peer *applied, const struct Peer *peer) {
+    return strcmp(applied->allowed_ips, peer->allowed_ips) == 0 && strcmp(applied->endpoint, peer->endpoint) == 0 &&
+           strcmp(applied->port, peer->port) == 0;
+}
+
+/**
+ * Prepares the data plane of an interface
+ * @param dataplane
+ * @param backend_name - *char: "wireguard" or "stub"
+ * @param interface_name - *char: interface whose peers are managed
+ * @return True, if the backend exists and could be opened
+ *         False, otherwise
+ */
+bool dataplane_init(struct Dataplane *dataplane, const char *backend_name, const char *interface_name) {
+    memset(dataplane, 0, sizeof (struct Dataplane));
+    snprintf(dataplane->interface_name, sizeof (dataplane->interface_name), "%s", interface_name);
+
+    for (size_t i = 0; i < sizeof (BACKENDS) / sizeof (BACKENDS[0]); i++)
+        if (strcmp(BACKENDS[i]->name, backend_name) == 0)
+            dataplane->backend = BACKENDS[i];
+
+    if (dataplane->backend == NULL)
+        return false;
+    if (!peer_table_init(&dataplane->applied, APPLIED_PEERS_BUCKETS))
+        return false;
+    if (!dataplane->backend->open(dataplane)) {
+        peer_table_destroy(&dataplane->applied);
+        return false;
+    }
+    return true;
+}
+
+void dataplane_destroy(struct Dataplane *dataplane) {
+    dataplane->backend->close(dataplane);
+    peer_table_destroy(&dataplane->applied);
+    free(dataplane->accepted);
+}
+
+/**
+ * Applies a list of changes to the live interface, only the peers in the list are touched. Only the changes the
+ * interface took are recorded, even when the others failed; a full sync then sends the missing ones again.
+ * @param dataplane
+ * @param changes - *DataplaneChange: peers to add or remove, peers that are removed must still be valid
+ * @param count - size_t: number of changes
+ * @return True, if the backend applied every change
+ *         False, otherwise
+ */
+bool dataplane_apply(struct Dataplane *dataplane, const struct DataplaneChange *changes, size_t count) {
+    bool result;
+
+    if (count == 0)
+        return true;
+
+    if (count > dataplane->accepted_capacity) {
+        bool *accepted = (bool *) realloc(dataplane->accepted, count * sizeof (bool));
+
+        if (accepted == NULL)
+            return false;
+        dataplane->accepted = accepted;
+        dataplane->accepted_capacity = count;
+    }
+
+    dataplane->applies++;
+    result = dataplane->backend->apply(dataplane, changes, count, dataplane->accepted);
+
+    for (size_t i = 0; i < count; i++) {
+        const struct Peer *peer = changes[i].peer;
+        struct Peer *applied;
+
+        if (!dataplane->accepted[i])
+            continue;
+        applied = peer_table_find_by_key(&dataplane->applied, peer->public_key);
+        if (applied != NULL)
+            peer_table_remove(&dataplane->applied, applied);
+
+        if (changes[i].remove) {
+            dataplane->peers_removed++;
+        } else {
+            peer_table_add(&dataplane->applied, peer->public_key, peer->allowed_ips, peer->endpoint, peer->port,
+                           &peer->address);
+            dataplane->peers_added++;
+        }
+    }
+    return result;
+}
+
+/**
+ * Brings the interface to the desired set of peers with the minimum number of changes: peers that are missing or
+ * differ are added, peers that are no longer desired are removed, the others are left untouched.
+ * @param dataplane
+ * @param desired - *PeerTable: peers the interface should have
+ * @return True, if the interface is in sync
+ *         False, otherwise
+ */
+bool dataplane_sync(struct Dataplane *dataplane, const struct PeerTable *desired) {
+    struct DataplaneChange *changes;
+    size_t count = 0;
+    bool result;
+
+    changes = (struct DataplaneChange *) malloc((desired->count + dataplane->applied.count + 1) *
+                                                sizeof (struct DataplaneChange));
+    if (changes == NULL)
+        return false;
+
+    for (struct Peer *peer = desired->head; peer != NULL; peer = peer->next) {
+        struct Peer *applied = peer_table_find_by_key(&dataplane->applied, peer->public_key);
+
+        if (applied == NULL || !same_peer(applied, peer)) {
+            changes[count].peer = peer;
+            changes[count++].remove = false;
+        }
+    }
+    for (struct Peer *applied = dataplane->applied.head; applied != NULL; applied = applied->next)
+        if (peer_table_find_by_key(desired, applied->public_key) == NULL) {
+            changes[count].peer = applied;
+            changes[count++].remove = true;
+        }
+
+    result = dataplane_apply(dataplane, changes, count);
+    free(changes);
+    return result;
+}
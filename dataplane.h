@@ -0,0 +1,69 @@
+#ifndef DHCP_V1_DATAPLANE_H
+#define DHCP_V1_DATAPLANE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <net/if.h>
+
+#include "peer_table.h"
+
+struct Dataplane;
+
+/**
+ * DataplaneChange structure, one peer that needs to be added to or removed from the live interface
+ *  - peer - *Peer: peer that is added or removed
+ *  - remove - bool: True, if the peer is removed
+ */
+struct DataplaneChange {
+    const struct Peer *peer;
+    bool remove;
+};
+
+/**
+ * DataplaneBackend structure, the operations a backend provides
+ *  - name - *char: name used to select the backend
+ *  - open - function: prepares the backend for the given interface, returns False on failure
+ *  - apply - function: applies a list of changes to the live interface and sets, for every change, whether the
+ *    interface took it; returns False on failure
+ *  - close - function: releases what open allocated
+ */
+struct DataplaneBackend {
+    const char *name;
+    bool (*open)(struct Dataplane *dataplane);
+    bool (*apply)(struct Dataplane *dataplane, const struct DataplaneChange *changes, size_t count, bool *accepted);
+    void (*close)(struct Dataplane *dataplane);
+};
+
+/**
+ * Dataplane structure:
+ *  - backend - *DataplaneBackend: backend that talks to the interface
+ *  - interface_name - char[]: interface managed by the data plane
+ *  - context - *void: private data of the backend
+ *  - applied - PeerTable: peers the interface accepted, used to compute the difference on a full sync
+ *  - accepted - *bool: outcome of every change of the current apply, filled by the backend
+ *  - accepted_capacity - size_t
+ *  - applies - uint64_t: number of calls to the backend
+ *  - peers_added, peers_removed - uint64_t: number of peers added and removed on the interface
+ */
+struct Dataplane {
+    const struct DataplaneBackend *backend;
+    char interface_name[IF_NAMESIZE];
+    void *context;
+    struct PeerTable applied;
+    bool *accepted;
+    size_t accepted_capacity;
+    uint64_t applies;
+    uint64_t peers_added;
+    uint64_t peers_removed;
+};
+
+extern const struct DataplaneBackend WIREGUARD_DATAPLANE_BACKEND;
+extern const struct DataplaneBackend STUB_DATAPLANE_BACKEND;
+
+bool dataplane_init(struct Dataplane *dataplane, const char *backend_name, const char *interface_name);
+void dataplane_destroy(struct Dataplane *dataplane);
+bool dataplane_apply(struct Dataplane *dataplane, const struct DataplaneChange *changes, size_t count);
+bool dataplane_sync(struct Dataplane *dataplane, const struct PeerTable *desired);
+
+#endif //DHCP_V1_DATAPLANE_H
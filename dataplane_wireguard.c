@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/genetlink.h>
+#include <linux/wireguard.h>
+
+#include "dataplane.h"
+#include "netlink.h"
+#include "event_log.h"
+
+/**
+ * WireguardContext structure:
+ *  - sock - int: generic netlink socket
+ *  - family - uint16_t: id of the wireguard generic netlink family
+ *  - sequence - uint32_t: sequence number of the last message sent
+ *  - buffer - NetlinkBuffer: buffer in which WG_CMD_SET_DEVICE messages are built
+ */
+struct WireguardContext {
+    int sock;
+    uint16_t family;
+    uint32_t sequence;
+    struct NetlinkBuffer buffer;
+};
+
+/**
+ * Adds the allowed ips of a peer, given as a comma separated list of address/cidr
+ * @param buffer
+ * @param allowed_ips
+ * @return True, if every allowed ip fits in the buffer
+ *         False, otherwise
+ */
+static bool put_allowed_ips(struct NetlinkBuffer *buffer, const char *allowed_ips) {
+    char list[PEER_ALLOWED_IPS_LENGTH], *saveptr, *entry;
+    size_t allowed_ips_nest = netlink_nest_start(buffer, WGPEER_A_ALLOWEDIPS);
+
+    if (allowed_ips_nest == 0)
+        return false;
+
+    snprintf(list, sizeof (list), "%s", allowed_ips);
+    for (entry = strtok_r(list, ", \t", &saveptr); entry != NULL; entry = strtok_r(NULL, ", \t", &saveptr)) {
+        unsigned char address[sizeof (struct in6_addr)];
+        char *cidr = strchr(entry, '/');
+        int family = strchr(entry, ':') != NULL ? AF_INET6 : AF_INET;
+        int mask = family == AF_INET6 ? 128 : 32;
+        size_t ip_nest;
+
+        if (cidr != NULL) {
+            *cidr++ = '\0';
+            mask = atoi(cidr);
+        }
+        if (inet_pton(family, entry, address) != 1)
+            continue;
+
+        ip_nest = netlink_nest_start(buffer, 0);
+        if (ip_nest == 0 ||
+            !netlink_put_u16(buffer, WGALLOWEDIP_A_FAMILY, (uint16_t) family) ||
+            !netlink_put(buffer, WGALLOWEDIP_A_IPADDR, address,
+                         family == AF_INET6 ? sizeof (struct in6_addr) : sizeof (struct in_addr)) ||
+            !netlink_put_u8(buffer, WGALLOWEDIP_A_CIDR_MASK, (uint8_t) mask))
+            return false;
+        netlink_nest_end(buffer, ip_nest);
+    }
+
+    netlink_nest_end(buffer, allowed_ips_nest);
+    return true;
+}
+
+/**
+ * Adds the endpoint of a peer, peers whose endpoint is not a literal address are added without one
+ * @param buffer
+ * @param peer
+ * @return True, if the endpoint fits in the buffer
+ *         False, otherwise
+ */
+static bool put_endpoint(struct NetlinkBuffer *buffer, const struct Peer *peer) {
+    uint16_t port = htons((uint16_t) atoi(peer->port));
+    struct sockaddr_in6 endpoint6;
+    struct sockaddr_in endpoint;
+
+    memset(&endpoint, 0, sizeof (endpoint));
+    endpoint.sin_family = AF_INET;
+    endpoint.sin_port = port;
+    if (inet_pton(AF_INET, peer->endpoint, &endpoint.sin_addr) == 1)
+        return netlink_put(buffer, WGPEER_A_ENDPOINT, &endpoint, sizeof (endpoint));
+
+    memset(&endpoint6, 0, sizeof (endpoint6));
+    endpoint6.sin6_family = AF_INET6;
+    endpoint6.sin6_port = port;
+    if (inet_pton(AF_INET6, peer->endpoint, &endpoint6.sin6_addr) == 1)
+        return netlink_put(buffer, WGPEER_A_ENDPOINT, &endpoint6, sizeof (endpoint6));
+
+    return true;
+}
+
+/**
+ * Adds one peer to the WGDEVICE_A_PEERS nest of the current message, its key has to be valid
+ * @param buffer
+ * @param change
+ * @return True, if the peer fits in the buffer
+ *         False, if the buffer is full
+ */
+static bool put_peer(struct NetlinkBuffer *buffer, const struct DataplaneChange *change) {
+    const struct Peer *peer = change->peer;
+    size_t peer_nest;
+
+    peer_nest = netlink_nest_start(buffer, 0);
+    if (peer_nest == 0 || !netlink_put(buffer, WGPEER_A_PUBLIC_KEY, peer->key, WG_KEY_LEN))
+        return false;
+
+    if (change->remove) {
+        if (!netlink_put_u32(buffer, WGPEER_A_FLAGS, WGPEER_F_REMOVE_ME))
+            return false;
+    } else {
+        if (!netlink_put_u32(buffer, WGPEER_A_FLAGS, WGPEER_F_REPLACE_ALLOWEDIPS))
+            return false;
+
+        if (!put_endpoint(buffer, peer))
+            return false;
+
+        if (!put_allowed_ips(buffer, peer->allowed_ips))
+            return false;
+    }
+
+    netlink_nest_end(buffer, peer_nest);
+    return true;
+}
+
+/**
+ * Starts a WG_CMD_SET_DEVICE message for the interface and opens its list of peers
+ * @param dataplane
+ * @param context
+ * @return offset of the WGDEVICE_A_PEERS nest
+ *         0, on failure
+ */
+static size_t begin_set_device(struct Dataplane *dataplane, struct WireguardContext *context) {
+    struct genlmsghdr header = {.cmd = WG_CMD_SET_DEVICE, .version = WG_GENL_VERSION};
+
+    netlink_reset(&context->buffer);
+    if (!netlink_begin(&context->buffer, context->family, NLM_F_ACK, ++context->sequence, &header, sizeof (header)) ||
+        !netlink_put_string(&context->buffer, WGDEVICE_A_IFNAME, dataplane->interface_name))
+        return 0;
+
+    return netlink_nest_start(&context->buffer, WGDEVICE_A_PEERS);
+}
+
+/**
+ * Closes the current message and sends it
+ * @param context
+ * @param peers_nest
+ * @return True, if the kernel accepted the message
+ *         False, otherwise
+ */
+static bool flush_set_device(struct WireguardContext *context, size_t peers_nest) {
+    int result;
+
+    netlink_nest_end(&context->buffer, peers_nest);
+    netlink_end(&context->buffer);
+
+    result = netlink_transact(context->sock, &context->buffer, context->sequence, context->sequence);
+    if (result < 0) {
+        event_log(EVENT_LOG_WARNING, EVENT_SET_DEVICE_FAILED, 0, (uint32_t) -result, 0, NULL, NULL);
+        return false;
+    }
+    return true;
+}
+
+static bool wireguard_open(struct Dataplane *dataplane) {
+    struct WireguardContext *context = (struct WireguardContext *) malloc(sizeof (struct WireguardContext));
+    int family;
+
+    if (context == NULL)
+        return false;
+
+    context->sequence = 0;
+    context->sock = netlink_open(NETLINK_GENERIC, 0);
+    if (context->sock < 0) {
+        free(context);
+        return false;
+    }
+
+    family = netlink_resolve_family(context->sock, WG_GENL_NAME, ++context->sequence);
+    if (family < 0) {
+        fprintf(stderr, "wireguard generic netlink family not found: %s\n", strerror(-family));
+        close(context->sock);
+        free(context);
+        return false;
+    }
+
+    context->family = (uint16_t) family;
+    dataplane->context = context;
+    return true;
+}
+
+/**
+ * Sends the current message, the changes it holds, from @param first up to @param end, are accepted only if the kernel
+ * took the message
+ * @return True, if the kernel accepted the message
+ *         False, otherwise
+ */
+static bool flush_changes(struct WireguardContext *context, size_t peers_nest, bool *accepted, size_t first,
+                          size_t end) {
+    if (flush_set_device(context, peers_nest))
+        return true;
+
+    for (size_t i = first; i < end; i++)
+        accepted[i] = false;
+    return false;
+}
+
+/**
+ * Applies the changes with as few WG_CMD_SET_DEVICE messages as possible, a new message is started only when the
+ * current one is full. Peers with an invalid key are skipped and are not accepted.
+ */
+static bool wireguard_apply(struct Dataplane *dataplane, const struct DataplaneChange *changes, size_t count,
+                            bool *accepted) {
+    struct WireguardContext *context = (struct WireguardContext *) dataplane->context;
+    size_t peers_nest = begin_set_device(dataplane, context), peers_in_message = 0, first = 0;
+    bool result = true;
+
+    memset(accepted, 0, count * sizeof (bool));
+    if (peers_nest == 0)
+        return false;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t offset = context->buffer.length;
+
+        if (!changes[i].peer->key_valid) {
+            event_log(EVENT_LOG_WARNING, EVENT_INVALID_KEY, 0, 0, 0, &changes[i].peer->address,
+                      changes[i].peer->public_key);
+            continue;
+        }
+        if (put_peer(&context->buffer, &changes[i])) {
+            accepted[i] = true;
+            peers_in_message++;
+            continue;
+        }
+
+        netlink_cancel(&context->buffer, offset);
+        if (peers_in_message == 0)
+            return false;
+
+        result = flush_changes(context, peers_nest, accepted, first, i) && result;
+        first = i;
+        peers_nest = begin_set_device(dataplane, context);
+        peers_in_message = 0;
+        if (peers_nest == 0 || !put_peer(&context->buffer, &changes[i]))
+            return false;
+        accepted[i] = true;
+        peers_in_message++;
+    }
+
+    return flush_changes(context, peers_nest, accepted, first, count) && result;
+}
+
+static void wireguard_close(struct Dataplane *dataplane) {
+    struct WireguardContext *context = (struct WireguardContext *) dataplane->context;
+
+    close(context->sock);
+    free(context);
+    dataplane->context = NULL;
+}
+
+/**
+ * Backend that changes the peers of a live WireGuard interface through the wireguard generic netlink family,
+ * the other peers and the interface itself are never touched.
+ */
+const struct DataplaneBackend WIREGUARD_DATAPLANE_BACKEND = {
+        .name = "wireguard",
+        .open = wireguard_open,
+        .apply = wireguard_apply,
+        .close = wireguard_close,
+};
@@ -0,0 +1,433 @@
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+
+#include "event_log.h"
+#include "address.h"
+
+#define EVENT_LOG_LINE_LENGTH 256
+
+/**
+ * EventRing structure, records of one thread, written by that thread and read by the drain thread without a lock. The
+ * writer only moves head and the reader only moves tail, each on its own cache line; a record is dropped when the ring
+ * is full, the writer never waits.
+ *  - head - uint64_t: number of records written, published with release once the record is complete
+ *  - dropped - uint64_t: records that did not fit
+ *  - thread - uint32_t: index of the ring, printed with its records
+ *  - tail - uint64_t: number of records read
+ *  - reported - uint64_t: dropped records already reported, used by the drain thread
+ *  - records - EventRecord[]: EVENT_LOG_RING_LENGTH records, a power of 2
+ */
+struct EventRing {
+    uint64_t head;
+    uint64_t dropped;
+    uint32_t thread;
+    _Alignas(64) uint64_t tail;
+    uint64_t reported;
+    _Alignas(64) struct EventRecord records[EVENT_LOG_RING_LENGTH];
+};
+
+/**
+ * EventLog structure, the log of the process. Every thread that logs gets its own ring the first time it does; a
+ * thread drains the rings every EVENT_LOG_DRAIN_MS, prints the records of the printed level and keeps the last
+ * EVENT_LOG_HISTORY_LENGTH records of the flight recorder level, dumped on request.
+ *  - stop - int: eventfd that asks the thread to stop
+ *  - dump - int: eventfd that asks the thread to dump the flight recorder
+ *  - thread - pthread_t: drain thread
+ *  - running - bool: True, while the drain thread runs
+ *  - rings - *EventRing[]: ring of every thread that logged, published with release
+ *  - ring_count - uint32_t: rings claimed, some may not be published yet
+ *  - print_level - int: records at or below it are printed to stdout
+ *  - flight_level - int: records at or below it are kept by the flight recorder
+ *  - history - *EventRecord: flight recorder, a circular buffer
+ *  - history_next - size_t: slot of history written next
+ *  - history_count - size_t: records in history
+ *  - sorted - *EventRecord: copy of history sorted by time, the rings are drained one after the other
+ *  - realtime_offset - int64_t: CLOCK_REALTIME - CLOCK_MONOTONIC, in nanoseconds, dates the records of the dump
+ */
+struct EventLog {
+    int stop;
+    int dump;
+    pthread_t thread;
+    bool running;
+    struct EventRing *rings[EVENT_LOG_MAX_THREADS];
+    uint32_t ring_count;
+    int print_level;
+    int flight_level;
+    struct EventRecord *history;
+    size_t history_next;
+    size_t history_count;
+    struct EventRecord *sorted;
+    int64_t realtime_offset;
+};
+
+static const char *LEVEL_NAMES[] = {"error", "warning", "info", "debug"};
+
+int EVENT_LOG_LEVEL = EVENT_LOG_INFO;
+static struct EventLog LOG = {.stop = -1, .dump = -1};
+static _Thread_local struct EventRing *RING = NULL;
+
+/**
+ * @param clock - clockid_t
+ * @return time of the clock in nanoseconds
+ */
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec now;
+
+    clock_gettime(clock, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Gives the calling thread its ring
+ * @return *EventRing, NULL if EVENT_LOG_MAX_THREADS threads already have one or it could not be allocated
+ */
+static struct EventRing *attach_ring() {
+    struct EventRing *ring;
+    uint32_t slot;
+
+    if (__atomic_load_n(&LOG.ring_count, __ATOMIC_RELAXED) >= EVENT_LOG_MAX_THREADS)
+        return NULL;
+    ring = (struct EventRing *) aligned_alloc(64, sizeof (struct EventRing));
+    if (ring == NULL)
+        return NULL;
+    memset(ring, 0, sizeof (struct EventRing));
+
+    slot = __atomic_fetch_add(&LOG.ring_count, 1, __ATOMIC_RELAXED);
+    if (slot >= EVENT_LOG_MAX_THREADS) {
+        free(ring);
+        return NULL;
+    }
+    ring->thread = slot;
+    __atomic_store_n(&LOG.rings[slot], ring, __ATOMIC_RELEASE);
+    RING = ring;
+    return ring;
+}
+
+/**
+ * Writes a record to the ring of the calling thread, use event_log(), which checks the level first
+ * @param level - int: EVENT_LOG_ERROR up to EVENT_LOG_DEBUG
+ * @param type - EventType
+ * @param first, second - uint32_t: small values of the event
+ * @param number - uint64_t: large value of the event
+ * @param address - *in6_addr: address the event is about, NULL if none
+ * @param text - *char: public key or interface name the event is about, NULL if none
+ */
+void event_log_record(int level, enum EventType type, uint32_t first, uint32_t second, uint64_t number,
+                      const struct in6_addr *address, const char *text) {
+    struct EventRing *ring = RING != NULL ? RING : attach_ring();
+    struct EventRecord *record;
+    uint64_t head;
+    size_t length;
+
+    if (ring == NULL)
+        return;
+    head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == EVENT_LOG_RING_LENGTH) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    record = &ring->records[head & (EVENT_LOG_RING_LENGTH - 1)];
+    record->time = clock_ns(CLOCK_MONOTONIC);
+    record->type = (uint16_t) type;
+    record->level = (uint8_t) level;
+    record->thread = (uint8_t) ring->thread;
+    record->first = first;
+    record->second = second;
+    record->number = number;
+    if (address != NULL)
+        record->address = *address;
+    else
+        memset(&record->address, 0, sizeof (record->address));
+    length = text == NULL ? 0 : strnlen(text, EVENT_LOG_TEXT_LENGTH - 1);
+    memcpy(record->text, text == NULL ? "" : text, length);
+    record->text[length] = '\0';
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Formats the message of a record, as the server printed it before it had a log
+ * @param record
+ * @param line - *char: message, without a new line
+ * @param length - size_t: room in line
+ */
+static void format_event(const struct EventRecord *record, char *line, size_t length) {
+    char address[INET6_ADDRSTRLEN];
+    const char *ellipsis = strlen(record->text) == EVENT_LOG_TEXT_LENGTH - 1 ? "..." : "";
+
+    address_format(&record->address, address, sizeof (address));
+    switch (record->type) {
+        case EVENT_REQUEST_RECEIVED:
+            snprintf(line, length, "Received request %u (version %llu, option %u) of %s%s for %s", record->second,
+                     (unsigned long long) record->number, record->first, record->text, ellipsis, address);
+            break;
+        case EVENT_REQUEST_INVALID:
+            snprintf(line, length, "Invalid request of %llu bytes dropped", (unsigned long long) record->number);
+            break;
+        case EVENT_POOL_NOT_SERVED:
+            snprintf(line, length, "Request for pool %u, which is not served, dropped", record->first);
+            break;
+        case EVENT_LEGACY_IPV6:
+            snprintf(line, length, "Legacy clients cannot lease IPv6 addresses, request dropped");
+            break;
+        case EVENT_POOL_EXHAUSTED:
+            snprintf(line, length, "Address pool exhausted, request dropped");
+            break;
+        case EVENT_ADDRESS_LEASED:
+            snprintf(line, length, "ADDR: %s leased to %s%s for %llu s", address, record->text, ellipsis,
+                     (unsigned long long) record->number);
+            break;
+        case EVENT_REPLY_QUEUED:
+            snprintf(line, length, "Queued reply to request %llu: status %u, address %s/%u",
+                     (unsigned long long) record->number, record->first, address, record->second);
+            break;
+        case EVENT_PEER_NOT_FOUND:
+            snprintf(line, length, "No peer found for the returned address %s, request dropped", address);
+            break;
+        case EVENT_LEASE_NOT_STORED:
+            snprintf(line, length, "Lease of %s%s could not be stored, it is lost on restart", record->text, ellipsis);
+            break;
+        case EVENT_LEASES_EXPIRED:
+            snprintf(line, length, "%u leases of %s expired", record->first, record->text);
+            break;
+        case EVENT_DATAPLANE_FAILED:
+            snprintf(line, length, "Batch of %llu peer changes could not be applied to the interface",
+                     (unsigned long long) record->number);
+            break;
+        case EVENT_ROUTES_FAILED:
+            snprintf(line, length, "Some of %llu route changes could not be applied",
+                     (unsigned long long) record->number);
+            break;
+        case EVENT_ROUTE_FAILED:
+            snprintf(line, length, "Route %s %s failed: %s", record->first ? "del" : "add", address,
+                     strerror((int) record->second));
+            break;
+        case EVENT_SET_DEVICE_FAILED:
+            snprintf(line, length, "WG_CMD_SET_DEVICE failed: %s", strerror((int) record->second));
+            break;
+        case EVENT_INVALID_KEY:
+            snprintf(line, length, "Invalid public key %s%s of %s, peer skipped by the data plane", record->text,
+                     ellipsis, address);
+            break;
+        case EVENT_CONTROL_REQUEST:
+            snprintf(line, length, "Control request: %u peers added, %u removed in %.3f ms", record->first,
+                     record->second, (double) record->number / 1e6);
+            break;
+        case EVENT_PARTITIONS_OWNED:
+            snprintf(line, length, "Node %llu owns %u of the %u partitions of %s", (unsigned long long) record->number,
+                     record->first, record->second, record->text);
+            break;
+        case EVENT_NODE_DEAD:
+            snprintf(line, length, "Cluster node %u is dead, its partitions are taken over", record->first);
+            break;
+        case EVENT_NODE_JOINED:
+            snprintf(line, length, "Cluster node %u joined, its leases are sent again", record->first);
+            break;
+        case EVENT_SIGNAL:
+            snprintf(line, length, "Signal %u received, shutting down", record->first);
+            break;
+        case EVENT_INTERFACE_GONE:
+            snprintf(line, length, "Interface %s is gone, shutting down", record->text);
+            break;
+        default:
+            snprintf(line, length, "Unknown event %u", record->type);
+    }
+}
+
+/**
+ * Reads every record written since the last drain: the records of the printed level are printed, those of the flight
+ * recorder level are kept. Used by the drain thread, or once it stopped.
+ */
+static void drain_rings() {
+    uint32_t ring_count = __atomic_load_n(&LOG.ring_count, __ATOMIC_RELAXED);
+    char line[EVENT_LOG_LINE_LENGTH];
+    bool printed = false;
+
+    if (ring_count > EVENT_LOG_MAX_THREADS)
+        ring_count = EVENT_LOG_MAX_THREADS;
+    for (uint32_t i = 0; i < ring_count; i++) {
+        struct EventRing *ring = __atomic_load_n(&LOG.rings[i], __ATOMIC_ACQUIRE);
+        uint64_t head;
+        uint64_t dropped;
+
+        if (ring == NULL)
+            continue;
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        for (uint64_t tail = ring->tail; tail < head; tail++) {
+            const struct EventRecord *record = &ring->records[tail & (EVENT_LOG_RING_LENGTH - 1)];
+
+            if (record->level <= LOG.flight_level) {
+                LOG.history[LOG.history_next] = *record;
+                LOG.history_next = (LOG.history_next + 1) % EVENT_LOG_HISTORY_LENGTH;
+                if (LOG.history_count < EVENT_LOG_HISTORY_LENGTH)
+                    LOG.history_count++;
+            }
+            if (record->level <= LOG.print_level) {
+                format_event(record, line, sizeof (line));
+                puts(line);
+                printed = true;
+            }
+        }
+        __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+
+        dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        if (dropped != ring->reported) {
+            printf("%llu log events of thread %u dropped, the log could not keep up\n",
+                   (unsigned long long) (dropped - ring->reported), ring->thread);
+            ring->reported = dropped;
+            printed = true;
+        }
+    }
+    if (printed)
+        fflush(stdout);
+}
+
+/**
+ * Orders records by time, used by qsort()
+ */
+static int compare_records(const void *first, const void *second) {
+    uint64_t first_time = ((const struct EventRecord *) first)->time;
+    uint64_t second_time = ((const struct EventRecord *) second)->time;
+
+    return first_time < second_time ? -1 : first_time > second_time;
+}
+
+/**
+ * Writes the flight recorder to stderr, oldest record first, with the time, thread and level of every record
+ */
+static void dump_history() {
+    size_t first = (LOG.history_next + EVENT_LOG_HISTORY_LENGTH - LOG.history_count) % EVENT_LOG_HISTORY_LENGTH;
+    char line[EVENT_LOG_LINE_LENGTH];
+
+    for (size_t i = 0; i < LOG.history_count; i++)
+        LOG.sorted[i] = LOG.history[(first + i) % EVENT_LOG_HISTORY_LENGTH];
+    qsort(LOG.sorted, LOG.history_count, sizeof (struct EventRecord), compare_records);
+
+    fprintf(stderr, "Flight recorder: last %zu events\n", LOG.history_count);
+    for (size_t i = 0; i < LOG.history_count; i++) {
+        const struct EventRecord *record = &LOG.sorted[i];
+        uint64_t stamp = record->time + (uint64_t) LOG.realtime_offset;
+        time_t seconds = (time_t) (stamp / 1000000000ull);
+        struct tm calendar;
+        char wall[16];
+
+        localtime_r(&seconds, &calendar);
+        strftime(wall, sizeof (wall), "%H:%M:%S", &calendar);
+        format_event(record, line, sizeof (line));
+        fprintf(stderr, "%s.%06llu thread %u %s: %s\n", wall, (unsigned long long) (stamp % 1000000000ull / 1000),
+                record->thread, LEVEL_NAMES[record->level], line);
+    }
+    fprintf(stderr, "Flight recorder: end\n");
+    fflush(stderr);
+}
+
+/**
+ * Drain thread: drains the rings every EVENT_LOG_DRAIN_MS and dumps the flight recorder when asked to
+ * @param argument - unused
+ */
+static void *drain_events(void *argument) {
+    struct pollfd events[2] = {{.fd = LOG.stop, .events = POLLIN}, {.fd = LOG.dump, .events = POLLIN}};
+    eventfd_t value;
+    (void) argument;
+
+    while (true) {
+        int ready = poll(events, 2, EVENT_LOG_DRAIN_MS);
+
+        drain_rings();
+        if (ready > 0 && (events[1].revents & POLLIN) && eventfd_read(LOG.dump, &value) == 0)
+            dump_history();
+        if (ready > 0 && (events[0].revents & POLLIN))
+            break;
+    }
+    return NULL;
+}
+
+/**
+ * Starts the drain thread. Events logged before are kept in the rings and printed by its first drain.
+ * @param print_level - int: records at or below it are printed to stdout
+ * @param flight_level - int: records at or below it are kept by the flight recorder
+ * @return True, if the thread runs
+ *         False, otherwise
+ */
+bool event_log_open(int print_level, int flight_level) {
+    sigset_t blocked, previous;
+    bool created;
+
+    LOG.print_level = print_level;
+    LOG.flight_level = flight_level;
+    LOG.realtime_offset = (int64_t) (clock_ns(CLOCK_REALTIME) - clock_ns(CLOCK_MONOTONIC));
+    LOG.history = (struct EventRecord *) calloc(EVENT_LOG_HISTORY_LENGTH, sizeof (struct EventRecord));
+    LOG.sorted = (struct EventRecord *) calloc(EVENT_LOG_HISTORY_LENGTH, sizeof (struct EventRecord));
+    if (LOG.history == NULL || LOG.sorted == NULL)
+        goto FAIL;
+    LOG.stop = eventfd(0, EFD_CLOEXEC);
+    LOG.dump = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (LOG.stop < 0 || LOG.dump < 0)
+        goto FAIL;
+    /* the thread is created with every signal blocked, they are handled by the event loop of the first worker */
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    created = pthread_create(&LOG.thread, NULL, drain_events, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (!created)
+        goto FAIL;
+
+    LOG.running = true;
+    EVENT_LOG_LEVEL = print_level > flight_level ? print_level : flight_level;
+    return true;
+
+    FAIL:
+    if (LOG.stop >= 0)
+        close(LOG.stop);
+    if (LOG.dump >= 0)
+        close(LOG.dump);
+    free(LOG.history);
+    free(LOG.sorted);
+    LOG.history = LOG.sorted = NULL;
+    LOG.stop = LOG.dump = -1;
+    return false;
+}
+
+/**
+ * Stops the drain thread and prints what is left in the rings. The other threads must not log anymore, events logged
+ * afterwards are ignored.
+ */
+void event_log_close() {
+    if (!LOG.running)
+        return;
+    EVENT_LOG_LEVEL = -1;
+    eventfd_write(LOG.stop, 1);
+    pthread_join(LOG.thread, NULL);
+    LOG.running = false;
+    drain_rings();
+
+    for (uint32_t i = 0; i < EVENT_LOG_MAX_THREADS; i++) {
+        free(LOG.rings[i]);
+        LOG.rings[i] = NULL;
+    }
+    LOG.ring_count = EVENT_LOG_MAX_THREADS;
+    free(LOG.history);
+    free(LOG.sorted);
+    LOG.history = LOG.sorted = NULL;
+    close(LOG.stop);
+    close(LOG.dump);
+    LOG.stop = LOG.dump = -1;
+}
+
+/**
+ * Asks the drain thread to dump the flight recorder to stderr, after its next drain. It only writes to an eventfd, so
+ * it can be called from a signal handler.
+ */
+void event_log_dump() {
+    if (LOG.dump >= 0)
+        eventfd_write(LOG.dump, 1);
+}
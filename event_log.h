@@ -0,0 +1,105 @@
+#ifndef DHCP_V1_EVENT_LOG_H
+#define DHCP_V1_EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#define EVENT_LOG_ERROR 0
+#define EVENT_LOG_WARNING 1
+#define EVENT_LOG_INFO 2
+#define EVENT_LOG_DEBUG 3
+
+/* events above this level are compiled out, the build can lower it with -DEVENT_LOG_COMPILED_LEVEL=<level> */
+#ifndef EVENT_LOG_COMPILED_LEVEL
+#define EVENT_LOG_COMPILED_LEVEL EVENT_LOG_DEBUG
+#endif
+
+#define EVENT_LOG_RING_LENGTH 8192
+#define EVENT_LOG_MAX_THREADS 64
+#define EVENT_LOG_HISTORY_LENGTH 4096
+#define EVENT_LOG_TEXT_LENGTH 20
+#define EVENT_LOG_DRAIN_MS 20
+
+/**
+ * Events of the server. The meaning of the fields of a record depends on the event, see format_event().
+ */
+enum EventType {
+    EVENT_REQUEST_RECEIVED,
+    EVENT_REQUEST_INVALID,
+    EVENT_POOL_NOT_SERVED,
+    EVENT_LEGACY_IPV6,
+    EVENT_POOL_EXHAUSTED,
+    EVENT_ADDRESS_LEASED,
+    EVENT_REPLY_QUEUED,
+    EVENT_PEER_NOT_FOUND,
+    EVENT_LEASE_NOT_STORED,
+    EVENT_LEASES_EXPIRED,
+    EVENT_DATAPLANE_FAILED,
+    EVENT_ROUTES_FAILED,
+    EVENT_ROUTE_FAILED,
+    EVENT_SET_DEVICE_FAILED,
+    EVENT_INVALID_KEY,
+    EVENT_CONTROL_REQUEST,
+    EVENT_PARTITIONS_OWNED,
+    EVENT_NODE_DEAD,
+    EVENT_NODE_JOINED,
+    EVENT_SIGNAL,
+    EVENT_INTERFACE_GONE,
+    EVENT_TYPES
+};
+
+/**
+ * EventRecord structure, one event as written by the thread that logged it, one cache line long. Nothing is formatted
+ * until the drain thread prints the record.
+ *  - time - uint64_t: CLOCK_MONOTONIC time of the event, in nanoseconds
+ *  - type - uint16_t: EventType
+ *  - level - uint8_t: EVENT_LOG_ERROR up to EVENT_LOG_DEBUG
+ *  - thread - uint8_t: ring of the thread that logged the event
+ *  - first, second - uint32_t: small values of the event
+ *  - number - uint64_t: large value of the event
+ *  - address - in6_addr: address the event is about, IPv4-mapped for IPv4
+ *  - text - char[]: start of a public key or an interface name, always terminated
+ */
+struct EventRecord {
+    uint64_t time;
+    uint16_t type;
+    uint8_t level;
+    uint8_t thread;
+    uint32_t first;
+    uint32_t second;
+    uint64_t number;
+    struct in6_addr address;
+    char text[EVENT_LOG_TEXT_LENGTH];
+};
+
+/*
+ * Records of the events logged at or below this level are kept, it is the highest of the printed level and of the
+ * level of the flight recorder. Set by event_log_open(), read by every thread.
+ */
+extern int EVENT_LOG_LEVEL;
+
+bool event_log_open(int print_level, int flight_level);
+void event_log_close(void);
+void event_log_dump(void);
+void event_log_record(int level, enum EventType type, uint32_t first, uint32_t second, uint64_t number,
+                      const struct in6_addr *address, const char *text);
+
+/**
+ * Logs an event: the record is written to the ring of the calling thread, which never waits and never formats it.
+ * Events above EVENT_LOG_COMPILED_LEVEL are removed by the compiler, the others cost one comparison when their level
+ * is not kept.
+ * @param level - int: EVENT_LOG_ERROR up to EVENT_LOG_DEBUG
+ * @param type - EventType
+ * @param first, second - uint32_t: small values of the event
+ * @param number - uint64_t: large value of the event
+ * @param address - *in6_addr: address the event is about, NULL if none
+ * @param text - *char: public key or interface name the event is about, NULL if none; only its start is kept
+ */
+static inline void event_log(int level, enum EventType type, uint32_t first, uint32_t second, uint64_t number,
+                             const struct in6_addr *address, const char *text) {
+    if (level <= EVENT_LOG_COMPILED_LEVEL && level <= EVENT_LOG_LEVEL)
+        event_log_record(level, type, first, second, number, address, text);
+}
+
+#endif //DHCP_V1_EVENT_LOG_H
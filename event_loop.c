@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "event_loop.h"
+
+bool event_loop_init(struct EventLoop *loop) {
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->running = false;
+
+    return loop->epoll_fd >= 0;
+}
+
+void event_loop_destroy(struct EventLoop *loop) {
+    close(loop->epoll_fd);
+    loop->epoll_fd = -1;
+}
+
+/**
+ * Starts watching the file descriptor of a handler
+ * @param loop
+ * @param handler - *EventHandler: must stay valid while it is watched
+ * @param events - uint32_t: EPOLLIN, EPOLLOUT, ...
+ * @return True, if the file descriptor is watched
+ *         False, otherwise
+ */
+bool event_loop_add(struct EventLoop *loop, struct EventHandler *handler, uint32_t events) {
+    struct epoll_event event = {.events = events, .data.ptr = handler};
+
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, handler->fd, &event) == 0;
+}
+
+void event_loop_remove(struct EventLoop *loop, struct EventHandler *handler) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, handler->fd, NULL);
+}
+
+/**
+ * Dispatches ready file descriptors to their handlers until event_loop_stop() is called
+ * @param loop
+ */
+void event_loop_run(struct EventLoop *loop) {
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+
+    loop->running = true;
+    while (loop->running) {
+        int ready = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, -1);
+
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait() - event_loop_run");
+            break;
+        }
+
+        for (int i = 0; i < ready && loop->running; i++) {
+            struct EventHandler *handler = (struct EventHandler *) events[i].data.ptr;
+
+            handler->handle(handler, events[i].events);
+        }
+    }
+}
+
+void event_loop_stop(struct EventLoop *loop) {
+    loop->running = false;
+}
+
+/**
+ * Creates a non blocking timer that can be watched by the event loop
+ * @return file descriptor of the timer
+ *         -1, on failure
+ */
+int timer_open(void) {
+    return timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+}
+
+static bool timer_set(int timer_fd, long milliseconds, bool periodic) {
+    struct itimerspec timeout;
+
+    memset(&timeout, 0, sizeof (timeout));
+    timeout.it_value.tv_sec = milliseconds / 1000;
+    timeout.it_value.tv_nsec = (milliseconds % 1000) * 1000000;
+    if (milliseconds <= 0)
+        timeout.it_value.tv_nsec = 1;
+    if (periodic)
+        timeout.it_interval = timeout.it_value;
+
+    return timerfd_settime(timer_fd, 0, &timeout, NULL) == 0;
+}
+
+/**
+ * Arms a timer to expire once
+ * @param timer_fd
+ * @param milliseconds - long: delay until expiration, expires right away if not positive
+ * @return True, if the timer is armed
+ *         False, otherwise
+ */
+bool timer_arm_ms(int timer_fd, long milliseconds) {
+    return timer_set(timer_fd, milliseconds, false);
+}
+
+/**
+ * Arms a timer to expire every @param milliseconds
+ * @param timer_fd
+ * @param milliseconds - long: period of the timer
+ * @return True, if the timer is armed
+ *         False, otherwise
+ */
+bool timer_arm_periodic_ms(int timer_fd, long milliseconds) {
+    return timer_set(timer_fd, milliseconds, true);
+}
+
+/**
+ * Stops a timer, it does not expire until it is armed again
+ * @param timer_fd
+ */
+void timer_disarm(int timer_fd) {
+    struct itimerspec timeout;
+
+    memset(&timeout, 0, sizeof (timeout));
+    timerfd_settime(timer_fd, 0, &timeout, NULL);
+}
+
+/**
+ * Reads the expiration count of a timer, so it is not reported as ready again
+ * @param timer_fd
+ */
+void timer_acknowledge(int timer_fd) {
+    uint64_t expirations;
+
+    while (read(timer_fd, &expirations, sizeof (expirations)) < 0 && errno == EINTR);
+}
@@ -0,0 +1,46 @@
+#ifndef DHCP_V1_EVENT_LOOP_H
+#define DHCP_V1_EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EVENT_LOOP_MAX_EVENTS 32
+
+struct EventHandler;
+
+/**
+ * EventHandler structure, a file descriptor watched by the event loop
+ *  - fd - int: watched file descriptor
+ *  - handle - function: called with the epoll events every time the file descriptor is ready
+ *  - data - *void: context of the handler
+ */
+struct EventHandler {
+    int fd;
+    void (*handle)(struct EventHandler *handler, uint32_t events);
+    void *data;
+};
+
+/**
+ * EventLoop structure:
+ *  - epoll_fd - int: epoll instance
+ *  - running - bool: the loop returns once this is False
+ */
+struct EventLoop {
+    int epoll_fd;
+    bool running;
+};
+
+bool event_loop_init(struct EventLoop *loop);
+void event_loop_destroy(struct EventLoop *loop);
+bool event_loop_add(struct EventLoop *loop, struct EventHandler *handler, uint32_t events);
+void event_loop_remove(struct EventLoop *loop, struct EventHandler *handler);
+void event_loop_run(struct EventLoop *loop);
+void event_loop_stop(struct EventLoop *loop);
+
+int timer_open(void);
+bool timer_arm_ms(int timer_fd, long milliseconds);
+bool timer_arm_periodic_ms(int timer_fd, long milliseconds);
+void timer_disarm(int timer_fd);
+void timer_acknowledge(int timer_fd);
+
+#endif //DHCP_V1_EVENT_LOOP_H
@@ -0,0 +1,46 @@
+#include <stddef.h>
+
+#include "heap_counter.h"
+
+static uint64_t ALLOCATIONS = 0;
+static uint64_t FREES = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+
+void *__wrap_malloc(size_t size) {
+    __atomic_add_fetch(&ALLOCATIONS, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    __atomic_add_fetch(&ALLOCATIONS, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    __atomic_add_fetch(&ALLOCATIONS, 1, __ATOMIC_RELAXED);
+    return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer) {
+    if (pointer != NULL)
+        __atomic_add_fetch(&FREES, 1, __ATOMIC_RELAXED);
+    __real_free(pointer);
+}
+
+/**
+ * @return number of calls to malloc(), calloc() and realloc() since the start
+ */
+uint64_t heap_counter_allocations(void) {
+    return __atomic_load_n(&ALLOCATIONS, __ATOMIC_RELAXED);
+}
+
+/**
+ * @return number of calls to free() with a valid pointer since the start
+ */
+uint64_t heap_counter_frees(void) {
+    return __atomic_load_n(&FREES, __ATOMIC_RELAXED);
+}
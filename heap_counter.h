@@ -0,0 +1,15 @@
+#ifndef DHCP_V1_HEAP_COUNTER_H
+#define DHCP_V1_HEAP_COUNTER_H
+
+#include <stdint.h>
+
+/*
+ * Counts the calls to malloc(), calloc(), realloc() and free() made by the server itself. The executable is linked
+ * with --wrap for these functions, so the counters cost one atomic add per call and the C library keeps its own
+ * allocator.
+ */
+
+uint64_t heap_counter_allocations(void);
+uint64_t heap_counter_frees(void);
+
+#endif //DHCP_V1_HEAP_COUNTER_H
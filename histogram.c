@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "histogram.h"
+
+/**
+ * Gives the bucket a value is counted in
+ * @param value
+ * @return index of the bucket, less than HISTOGRAM_BUCKETS
+ */
+uint32_t histogram_bucket(uint64_t value) {
+    int msb;
+
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (uint32_t) value;
+
+    msb = 63 - __builtin_clzll(value);
+    return (uint32_t) (msb - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+           (uint32_t) ((value >> (msb - HISTOGRAM_SUB_BUCKET_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/**
+ * Gives the smallest value that falls in a bucket
+ * @param bucket - uint32_t: index of the bucket, less than HISTOGRAM_BUCKETS
+ * @return lowest value of the bucket
+ */
+uint64_t histogram_bucket_low(uint32_t bucket) {
+    uint32_t power = bucket / HISTOGRAM_SUB_BUCKETS, sub_bucket = bucket % HISTOGRAM_SUB_BUCKETS;
+
+    if (power == 0)
+        return sub_bucket;
+    return (uint64_t) (HISTOGRAM_SUB_BUCKETS + sub_bucket) << (power - 1);
+}
+
+void histogram_reset(struct Histogram *histogram) {
+    memset(histogram, 0, sizeof (struct Histogram));
+    histogram->min = UINT64_MAX;
+}
+
+void histogram_record(struct Histogram *histogram, uint64_t value) {
+    histogram->counts[histogram_bucket(value)]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value < histogram->min)
+        histogram->min = value;
+    if (value > histogram->max)
+        histogram->max = value;
+}
+
+/**
+ * Adds every value recorded in @param source to @param destination
+ * @param destination
+ * @param source
+ */
+void histogram_merge(struct Histogram *destination, const struct Histogram *source) {
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        destination->counts[i] += source->counts[i];
+
+    destination->count += source->count;
+    destination->sum += source->sum;
+    if (source->min < destination->min)
+        destination->min = source->min;
+    if (source->max > destination->max)
+        destination->max = source->max;
+}
+
+/**
+ * Gives the value below which a percentage of the recorded values fall
+ * @param histogram
+ * @param percentile - double: between 0 and 100
+ * @return highest value of the bucket that holds the percentile, never more than the largest value recorded
+ *         0, if nothing was recorded
+ */
+uint64_t histogram_percentile(const struct Histogram *histogram, double percentile) {
+    uint64_t rank, seen = 0;
+
+    if (histogram->count == 0)
+        return 0;
+
+    rank = (uint64_t) (percentile / 100.0 * (double) histogram->count + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t high = i + 1 < HISTOGRAM_BUCKETS ? histogram_bucket_low(i + 1) - 1 : UINT64_MAX;
+            return high < histogram->max ? high : histogram->max;
+        }
+    }
+    return histogram->max;
+}
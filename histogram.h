@@ -0,0 +1,33 @@
+#ifndef DHCP_V1_HISTOGRAM_H
+#define DHCP_V1_HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * Histogram structure, log-linear histogram in the style of HdrHistogram: every power of 2 is split in
+ * HISTOGRAM_SUB_BUCKETS buckets, so a recorded value is known within 1/16 of itself. Recording is O(1) and never allocates.
+ *  - counts - uint64_t[]: number of values recorded in every bucket
+ *  - count - uint64_t: number of values recorded
+ *  - sum - uint64_t: sum of the values recorded
+ *  - min, max - uint64_t: smallest and largest value recorded
+ */
+struct Histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+};
+
+void histogram_reset(struct Histogram *histogram);
+void histogram_record(struct Histogram *histogram, uint64_t value);
+void histogram_merge(struct Histogram *destination, const struct Histogram *source);
+uint64_t histogram_percentile(const struct Histogram *histogram, double percentile);
+uint32_t histogram_bucket(uint64_t value);
+uint64_t histogram_bucket_low(uint32_t bucket);
+
+#endif //DHCP_V1_HISTOGRAM_H
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "key.h"
+
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64_value(char character) {
+    if (character >= 'A' && character <= 'Z')
+        return character - 'A';
+    if (character >= 'a' && character <= 'z')
+        return character - 'a' + 26;
+    if (character >= '0' && character <= '9')
+        return character - '0' + 52;
+    if (character == '+')
+        return 62;
+    if (character == '/')
+        return 63;
+    return -1;
+}
+
+/**
+ * Decodes a base64 WireGuard key
+ * @param text - *char: 44 characters, the last one being '='
+ * @param key - uint8_t[]: where the raw key is stored
+ * @return True, if the text is a valid key
+ *         False, otherwise
+ */
+bool key_from_base64(const char *text, uint8_t key[KEY_LENGTH]) {
+    uint32_t accumulator = 0;
+    int bits = 0, length = 0;
+
+    if (strlen(text) != KEY_BASE64_LENGTH || text[KEY_BASE64_LENGTH - 1] != '=')
+        return false;
+
+    for (int i = 0; i < KEY_BASE64_LENGTH - 1; i++) {
+        int value = base64_value(text[i]);
+
+        if (value < 0)
+            return false;
+
+        accumulator = (accumulator << 6) | (uint32_t) value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            key[length++] = (uint8_t) (accumulator >> bits);
+        }
+    }
+    return length == KEY_LENGTH;
+}
+
+/**
+ * Encodes a raw WireGuard key the way wg and wg-quick expect it
+ * @param key - uint8_t[]: raw key
+ * @param text - char[]: where the 44 characters and the terminator are stored
+ */
+void key_to_base64(const uint8_t key[KEY_LENGTH], char text[KEY_BASE64_LENGTH + 1]) {
+    uint32_t accumulator = 0;
+    int bits = 0, length = 0;
+
+    for (int i = 0; i < KEY_LENGTH; i++) {
+        accumulator = (accumulator << 8) | key[i];
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            text[length++] = BASE64_ALPHABET[(accumulator >> bits) & 0x3F];
+        }
+    }
+    text[length++] = BASE64_ALPHABET[(accumulator << (6 - bits)) & 0x3F];
+    text[length++] = '=';
+    text[length] = '\0';
+}
@@ -0,0 +1,13 @@
+#ifndef DHCP_V1_KEY_H
+#define DHCP_V1_KEY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define KEY_LENGTH 32
+#define KEY_BASE64_LENGTH 44
+
+bool key_from_base64(const char *text, uint8_t key[KEY_LENGTH]);
+void key_to_base64(const uint8_t key[KEY_LENGTH], char text[KEY_BASE64_LENGTH + 1]);
+
+#endif //DHCP_V1_KEY_H
@@ -0,0 +1,268 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lease_db.h"
+
+#define RECORD_DATA_OFFSET offsetof(struct LeaseRecord, address)
+
+static uint32_t crc_table[256];
+static bool crc_table_ready = false;
+
+static uint32_t crc32(const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    if (!crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+                value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            crc_table[i] = value;
+        }
+        crc_table_ready = true;
+    }
+
+    while (length-- > 0)
+        crc = crc_table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static uint32_t header_checksum(const struct LeaseDbHeader *header) {
+    return crc32(header, offsetof(struct LeaseDbHeader, checksum));
+}
+
+static uint32_t record_checksum(const struct LeaseRecord *record) {
+    return crc32((const char *) record + RECORD_DATA_OFFSET, sizeof (struct LeaseRecord) - RECORD_DATA_OFFSET);
+}
+
+static size_t file_length(uint32_t capacity) {
+    return sizeof (struct LeaseDbHeader) + (size_t) capacity * sizeof (struct LeaseRecord);
+}
+
+/**
+ * Checks that a mapped file was written by this layout for the same address pool
+ */
+static bool header_matches(const struct LeaseDbHeader *header, size_t length, const struct in6_addr *network,
+                           uint32_t prefix_length) {
+    return header->magic == LEASE_DB_MAGIC && header->version == LEASE_DB_VERSION &&
+           header->record_size == sizeof (struct LeaseRecord) && header->checksum == header_checksum(header) &&
+           address_equal(&header->network, network) && header->prefix_length == prefix_length &&
+           length >= file_length(header->capacity);
+}
+
+static bool map(struct LeaseDb *db, size_t length) {
+    void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, db->fd, 0);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+    db->header = (struct LeaseDbHeader *) mapping;
+    db->records = (struct LeaseRecord *) (db->header + 1);
+    db->mapped_length = length;
+    return true;
+}
+
+/**
+ * Pushes the records of [@param first, @param last) on the free stack, the lowest record ends up on top
+ */
+static void push_free(struct LeaseDb *db, uint32_t first, uint32_t last) {
+    for (uint32_t slot = last; slot > first; slot--)
+        if (!lease_db_is_valid(db, slot - 1)) {
+            db->records[slot - 1].in_use = 0;
+            db->free_slots[db->free_count++] = slot - 1;
+        }
+}
+
+/**
+ * Doubles the number of records of the file, the mapping is moved if it cannot grow in place
+ * @param db
+ * @return True, if the file could grow
+ *         False, otherwise
+ */
+static bool grow(struct LeaseDb *db) {
+    uint32_t capacity = db->header->capacity, grown = capacity * 2;
+    size_t length = file_length(grown);
+    uint32_t *free_slots;
+    void *mapping;
+
+    free_slots = (uint32_t *) realloc(db->free_slots, grown * sizeof (uint32_t));
+    if (free_slots == NULL)
+        return false;
+    db->free_slots = free_slots;
+
+    if (ftruncate(db->fd, (off_t) length) != 0)
+        return false;
+    mapping = mremap(db->header, db->mapped_length, length, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    db->header = (struct LeaseDbHeader *) mapping;
+    db->records = (struct LeaseRecord *) (db->header + 1);
+    db->mapped_length = length;
+
+    db->header->capacity = grown;
+    db->header->checksum = header_checksum(db->header);
+    push_free(db, capacity, grown);
+    return true;
+}
+
+/**
+ * Maps the lease file, the file is created, or emptied when it belongs to another layout or address pool
+ * @param db
+ * @param path - *char: lease file
+ * @param network - *in6_addr: network of the address pool, IPv4-mapped for IPv4
+ * @param prefix_length - uint32_t: mask of the address pool
+ * @return True, if the file is mapped; records that hold a lease are then found with lease_db_is_valid()
+ *         False, otherwise
+ */
+bool lease_db_open(struct LeaseDb *db, const char *path, const struct in6_addr *network, uint32_t prefix_length) {
+    struct stat status;
+
+    db->header = NULL;
+    db->free_slots = NULL;
+    db->free_count = 0;
+    db->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (db->fd < 0)
+        return false;
+    if (fstat(db->fd, &status) != 0)
+        goto FAIL;
+
+    if ((size_t) status.st_size >= sizeof (struct LeaseDbHeader)) {
+        if (!map(db, (size_t) status.st_size))
+            goto FAIL;
+        if (!header_matches(db->header, db->mapped_length, network, prefix_length)) {
+            munmap(db->header, db->mapped_length);
+            db->header = NULL;
+        }
+    }
+
+    if (db->header == NULL) {
+        if (ftruncate(db->fd, 0) != 0 || ftruncate(db->fd, (off_t) file_length(LEASE_DB_INITIAL_CAPACITY)) != 0)
+            goto FAIL;
+        if (!map(db, file_length(LEASE_DB_INITIAL_CAPACITY)))
+            goto FAIL;
+
+        db->header->magic = LEASE_DB_MAGIC;
+        db->header->version = LEASE_DB_VERSION;
+        db->header->record_size = sizeof (struct LeaseRecord);
+        db->header->capacity = LEASE_DB_INITIAL_CAPACITY;
+        db->header->network = *network;
+        db->header->prefix_length = prefix_length;
+        db->header->checksum = header_checksum(db->header);
+    }
+
+    db->free_slots = (uint32_t *) malloc(db->header->capacity * sizeof (uint32_t));
+    if (db->free_slots == NULL)
+        goto FAIL;
+    push_free(db, 0, db->header->capacity);
+    return true;
+
+    FAIL:
+    lease_db_close(db);
+    return false;
+}
+
+/**
+ * Flushes the leases to the file and unmaps it
+ * @param db
+ */
+void lease_db_close(struct LeaseDb *db) {
+    if (db->header != NULL) {
+        msync(db->header, db->mapped_length, MS_SYNC);
+        munmap(db->header, db->mapped_length);
+    }
+    if (db->fd >= 0)
+        close(db->fd);
+    free(db->free_slots);
+
+    db->header = NULL;
+    db->records = NULL;
+    db->free_slots = NULL;
+    db->free_count = 0;
+    db->fd = -1;
+}
+
+/**
+ * Checks if a record holds a lease that was completely written
+ * @param db
+ * @param slot - uint32_t: record
+ * @return True, if the record holds a lease
+ *         False, otherwise
+ */
+bool lease_db_is_valid(const struct LeaseDb *db, uint32_t slot) {
+    if (slot >= db->header->capacity)
+        return false;
+
+    return db->records[slot].in_use == 1 && db->records[slot].checksum == record_checksum(&db->records[slot]);
+}
+
+/**
+ * Writes the lease of a peer in a free record, the file grows when every record is in use
+ * @param db
+ * @param peer - *Peer: peer that holds the lease
+ * @param expires - uint32_t: when the lease expires, 0 if it never does
+ * @return record of the lease
+ *         PEER_NO_RECORD, if the file could not grow
+ */
+uint32_t lease_db_store(struct LeaseDb *db, const struct Peer *peer, uint32_t expires) {
+    struct LeaseRecord *record;
+    uint32_t slot;
+
+    if (db->free_count == 0 && !grow(db))
+        return PEER_NO_RECORD;
+
+    slot = db->free_slots[--db->free_count];
+    record = &db->records[slot];
+
+    record->address = peer->address;
+    record->expires = expires;
+    strncpy(record->public_key, peer->public_key, sizeof (record->public_key));
+    strncpy(record->allowed_ips, peer->allowed_ips, sizeof (record->allowed_ips));
+    strncpy(record->endpoint, peer->endpoint, sizeof (record->endpoint));
+    strncpy(record->port, peer->port, sizeof (record->port));
+    record->checksum = record_checksum(record);
+    __atomic_store_n(&record->in_use, 1, __ATOMIC_RELEASE);
+
+    return slot;
+}
+
+/**
+ * Frees the record of a lease
+ * @param db
+ * @param slot - uint32_t: record given by lease_db_store(), PEER_NO_RECORD is ignored
+ */
+void lease_db_erase(struct LeaseDb *db, uint32_t slot) {
+    if (slot >= db->header->capacity || db->records[slot].in_use == 0)
+        return;
+
+    __atomic_store_n(&db->records[slot].in_use, 0, __ATOMIC_RELEASE);
+    db->free_slots[db->free_count++] = slot;
+}
+
+/**
+ * Moves the expiry of a lease in place. The expiry is not covered by the checksum, so the record is renewed by a
+ * single store: after a crash it holds either the old or the new expiry, never a record that fails its checksum.
+ * @param db
+ * @param slot - uint32_t: record given by lease_db_store(), PEER_NO_RECORD is ignored
+ * @param expires - uint32_t: when the lease expires, 0 if it never does
+ */
+void lease_db_renew(struct LeaseDb *db, uint32_t slot, uint32_t expires) {
+    if (slot >= db->header->capacity || db->records[slot].in_use == 0)
+        return;
+
+    __atomic_store_n(&db->records[slot].expires, expires, __ATOMIC_RELAXED);
+}
+
+/**
+ * Schedules the write back of the records changed since the last call, without waiting for it. The records are in the
+ * page cache already, so they survive a crash of the server; they can be lost if the machine goes down before the
+ * kernel writes them.
+ * @param db
+ */
+void lease_db_sync(struct LeaseDb *db) {
+    msync(db->header, db->mapped_length, MS_ASYNC);
+}
@@ -0,0 +1,81 @@
+#ifndef DHCP_V1_LEASE_DB_H
+#define DHCP_V1_LEASE_DB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "peer_table.h"
+
+#define LEASE_DB_MAGIC 0x4C454153u
+#define LEASE_DB_VERSION 3
+#define LEASE_DB_INITIAL_CAPACITY 1024
+
+/**
+ * LeaseDbHeader structure, first bytes of the lease file
+ *  - magic - uint32_t: LEASE_DB_MAGIC
+ *  - version - uint32_t: LEASE_DB_VERSION
+ *  - record_size - uint32_t: sizeof (struct LeaseRecord), files written by another layout are discarded
+ *  - capacity - uint32_t: number of records in the file
+ *  - network - in6_addr: network of the address pool, IPv4-mapped for IPv4
+ *  - prefix_length - uint32_t: mask of the address pool, leases of another pool are discarded
+ *  - checksum - uint32_t: CRC32 of the fields above
+ */
+struct LeaseDbHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    struct in6_addr network;
+    uint32_t prefix_length;
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+/**
+ * LeaseRecord structure, one lease
+ *  - in_use - uint32_t: 1 if the record holds a lease, written last so a half written record is never used
+ *  - expires - uint32_t: when the lease expires, 0 if it never does; left out of the checksum so a renewal is one
+ *    aligned store and a crash can never leave a record half renewed
+ *  - checksum - uint32_t: CRC32 of every field after this one
+ *  - address - in6_addr: leased address, IPv4-mapped for IPv4
+ *  - public_key, allowed_ips, endpoint, port - char[]: peer as written in the config file
+ */
+struct LeaseRecord {
+    uint32_t in_use;
+    uint32_t expires;
+    uint32_t checksum;
+    struct in6_addr address;
+    char public_key[PEER_PUBLIC_KEY_LENGTH];
+    char allowed_ips[PEER_ALLOWED_IPS_LENGTH];
+    char endpoint[PEER_ENDPOINT_LENGTH];
+    char port[PEER_PORT_LENGTH];
+};
+
+/**
+ * LeaseDb structure, lease file mapped in memory and updated in place
+ *  - fd - int: lease file
+ *  - header - *LeaseDbHeader: start of the mapping
+ *  - records - *LeaseRecord: records, right after the header
+ *  - mapped_length - size_t: length of the mapping
+ *  - free_slots - *uint32_t: stack of records that hold no lease
+ *  - free_count - uint32_t: number of free records
+ */
+struct LeaseDb {
+    int fd;
+    struct LeaseDbHeader *header;
+    struct LeaseRecord *records;
+    size_t mapped_length;
+    uint32_t *free_slots;
+    uint32_t free_count;
+};
+
+bool lease_db_open(struct LeaseDb *db, const char *path, const struct in6_addr *network, uint32_t prefix_length);
+void lease_db_close(struct LeaseDb *db);
+bool lease_db_is_valid(const struct LeaseDb *db, uint32_t slot);
+uint32_t lease_db_store(struct LeaseDb *db, const struct Peer *peer, uint32_t expires);
+void lease_db_erase(struct LeaseDb *db, uint32_t slot);
+void lease_db_renew(struct LeaseDb *db, uint32_t slot, uint32_t expires);
+void lease_db_sync(struct LeaseDb *db);
+
+#endif //DHCP_V1_LEASE_DB_H
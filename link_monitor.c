@@ -0,0 +1,119 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+
+#include "link_monitor.h"
+#include "netlink.h"
+
+#define LINK_MONITOR_RECEIVE_SIZE 16384
+
+/**
+ * Subscribes to the link events, interfaces are watched with link_monitor_watch()
+ * @param monitor
+ * @return True, if the socket is open
+ *         False, otherwise
+ */
+bool link_monitor_open(struct LinkMonitor *monitor) {
+    monitor->links = NULL;
+    monitor->link_count = 0;
+    monitor->fd = netlink_open(NETLINK_ROUTE, RTMGRP_LINK);
+    if (monitor->fd < 0)
+        return false;
+    if (fcntl(monitor->fd, F_SETFL, fcntl(monitor->fd, F_GETFL) | O_NONBLOCK) < 0) {
+        link_monitor_close(monitor);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Looks an interface up and watches it. The monitor is already subscribed, so a removal that happens in between is not
+ * missed.
+ * @param monitor
+ * @param interface_name - *char: interface to watch
+ * @return True, if the interface exists
+ *         False, otherwise
+ */
+bool link_monitor_watch(struct LinkMonitor *monitor, const char *interface_name) {
+    struct WatchedLink *links = (struct WatchedLink *) realloc(monitor->links,
+                                                               (monitor->link_count + 1) * sizeof (struct WatchedLink));
+    struct WatchedLink *link;
+
+    if (links == NULL)
+        return false;
+    monitor->links = links;
+    link = &links[monitor->link_count];
+    strncpy(link->name, interface_name, IF_NAMESIZE - 1);
+    link->name[IF_NAMESIZE - 1] = '\0';
+    link->index = if_nametoindex(link->name);
+    if (link->index == 0)
+        return false;
+    monitor->link_count++;
+    return true;
+}
+
+void link_monitor_close(struct LinkMonitor *monitor) {
+    if (monitor->fd >= 0)
+        close(monitor->fd);
+    monitor->fd = -1;
+    free(monitor->links);
+    monitor->links = NULL;
+    monitor->link_count = 0;
+}
+
+/**
+ * @return watched interface with this index, NULL if none
+ */
+static struct WatchedLink *find_link(struct LinkMonitor *monitor, unsigned int index) {
+    for (size_t i = 0; i < monitor->link_count; i++)
+        if (monitor->links[i].index == index)
+            return &monitor->links[i];
+    return NULL;
+}
+
+/**
+ * Reads every pending link event. An interface is gone when it is deleted or set down. When the kernel dropped events
+ * because the socket was full, the interfaces are looked up again instead.
+ * @param monitor
+ * @return name of a watched interface that is gone
+ *         NULL, if none is
+ */
+const char *link_monitor_gone(struct LinkMonitor *monitor) {
+    char buffer[LINK_MONITOR_RECEIVE_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    const char *gone = NULL;
+
+    for (;;) {
+        ssize_t received = recv(monitor->fd, buffer, sizeof (buffer), 0);
+        int length;
+
+        if (received < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                for (size_t i = 0; i < monitor->link_count; i++)
+                    if (if_nametoindex(monitor->links[i].name) != monitor->links[i].index)
+                        gone = monitor->links[i].name;
+                continue;
+            }
+            return gone;
+        }
+
+        length = (int) received;
+        for (struct nlmsghdr *message = (struct nlmsghdr *) buffer; NLMSG_OK(message, length);
+             message = NLMSG_NEXT(message, length)) {
+            const struct ifinfomsg *information = (const struct ifinfomsg *) NLMSG_DATA(message);
+            struct WatchedLink *link;
+
+            if ((message->nlmsg_type != RTM_NEWLINK && message->nlmsg_type != RTM_DELLINK) ||
+                message->nlmsg_len < NLMSG_LENGTH(sizeof (struct ifinfomsg)))
+                continue;
+            link = find_link(monitor, (unsigned int) information->ifi_index);
+            if (link != NULL && (message->nlmsg_type == RTM_DELLINK || !(information->ifi_flags & IFF_UP)))
+                gone = link->name;
+        }
+    }
+}
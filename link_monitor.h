@@ -0,0 +1,36 @@
+#ifndef DHCP_V1_LINK_MONITOR_H
+#define DHCP_V1_LINK_MONITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <net/if.h>
+
+/**
+ * WatchedLink structure, an interface watched by a link monitor
+ *  - name - char[]: name of the interface
+ *  - index - unsigned int: index of the interface when it started being watched
+ */
+struct WatchedLink {
+    char name[IF_NAMESIZE];
+    unsigned int index;
+};
+
+/**
+ * LinkMonitor structure, a netlink socket subscribed to the link events of the kernel, watching any number of
+ * interfaces. The socket is readable whenever a link changes, so it can be watched by an event loop.
+ *  - fd - int: NETLINK_ROUTE socket in the RTMGRP_LINK group, non blocking
+ *  - links - *WatchedLink: watched interfaces
+ *  - link_count - size_t: number of watched interfaces
+ */
+struct LinkMonitor {
+    int fd;
+    struct WatchedLink *links;
+    size_t link_count;
+};
+
+bool link_monitor_open(struct LinkMonitor *monitor);
+bool link_monitor_watch(struct LinkMonitor *monitor, const char *interface_name);
+void link_monitor_close(struct LinkMonitor *monitor);
+const char *link_monitor_gone(struct LinkMonitor *monitor);
+
+#endif //DHCP_V1_LINK_MONITOR_H
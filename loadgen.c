@@ -0,0 +1,482 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "histogram.h"
+#include "message.h"
+#include "protocol.h"
+
+#define DEFAULT_SERVER_ADDRESS "127.0.0.1"
+#define DEFAULT_SERVER_PORT 8888
+#define DEFAULT_CONCURRENCY 16
+#define DEFAULT_OPERATIONS 10000
+#define DEFAULT_JOIN_PERCENT 50
+#define DEFAULT_TIMEOUT_MS 1000
+#define CLIENT_ENDPOINT "127.0.0.1"
+#define CLIENT_PORT "51820"
+#define MAX_EVENTS 64
+
+/**
+ * Lease structure, one address leased by a client
+ *  - address - in6_addr: leased address, IPv4-mapped for IPv4
+ *  - key_number - uint32_t: join that generated the public key of the lease, a version 2 leave has to send that key
+ */
+struct Lease {
+    struct in6_addr address;
+    uint32_t key_number;
+};
+
+/**
+ * Client structure, one simulated client with its own socket, it has at most one request in flight
+ *  - fd - int: socket connected to the server
+ *  - index - uint32_t: number of the client, part of every public key it generates
+ *  - option - int: OPTION_JOIN or OPTION_LEAVE of the request in flight
+ *  - waiting - bool: True, while a request is in flight
+ *  - sent_ns - uint64_t: when the request in flight was sent
+ *  - request_id - uint32_t: id of the request in flight, version 2 only
+ *  - replies - int: datagrams received for the request in flight, a legacy join is answered with two
+ *  - key_number - uint32_t: join that generated the public key of the request in flight
+ *  - leases - *Lease: leases of the client
+ *  - lease_count, lease_capacity - size_t
+ *  - joins - uint32_t: number of joins sent, part of every public key the client generates
+ */
+struct Client {
+    int fd;
+    uint32_t index;
+    int option;
+    bool waiting;
+    uint64_t sent_ns;
+    uint32_t request_id;
+    int replies;
+    uint32_t key_number;
+    struct Lease *leases;
+    size_t lease_count;
+    size_t lease_capacity;
+    uint32_t joins;
+};
+
+/**
+ * Options of a run
+ */
+struct Options {
+    const char *address;
+    uint16_t port;
+    uint32_t concurrency;
+    uint64_t operations;
+    double seconds;
+    uint32_t join_percent;
+    int version;
+    uint64_t timeout_ns;
+    const char *stats_socket;
+    uint16_t pool;
+    uint32_t first_client;
+};
+
+/**
+ * Outcome of a run
+ */
+struct Results {
+    uint64_t sent;
+    uint64_t completed;
+    uint64_t timeouts;
+    uint64_t rejected;
+    struct Histogram join_latency;
+    struct Histogram leave_latency;
+};
+
+static uint64_t now_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static void fail(const char *message) {
+    perror(message);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Builds the public key of a join of a client, no other join of the run uses it
+ * @param key_number - uint32_t: number of the join
+ */
+static void generate_key(const struct Client *client, uint32_t key_number, char text[KEY_BASE64_LENGTH + 1]) {
+    uint8_t key[KEY_LENGTH];
+
+    memset(key, 0, sizeof (key));
+    memcpy(key, &client->index, sizeof (client->index));
+    memcpy(key + sizeof (client->index), &key_number, sizeof (key_number));
+    key[KEY_LENGTH - 1] = 0x5A;
+    key_to_base64(key, text);
+}
+
+/**
+ * Encodes the next request of a client, joins are picked following the join percentage, a client without leases
+ * always joins
+ * @return length of the datagram
+ */
+static size_t build_request(struct Client *client, const struct Options *options, char *datagram, size_t size) {
+    bool join = client->lease_count == 0 || (uint32_t) (rand() % 100) < options->join_percent;
+    char key[KEY_BASE64_LENGTH + 1];
+    struct in6_addr address = in6addr_any;
+
+    client->option = join ? OPTION_JOIN : OPTION_LEAVE;
+    if (join) {
+        client->key_number = client->joins++;
+    } else {
+        client->lease_count--;
+        address = client->leases[client->lease_count].address;
+        client->key_number = client->leases[client->lease_count].key_number;
+    }
+    generate_key(client, client->key_number, key);
+
+    if (options->version == PROTOCOL_LEGACY_VERSION) {
+        struct Message message;
+
+        memset(&message, 0, sizeof (message));
+        message.OPTION = client->option;
+        message.ADDRESS = address_to_ipv4(&address);
+        snprintf(message.PUBLIC_KEY, sizeof (message.PUBLIC_KEY), "%s", key);
+        snprintf(message.ALLOWED_IPS, sizeof (message.ALLOWED_IPS), "0.0.0.0/0");
+        snprintf(message.ENDPOINT, sizeof (message.ENDPOINT), CLIENT_ENDPOINT);
+        snprintf(message.PORT, sizeof (message.PORT), CLIENT_PORT);
+        memcpy(datagram, &message, sizeof (message));
+        return sizeof (message);
+    } else {
+        struct Request request;
+
+        memset(&request, 0, sizeof (request));
+        request.option = (uint8_t) client->option;
+        request.request_id = ++client->request_id;
+        request.address = address;
+        request.pool = options->pool;
+        snprintf(request.public_key, sizeof (request.public_key), "%s", key);
+        snprintf(request.allowed_ips, sizeof (request.allowed_ips), "0.0.0.0/0");
+        snprintf(request.endpoint, sizeof (request.endpoint), CLIENT_ENDPOINT);
+        snprintf(request.port, sizeof (request.port), CLIENT_PORT);
+        return protocol_encode_request(&request, datagram, size);
+    }
+}
+
+static void add_lease(struct Client *client, const struct in6_addr *address) {
+    if (client->lease_count == client->lease_capacity) {
+        client->lease_capacity = client->lease_capacity == 0 ? 16 : client->lease_capacity * 2;
+        client->leases = (struct Lease *) realloc(client->leases, client->lease_capacity * sizeof (struct Lease));
+        if (client->leases == NULL)
+            fail("realloc() - add_lease");
+    }
+    client->leases[client->lease_count].address = *address;
+    client->leases[client->lease_count++].key_number = client->key_number;
+}
+
+/**
+ * Sends the next request of an idle client. Legacy leaves are not answered, they complete as soon as they are sent.
+ */
+static void send_request(struct Client *client, const struct Options *options, struct Results *results) {
+    char datagram[PROTOCOL_MAX_DATAGRAM];
+    size_t length = build_request(client, options, datagram, sizeof (datagram));
+
+    if (length == 0) {
+        fprintf(stderr, "send_request - request could not be encoded\n");
+        exit(EXIT_FAILURE);
+    }
+    if (send(client->fd, datagram, length, 0) < 0) {
+        if (errno != EAGAIN && errno != ENOBUFS)
+            fail("send() - send_request");
+        return;
+    }
+
+    results->sent++;
+    client->sent_ns = now_ns();
+    client->replies = 0;
+    client->waiting = true;
+
+    if (options->version == PROTOCOL_LEGACY_VERSION && client->option == OPTION_LEAVE) {
+        client->waiting = false;
+        results->completed++;
+    }
+}
+
+/**
+ * Handles a datagram from the server
+ */
+static void receive_reply(struct Client *client, const struct Options *options, struct Results *results) {
+    char datagram[PROTOCOL_MAX_DATAGRAM];
+    ssize_t length;
+
+    while ((length = recv(client->fd, datagram, sizeof (datagram), 0)) >= 0) {
+        uint64_t latency = now_ns() - client->sent_ns;
+
+        if (!client->waiting)
+            continue;
+
+        if (options->version == PROTOCOL_LEGACY_VERSION) {
+            struct in6_addr address;
+            in_addr_t ipv4;
+
+            if (length < (ssize_t) sizeof (in_addr_t))
+                continue;
+            if (client->replies++ == 0) {
+                memcpy(&ipv4, datagram, sizeof (ipv4));
+                address_from_ipv4(&address, ipv4);
+                add_lease(client, &address);
+                continue;
+            }
+        } else {
+            struct ReplyV2 reply;
+
+            if (length < (ssize_t) sizeof (reply))
+                continue;
+            memcpy(&reply, datagram, sizeof (reply));
+            if (ntohl(reply.request_id) != client->request_id)
+                continue;
+
+            if (reply.status != REPLY_OK) {
+                results->rejected++;
+            } else if (client->option == OPTION_JOIN) {
+                struct in6_addr address;
+                in_addr_t ipv4;
+
+                if (reply.address_family == ENDPOINT_FAMILY_IPV6) {
+                    memcpy(&address, reply.address, sizeof (address));
+                } else {
+                    memcpy(&ipv4, reply.address, sizeof (ipv4));
+                    address_from_ipv4(&address, ipv4);
+                }
+                add_lease(client, &address);
+            }
+        }
+
+        histogram_record(client->option == OPTION_JOIN ? &results->join_latency : &results->leave_latency, latency);
+        results->completed++;
+        client->waiting = false;
+    }
+}
+
+/**
+ * Reads one counter of the server from its stats socket, in text form
+ * @param path - *char: stats socket of the server
+ * @param name - *char: name of the counter
+ * @param value - *uint64_t: where the counter is stored
+ * @return True, if the counter was read
+ *         False, otherwise
+ */
+static bool read_server_counter(const char *path, const char *name, uint64_t *value) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    char text[16384], *line;
+    size_t length = 0, name_length = strlen(name);
+    ssize_t received;
+    int fd;
+
+    if (strlen(path) >= sizeof (address.sun_path))
+        return false;
+    strcpy(address.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, (struct sockaddr *) &address, sizeof (address)) < 0 || send(fd, "text", 4, 0) != 4) {
+        close(fd);
+        return false;
+    }
+    shutdown(fd, SHUT_WR);
+    while (length < sizeof (text) - 1 && (received = recv(fd, text + length, sizeof (text) - 1 - length, 0)) > 0)
+        length += (size_t) received;
+    close(fd);
+    text[length] = '\0';
+
+    for (line = text; line != NULL; line = strchr(line, '\n')) {
+        if (*line == '\n')
+            line++;
+        if (strncmp(line, name, name_length) == 0 && line[name_length] == ' ') {
+            *value = strtoull(line + name_length + 1, NULL, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_latency(const char *name, const struct Histogram *histogram) {
+    if (histogram->count == 0) {
+        printf("%-6s latency: no replies\n", name);
+        return;
+    }
+
+    printf("%-6s latency (us): p50 %.1f  p99 %.1f  p999 %.1f  max %.1f  mean %.1f  (%lu replies)\n", name,
+           (double) histogram_percentile(histogram, 50.0) / 1e3, (double) histogram_percentile(histogram, 99.0) / 1e3,
+           (double) histogram_percentile(histogram, 99.9) / 1e3, (double) histogram->max / 1e3,
+           (double) histogram->sum / (double) histogram->count / 1e3, histogram->count);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-a server address] [-p port] [-c concurrency] [-n operations] [-t seconds]"
+                    " [-m join percent] [-V protocol version 1|2] [-T timeout ms] [-S stats socket of the server]"
+                    " [-P pool ID sent in version 2 requests]"
+                    " [-k number of the first client, runs against the same cluster need distinct ranges of clients]\n",
+            name);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_options(int argc, char *argv[], struct Options *options) {
+    int option;
+
+    *options = (struct Options) {
+            .address = DEFAULT_SERVER_ADDRESS,
+            .port = DEFAULT_SERVER_PORT,
+            .concurrency = DEFAULT_CONCURRENCY,
+            .operations = DEFAULT_OPERATIONS,
+            .seconds = 0,
+            .join_percent = DEFAULT_JOIN_PERCENT,
+            .version = PROTOCOL_LEGACY_VERSION,
+            .timeout_ns = DEFAULT_TIMEOUT_MS * 1000000ull,
+            .stats_socket = NULL,
+            .pool = PROTOCOL_NO_POOL,
+    };
+
+    while ((option = getopt(argc, argv, "a:p:c:n:t:m:V:T:S:P:k:")) != -1) {
+        switch (option) {
+            case 'a':
+                options->address = optarg;
+                break;
+            case 'p':
+                options->port = (uint16_t) atoi(optarg);
+                break;
+            case 'c':
+                options->concurrency = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                options->operations = strtoull(optarg, NULL, 10);
+                break;
+            case 't':
+                options->seconds = atof(optarg);
+                break;
+            case 'm':
+                options->join_percent = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'V':
+                options->version = atoi(optarg);
+                break;
+            case 'T':
+                options->timeout_ns = strtoull(optarg, NULL, 10) * 1000000ull;
+                break;
+            case 'S':
+                options->stats_socket = optarg;
+                break;
+            case 'P':
+                options->pool = (uint16_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'k':
+                options->first_client = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (options->concurrency == 0 || options->join_percent > 100 ||
+        (options->version != PROTOCOL_LEGACY_VERSION && options->version != PROTOCOL_VERSION))
+        usage(argv[0]);
+}
+
+/**
+ * Drives join/leave traffic against a server over UDP: every client keeps one request in flight, the run stops after
+ * the given number of operations, or after the given number of seconds when -t is used. With -S, the heap allocations
+ * the server made during the run are reported.
+ */
+int main(int argc, char *argv[]) {
+    struct epoll_event events[MAX_EVENTS];
+    struct sockaddr_in server;
+    struct Options options;
+    struct Results results;
+    struct Client *clients;
+    uint64_t started, deadline, elapsed, allocations_before = 0, allocations_after = 0;
+    bool count_allocations;
+    int epoll_fd;
+
+    parse_options(argc, argv, &options);
+    memset(&results, 0, sizeof (results));
+    histogram_reset(&results.join_latency);
+    histogram_reset(&results.leave_latency);
+
+    memset(&server, 0, sizeof (server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.address, &server.sin_addr) != 1)
+        usage(argv[0]);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    clients = (struct Client *) calloc(options.concurrency, sizeof (struct Client));
+    if (epoll_fd < 0 || clients == NULL)
+        fail("epoll_create1()/calloc() - main");
+
+    for (uint32_t i = 0; i < options.concurrency; i++) {
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = &clients[i]};
+
+        clients[i].index = options.first_client + i;
+        clients[i].fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (clients[i].fd < 0 || connect(clients[i].fd, (struct sockaddr *) &server, sizeof (server)) < 0 ||
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clients[i].fd, &event) < 0)
+            fail("socket()/connect()/epoll_ctl() - main");
+    }
+
+    count_allocations = options.stats_socket != NULL &&
+                        read_server_counter(options.stats_socket, "heap_allocations", &allocations_before);
+    srand((unsigned int) time(NULL));
+    started = now_ns();
+    deadline = options.seconds > 0 ? started + (uint64_t) (options.seconds * 1e9) : UINT64_MAX;
+
+    for (;;) {
+        uint64_t now = now_ns();
+        bool done = now >= deadline || (options.seconds <= 0 && results.sent >= options.operations);
+        bool waiting = false;
+        int ready;
+
+        for (uint32_t i = 0; i < options.concurrency; i++) {
+            struct Client *client = &clients[i];
+
+            if (client->waiting && now - client->sent_ns > options.timeout_ns) {
+                client->waiting = false;
+                results.timeouts++;
+            }
+            if (!client->waiting && !done)
+                send_request(client, &options, &results);
+            done = done || (options.seconds <= 0 && results.sent >= options.operations);
+            waiting = waiting || client->waiting;
+        }
+        if (done && (!waiting || now >= deadline))
+            break;
+
+        ready = epoll_wait(epoll_fd, events, MAX_EVENTS, 10);
+        for (int i = 0; i < ready; i++)
+            receive_reply((struct Client *) events[i].data.ptr, &options, &results);
+    }
+
+    elapsed = now_ns() - started;
+    printf("protocol version %d, %u clients, %u%% joins\n", options.version, options.concurrency, options.join_percent);
+    printf("sent %lu, completed %lu, timeouts %lu, rejected %lu in %.3f s\n", results.sent, results.completed,
+           results.timeouts, results.rejected, (double) elapsed / 1e9);
+    printf("throughput: %.0f operations/s\n", (double) results.completed / ((double) elapsed / 1e9));
+    print_latency("join", &results.join_latency);
+    print_latency("leave", &results.leave_latency);
+    if (count_allocations && read_server_counter(options.stats_socket, "heap_allocations", &allocations_after))
+        printf("server heap allocations: %lu, %.4f per operation\n", allocations_after - allocations_before,
+               (double) (allocations_after - allocations_before) / (double) (results.completed > 0 ? results.completed : 1));
+    else if (options.stats_socket != NULL)
+        printf("server heap allocations: stats socket %s could not be read\n", options.stats_socket);
+
+    for (uint32_t i = 0; i < options.concurrency; i++) {
+        close(clients[i].fd);
+        free(clients[i].leases);
+    }
+    free(clients);
+    close(epoll_fd);
+    return 0;
+}
@@ -4,801 +4,2052 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <time.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <ifaddrs.h>
 #include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+
+#include "address_pool.h"
+#include "peer_table.h"
+#include "dataplane.h"
+#include "protocol.h"
+#include "batch.h"
+#include "event_loop.h"
+#include "udp_socket.h"
+#include "lease_db.h"
+#include "timer_wheel.h"
+#include "config_writer.h"
+#include "route_manager.h"
+#include "stats.h"
+#include "stats_socket.h"
+#include "wg_config.h"
+#include "admission.h"
+#include "response_cache.h"
+#include "apply_queue.h"
+#include "link_monitor.h"
+#include "control_socket.h"
+#include "heap_counter.h"
+#include "cluster.h"
+#include "event_log.h"
 
 #define WG_INTERFACE_NAME "wg0"
 #define WG_DUMMY_INTERFACE_NAME "wg_dummmy"
 
-#define DHCP_PORT 8888
-
-#define CONFIG_FILE "/etc/wireguard/wg0.conf"
-#define CONFIG_DUMMY_FILE "/etc/wireguard/wg_dummmy.conf"
-#define AUX_FILE "/etc/wireguard/aux.conf"
-
-#define CREATE_DUMMY_FILE_COMMAND "touch /etc/wireguard/wg_dummmy.conf"
-#define START_INTERFACE_COMMAND "wg-quick up wg0"
-#define START_DUMMY_INTERFACE_COMMAND "wg-quick up wg_dummmy"
-#define STOP_INTERFACE_COMMAND "wg-quick down wg_dummmy"
-#define REMOVE_OLD_DUMMY_CONFIG_FILE_COMMAND "sudo rm /etc/wireguard/wg_dummmy.conf"
-#define CREATE_AUX_FILE_COMMAND "touch /etc/wireguard/aux.conf"
-#define REPLACE_OLD_CONFIG_FILE_COMMAND "sudo rm /etc/wireguard/wg_dummmy.conf && sudo cp /etc/wireguard/aux.conf /etc/wireguard/wg_dummmy.conf && sudo rm /etc/wireguard/aux.conf"
-
-bool SHUTDOWN = false;
-bool DUMMY_INTERFACE_CONFIGURED = false;
-int NET_MASK;
-
-/**
- * Message structure:
- *  - OPTION - int: specifies wether server should add or remove peer information specified by this message
- *  - PUBLIC_KEY - char[256]: PUBLIC_KEY of the client, derived from PRIVATE_KEY found in the configuration file
- *  - ALLOWED_IPS - char[256]: string that represents ips that the client wants to route through the WireGuard tunnel
- *  - ADDRESS - in_addr_t: address that the client will receive from the server, this address is also being used when client wants to return the address
- *  - ENDPOINT - char[30]: real endpoint of the client, where server will send the routed packets
- *  - PORT - char[10]: port to which client WireGuard interface is listening
- */
-struct Message {
-    int OPTION;
-    char PUBLIC_KEY[256];
-    char ALLOWED_IPS[256];
-    in_addr_t ADDRESS;
-    char ENDPOINT[30];
-    char PORT[10];
-};
-
-/**
- * Node used in SLL
- *  - data - *in_addr
- *  - next - *node
- */
-struct node{
-    struct in_addr *data;
-    struct node *next;
-};
+#define DEFAULT_DHCP_PORT 8888
+#define PEER_TABLE_BUCKETS 1024
+
+#define DUMMY_INTERFACE_SUFFIX "_dhcp"
+
+#define DEFAULT_CONFIG_DIRECTORY "/etc/wireguard"
+#define CONFIG_FILE_EXTENSION ".conf"
+#define LEASE_DB_FILE_EXTENSION ".leases"
+#define STATS_SOCKET_FILE_NAME "wg_dummmy.stats"
+#define CONTROL_SOCKET_FILE_NAME "wg_dummmy.control"
+
+#define START_INTERFACE_COMMAND "wg-quick up "
+#define STOP_INTERFACE_COMMAND "wg-quick down "
+
+#define DEFAULT_BATCH_WINDOW_MS 10
+#define DEFAULT_BATCH_MAX_REQUESTS 64
+#define DEFAULT_LEASE_TIME 3600
+#define EXPIRY_TICK_MS 1000
+#define DEFAULT_WORKERS 1
+#define DEFAULT_ADMISSION_RATE 1000
+#define DEFAULT_ADMISSION_BURST 2000
+#define DEFAULT_MAX_IN_FLIGHT 1024
+#define ADMISSION_BUCKETS 4096
+#define RESPONSE_CACHE_ENTRIES 4096
+#define RESPONSE_CACHE_TTL_MS 30000
+#define DEFAULT_APPLY_QUEUE_LENGTH 16
+#define CLUSTER_SHARDS_PER_NODE 16
+#define DEFAULT_PRINT_LEVEL EVENT_LOG_INFO
+#define DEFAULT_FLIGHT_LEVEL EVENT_LOG_DEBUG
+
+long BATCH_WINDOW_MS = DEFAULT_BATCH_WINDOW_MS;
+long BATCH_MAX_REQUESTS = DEFAULT_BATCH_MAX_REQUESTS;
+long WORKERS = DEFAULT_WORKERS;
+double ADMISSION_RATE = DEFAULT_ADMISSION_RATE;
+double ADMISSION_BURST = DEFAULT_ADMISSION_BURST;
+long MAX_IN_FLIGHT = DEFAULT_MAX_IN_FLIGHT;
+long APPLY_QUEUE_LENGTH = DEFAULT_APPLY_QUEUE_LENGTH;
+uint32_t LEASE_TIME = DEFAULT_LEASE_TIME;
+int SHUTDOWN_EVENT = -1;
+int SIGNAL_EVENT = -1;
+struct LinkMonitor LINK_MONITOR = {.fd = -1};
+int DHCP_PORT = DEFAULT_DHCP_PORT;
+bool STUB_MODE = false;
+const char *DATAPLANE_BACKEND = "wireguard";
+const char *ROUTE_BACKEND = "netlink";
+const char *CONFIG_DIRECTORY = DEFAULT_CONFIG_DIRECTORY;
+char STATS_SOCKET_FILE[PATH_MAX];
+char CONTROL_SOCKET_FILE[PATH_MAX];
+const char **INTERFACE_OPTIONS = NULL;
+size_t INTERFACE_OPTION_COUNT = 0;
+const char *CLUSTER_NODES = NULL;
+uint32_t CLUSTER_NODE = 0;
+int PRINT_LEVEL = DEFAULT_PRINT_LEVEL;
+int FLIGHT_LEVEL = DEFAULT_FLIGHT_LEVEL;
 
 /**
- * State structure:
- *  - list - *SLL: SLL used to represent addresses already in use
- *  - start_address: *in_addr: first address of the address pool
- *  - end_address: *in_addr: last address of the address pool
- *  - next_free_address: *in_addr: next address that will be given to a client - chosen randomly from [start_address, end_address]
+ * State structure, one WireGuard interface served by the daemon, shared by the workers and the apply thread. Everything
+ * but the pool, the apply queue and the cluster is used under lock; the pool is split in one shard per worker and per
+ * node of the cluster, each with its own lock.
+ *  - lock - pthread_mutex_t: taken by a worker for the whole commit of the requests of a batch for this interface, and
+ *           by the apply thread to write the config file and release detached peers
+ *  - index - uint32_t: pool ID of the interface, its position among the served interfaces
+ *  - interface_name - char[]: WireGuard interface named by -i, whose config file the state is built from
+ *  - dummy_interface_name - char[]: interface the clients are added to
+ *  - listen_address - in_addr: local address whose requests go to this interface, INADDR_ANY if none does
+ *  - config_file, dummy_config_file, lease_db_file - char[]: files of the interface, in the config directory
+ *  - wg_config - WgConfig: config file of interface_name, parsed once at startup
+ *  - prefix_length - int: mask of the network of the interface
+ *  - pool - *AddressPool: addresses of the network of the interface, IPv4 or IPv6, and which of them are leased
+ *  - peers - *PeerTable: peers added by clients, indexed by public key, leased address and endpoint
+ *  - config_base - *char: content of the dummy config file before any client joined
+ *  - config_base_length - size_t: length of config_base
+ *  - dataplane - *Dataplane: applies peer changes to the live dummy interface
+ *  - leases - *LeaseDb: leases of the peers, kept on disk so a restart does not forget them
+ *  - expiry - *TimerWheel: deadlines of the leases, one tick per second of CLOCK_MONOTONIC
+ *  - config - *ConfigWriter: writes the dummy config file from config_base and the peer table
+ *  - routes - *RouteManager: host routes of the leased addresses through the dummy interface
+ *  - stats - *Stats: counters, gauges and latency histograms of the shared commit stages, read by the stats socket
+ *  - applies - *ApplyQueue: committed batches waiting for the apply thread, shared by every interface
+ *  - cluster - *Cluster: nodes the leases are replicated to, NULL if the daemon runs alone
+ *  - config_rewrite - bool: True, if a peer was removed since the config file was last written
+ *  - config_first_new - *Peer: first peer added since the config file was last written, NULL if none
  */
 struct State {
-    struct SLL *list;
-    struct in_addr *start_address;
-    struct in_addr *end_address;
-    struct in_addr *next_free_address;
+    pthread_mutex_t lock;
+    uint32_t index;
+    char interface_name[IF_NAMESIZE];
+    char dummy_interface_name[IF_NAMESIZE];
+    struct in_addr listen_address;
+    char config_file[PATH_MAX];
+    char dummy_config_file[PATH_MAX];
+    char lease_db_file[PATH_MAX];
+    struct WgConfig wg_config;
+    int prefix_length;
+    struct AddressPool *pool;
+    struct PeerTable *peers;
+    char *config_base;
+    size_t config_base_length;
+    struct Dataplane *dataplane;
+    struct LeaseDb *leases;
+    struct TimerWheel *expiry;
+    struct ConfigWriter *config;
+    struct RouteManager *routes;
+    struct Stats *stats;
+    struct ApplyQueue *applies;
+    struct Cluster *cluster;
+    bool config_rewrite;
+    struct Peer *config_first_new;
 };
 
 /**
- * SLL structure
- *  - head - *node: first element in SLL
- *  - tail - *node: last element in SLL
- *  - start_address - *in_addr: first address that can be given
- *  - end_address - *in_addr: last address that can be given
- *  - next_free_address - *in_addr: next address that will be given
+ * Daemon structure, what the interfaces served by the daemon share: every worker serves the requests of every
+ * interface, one apply thread applies the changes of all of them
+ *  - states - **State: one per served interface, in the order of the -i options; the index of a state is the pool ID
+ *             clients put in their requests
+ *  - state_count - uint32_t: number of served interfaces
+ *  - applies - *ApplyQueue: committed batches of every interface, waiting for the apply thread
+ *  - cluster - *Cluster: nodes the leases are replicated to, NULL if the daemon runs alone
+ *  - in_flight - uint64_t: requests admitted by every worker and not answered yet, updated atomically
+ *  - stats - *Stats: gauges of the apply queue and of the heap, read by the stats socket
  */
-struct SLL {
-    struct node *head;
-    struct node *tail;
+struct Daemon {
+    struct State **states;
+    uint32_t state_count;
+    struct ApplyQueue *applies;
+    struct Cluster *cluster;
+    uint64_t in_flight;
+    struct Stats *stats;
 };
 
-/**
- * Initializes SLL
- * @param list - *SLL: address of list that needs initialization
- * @return -
- */
-void init_SLL(struct State *state) {
-    state->list = (struct SLL *) malloc(sizeof (struct SLL));
-    state->list->head = NULL;
-    state->list->tail = NULL;
-    state->start_address = NULL;
-    state->end_address = NULL;
-    state->next_free_address = NULL;
+uint64_t monotonic_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec;
 }
 
 /**
- * Creates a node that wraps in_addr* data given as input
- * @param data - *in_addr: data that needs to be wrapped inside a node
- * @return *node which contains data given as @param
+ * Schedules the expiry of a lease, the deadline is kept as wall clock time so it survives a restart
+ * @param state
+ * @param peer
+ * @param expires - uint32_t: when the lease expires, in seconds since the epoch, 0 if it never does
  */
-struct node* create_node(struct in_addr* data) {
-    struct node *new_node;
+void schedule_lease(struct State *state, struct Peer *peer, uint32_t expires) {
+    uint32_t now = (uint32_t) time(NULL);
 
-    new_node = (struct node*) malloc(sizeof (struct node));
+    peer->expires = expires;
+    if (expires == 0) {
+        timer_wheel_cancel(state->expiry, &peer->expiry);
+        return;
+    }
+    timer_wheel_schedule(state->expiry, &peer->expiry, monotonic_seconds() + (expires > now ? expires - now : 0));
+}
 
-    new_node->data = data;
-    new_node->next = NULL;
+/**
+ * Gives the expiry of a lease that starts now
+ * @param lease_time - uint32_t: seconds the lease is valid for, 0 if it never expires
+ * @return seconds since the epoch, 0 if the lease never expires
+ */
+uint32_t lease_expires(uint32_t lease_time) {
+    return lease_time == 0 ? 0 : (uint32_t) time(NULL) + lease_time;
+}
 
-    return new_node;
+void error(char *message) {
+    perror(message);
+    exit(0);
 }
 
 /**
- * Creates a node with input data and adds it to the end of the SLL
- * @param list - *SLL: list to which we add
- * @param data - in_addr*: data that needs to be added to the SLL
+ * Used to send address to client, the address and the mask are queued and sent by the next flush of the socket
+ * @param udp - *UdpSocket: socket used
+ * @param from - sockaddr_in: we get data from here
+ * @param from_length - socklen_t: length of
+ * @param source - in_addr: local address the request was sent to, the reply leaves from it
+ * @param address - *in6_addr: IPv4-mapped address given to the client
+ * @param prefix_length - int: mask of the network of the interface
  * @return -
  */
-void add_at_tail(struct SLL *list, struct in_addr *data) {
-    struct node* new_node = create_node(data);
+void send_address_and_mask(struct UdpSocket *udp, struct sockaddr_in *from, socklen_t from_length, struct in_addr source,
+                           struct in6_addr *address, int prefix_length) {
+    in_addr_t ipv4 = address_to_ipv4(address);
 
-    if (list->head == NULL) {
-        list->head = new_node;
-        list->tail = new_node;
-    } else {
-        list->tail->next = new_node;
-        list->tail = list->tail->next;
-    }
+    udp_queue_reply(udp, from, from_length, source, &ipv4, sizeof (in_addr_t));
+    udp_queue_reply(udp, from, from_length, source, &prefix_length, sizeof (int));
 }
 
 /**
- * Creates a node with input data and adds it to the beggining of the SLL
- * @param list - *SLL: list to which we add
- * @param data - in_addr*: data that needs to be added to the SLL
- * @return -
+ * Queues the reply of a request: legacy clients get their address and mask as two datagrams, version 2 clients get
+ * one datagram with the outcome of the request
+ * @param udp
+ * @param request
+ * @param prefix_length - int: mask of the network of the interface that served the request
  */
-void add_at_head(struct SLL *list, struct in_addr *data) {
-    struct node* new_node = create_node(data);
-
-    if (list->head == NULL) {
-        list->head = new_node;
-        list->tail = new_node;
-    } else {
-        new_node->next = list->head;
-        list->head = new_node;
+void answer_request(struct UdpSocket *udp, struct BatchRequest *request, int prefix_length) {
+    char reply[UDP_REPLY_MAX_LENGTH];
+    size_t length;
+
+    event_log(EVENT_LOG_DEBUG, EVENT_REPLY_QUEUED, (uint32_t) request->status, (uint32_t) prefix_length,
+              request->request.request_id, &request->address, NULL);
+    if (request->request.version == PROTOCOL_LEGACY_VERSION) {
+        send_address_and_mask(udp, &request->from, request->from_length, request->destination, &request->address,
+                              prefix_length);
+        return;
     }
+
+    length = protocol_encode_reply(&request->request, request->status, &request->address, prefix_length,
+                                   request->lease_time, reply, sizeof (reply));
+    udp_queue_reply(udp, &request->from, request->from_length, request->destination, reply, length);
 }
 
 /**
- * Finds wether element is in SLL or not
- * @param list - *SLL: list where the search takes place
- * @param element - *in_addr: searched value
- * @return - True, if element was found
- *          - False, otherwise
+ * Configures WireGuard interface for the DHCP scenario. It clones the configuration of the default WireGuard interface,
+ * as parsed at startup, without AutoConfigurable and with SaveConfig turned off.
+ * The cloned configuration is also kept in memory, so the config file can be rewritten without reading it back.
+ * Peers restored from the lease database are written after it.
+ * @param state
  */
-bool find_element(struct SLL *list, struct in_addr *element) {
-    if (list->head == NULL)
-        return false;
+void configure_dummy_interface(struct State *state) {
+    FILE *config_base;
 
-    struct node *current = list->head;
+    config_base = open_memstream(&state->config_base, &state->config_base_length);
+    if (config_base == NULL)
+        error("open_memstream() - configure_dummy_interface");
 
-    while (current != NULL) {
-        if (current->data->s_addr == element->s_addr)
-            return true;
+    for (size_t i = 0; i < state->wg_config.line_count; i++) {
+        const struct WgConfigLine *line = &state->wg_config.lines[i];
 
-        current = current->next;
+        if (line->kind == WG_CONFIG_KEY_AUTO_CONFIGURABLE)
+            continue;
+        if (line->kind == WG_CONFIG_KEY_SAVE_CONFIG)
+            fputs("SaveConfig = false\n", config_base);
+        else if (line->value != NULL)
+            fprintf(config_base, "%s = %s\n", line->key, line->value);
+        else
+            fprintf(config_base, "%s\n", line->key);
     }
+    fclose(config_base);
 
-    return false;
+    if (!config_writer_write(state->config, state->config_base, state->config_base_length, state->peers))
+        error("config_writer_write() - configure_dummy_interface - dummy config file");
 }
 
 /**
- * Deletes last element of the SLL
- * @param list - *SLL: list from which we need to delete, also deallocates the memory occupied by the node
- * @return -
+ * Runs wg-quick on a config file, wg-quick names the interface after the file. Nothing is run in stub mode.
+ * @param command - *char: START_INTERFACE_COMMAND or STOP_INTERFACE_COMMAND
+ * @param config_file - *char: config file of the interface
  */
-in_addr_t delete_from_tail(struct SLL *list) {
-    struct node *aux;
-    in_addr_t data = -1;
+void run_wg_quick(const char *command, const char *config_file) {
+    char line[PATH_MAX + 32];
 
-    if (list->tail != NULL) {
-        aux = list->head;
-        while (aux->next != list->tail)
-            aux = aux->next;
+    if (STUB_MODE)
+        return;
 
-        data = list->tail->data->s_addr;
+    snprintf(line, sizeof (line), "%s%s", command, config_file);
+    system(line);
+}
 
-        free(list->tail->data);
-        free(list->tail);
+/**
+ * Starts the dummy interface of a state, its config file is written first
+ * @param state
+ */
+void start_interface(struct State *state) {
+    configure_dummy_interface(state);
+    run_wg_quick(START_INTERFACE_COMMAND, state->dummy_config_file);
+}
 
-        list->tail = aux;
-        list->tail->next = NULL;
-    }
-    return data;
+void stop_interface(struct State *state) {
+    run_wg_quick(STOP_INTERFACE_COMMAND, state->dummy_config_file);
 }
 
 /**
- * Deletes first element of the SLL
- * @param list - *SLL: list from which we need to delete, also deallocates the memory occupied by the node
- * @return -
+ * Shuts the serving of an interface down, the workers and the apply thread are already stopped
+ * @param state
  */
-in_addr_t delete_from_head(struct SLL *list) {
-    in_addr_t data = -1;
-
-    if (list->head != NULL) {
-        struct node *to_delete = list->head;
-        data = list->head->data->s_addr;
-        list->head = list->head->next;
+void shutdown_server(struct State *state) {
+    printf("Addresses of %s in use at shutdown: %llu\n", state->interface_name,
+           (unsigned long long) address_pool_used(state->pool));
+    address_pool_destroy(state->pool);
+    free(state->pool);
+    peer_table_destroy(state->peers);
+    free(state->peers);
+    free(state->config_base);
+    dataplane_destroy(state->dataplane);
+    free(state->dataplane);
+    lease_db_close(state->leases);
+    free(state->leases);
+    free(state->expiry);
+    config_writer_destroy(state->config);
+    free(state->config);
+    route_manager_destroy(state->routes);
+    free(state->routes);
+    free(state->stats);
+    pthread_mutex_destroy(&state->lock);
+    wg_config_destroy(&state->wg_config);
+    stop_interface(state);
+    free(state);
+}
 
-        free(to_delete->data);
-        free(to_delete);
+/**
+ * Names the dummy interface and the files of an interface given with -i. The dummy interface of WG_INTERFACE_NAME keeps
+ * WG_DUMMY_INTERFACE_NAME, the others are named after their interface with DUMMY_INTERFACE_SUFFIX; every file lives in
+ * the config directory and is named after its interface.
+ * @param state
+ * @param option - *char: "<interface>" or "<interface>@<IPv4 listen address>"
+ */
+void configure_interface(struct State *state, const char *option) {
+    const char *separator = strchr(option, '@');
+    size_t name_length = separator == NULL ? strlen(option) : (size_t) (separator - option);
+
+    state->listen_address.s_addr = htonl(INADDR_ANY);
+    if (name_length == 0 || name_length >= IF_NAMESIZE ||
+        (separator != NULL && inet_pton(AF_INET, separator + 1, &state->listen_address) != 1)) {
+        fprintf(stderr, "configure_interface - invalid interface %s\n", option);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(state->interface_name, option, name_length);
+    state->interface_name[name_length] = '\0';
+
+    if (strcmp(state->interface_name, WG_INTERFACE_NAME) == 0)
+        strcpy(state->dummy_interface_name, WG_DUMMY_INTERFACE_NAME);
+    else if (snprintf(state->dummy_interface_name, IF_NAMESIZE, "%s%s", state->interface_name,
+                      DUMMY_INTERFACE_SUFFIX) >= IF_NAMESIZE) {
+        fprintf(stderr, "configure_interface - name of %s is too long for its dummy interface\n", option);
+        exit(EXIT_FAILURE);
     }
 
-    return data;
+    if (snprintf(state->config_file, PATH_MAX, "%s/%s%s", CONFIG_DIRECTORY, state->interface_name,
+                 CONFIG_FILE_EXTENSION) >= PATH_MAX ||
+        snprintf(state->dummy_config_file, PATH_MAX, "%s/%s%s", CONFIG_DIRECTORY, state->dummy_interface_name,
+                 CONFIG_FILE_EXTENSION) >= PATH_MAX ||
+        snprintf(state->lease_db_file, PATH_MAX, "%s/%s%s", CONFIG_DIRECTORY, state->dummy_interface_name,
+                 LEASE_DB_FILE_EXTENSION) >= PATH_MAX) {
+        fprintf(stderr, "configure_interface - directory name is too long\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
- * Deletes element if exists
- * @param list
- * @param element to be deleted
- * @return value of element, if found
- *         -1, otherwise
+ * Reads and parses the config file of an interface once, every component uses the result
+ * @param state
  */
-in_addr_t delete_element(struct SLL *list, struct in_addr *element) {
-    in_addr_t found = -1;
-    if (list->head == NULL)
-        return found;
-
-    if (list->head == list->tail) {
-        if (list->head->data->s_addr == element->s_addr) {
-            free(list->head);
-            free(list->tail);
-            list->head = NULL;
-            list->tail = NULL;
-
-            found = element->s_addr;
-        }
-    } else if (list->head->data->s_addr == element->s_addr) {
-        return delete_from_head(list);
-    } else if (list->tail->data->s_addr == element->s_addr) {
-        return delete_from_tail(list);
-    } else if (find_element(list, element)) {
-        struct node *current = list->head->next;
-        struct node *to_delete;
-
-        if (current->data->s_addr == element->s_addr) {
-            list->head->next = current->next;
-            found = current->data->s_addr;
-            free(current);
-
-            goto end;
-        }
-        while (current->next->data->s_addr != element->s_addr)
-            current = current->next;
-
-        to_delete = current->next;
-        current->next = to_delete->next;
-        found = to_delete->data->s_addr;
+void load_config(struct State *state) {
+    struct timespec started, finished;
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    if (!wg_config_load(&state->wg_config, state->config_file))
+        error("wg_config_load() - load_config - config file of the interface");
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    printf("Parsed %zu lines and %zu peers of %s in %.3f ms\n", state->wg_config.line_count,
+           state->wg_config.peer_count, state->config_file,
+           (double) (finished.tv_sec - started.tv_sec) * 1e3 + (double) (finished.tv_nsec - started.tv_nsec) / 1e6);
+}
 
-        free(to_delete);
-    }
-    end:
-    return found;
+/**
+ * Checks if WireGuard will use or not the DHCP server
+ * @param state
+ * @return True, if autoconfigurable option is true
+ *         False, otherwise
+ */
+bool is_auto_configurable(const struct State *state) {
+    return state->wg_config.auto_configurable;
 }
 
 /**
- * Returns random number in range (lower, upper)
- * @param lower bound
- * @param upper bound
- * @return random number inside (lower, upper)
+ * Allocates memory for the state of an interface, the apply queue is set by the caller
+ * @param state
  */
-in_addr_t get_random_in_range(in_addr_t lower, in_addr_t upper) {
-    srand(time(0));
-    return (rand() % (upper - lower  + 1)) + lower;
+void initialize_state(struct State *state) {
+    pthread_mutex_init(&state->lock, NULL);
+    state->pool = (struct AddressPool*) malloc(sizeof (struct AddressPool));
+    state->peers = (struct PeerTable*) malloc(sizeof (struct PeerTable));
+    state->config_base = NULL;
+    state->config_base_length = 0;
+    state->dataplane = (struct Dataplane*) malloc(sizeof (struct Dataplane));
+    state->leases = (struct LeaseDb*) malloc(sizeof (struct LeaseDb));
+    state->expiry = (struct TimerWheel*) malloc(sizeof (struct TimerWheel));
+    timer_wheel_init(state->expiry, monotonic_seconds());
+    state->config = (struct ConfigWriter*) malloc(sizeof (struct ConfigWriter));
+    state->routes = (struct RouteManager*) malloc(sizeof (struct RouteManager));
+    state->stats = (struct Stats*) malloc(sizeof (struct Stats));
+    stats_init(state->stats);
+    state->config_rewrite = false;
+    state->config_first_new = NULL;
+
+    if (!peer_table_init(state->peers, PEER_TABLE_BUCKETS))
+        error("peer_table_init() - initialize_state");
+    if (!config_writer_init(state->config, state->dummy_config_file))
+        error("config_writer_init() - initialize_state");
 }
 
 /**
- * Changes first_free_address param of list to another one that was not used
- * @param list
- * @return -
+ * Builds the address pool of the network the interface address belongs to. The network address, the broadcast address
+ * and the address of the interface itself are never given to clients. IPv6 networks of /48 up to /128 are supported.
+ * The pool gets one shard per worker. In a cluster, every node has to split the pool the same way whatever its number
+ * of workers: the pool gets CLUSTER_SHARDS_PER_NODE shards per node, which are the partitions of the cluster.
+ * @param state
+ * @param interface_address - *in6_addr: address of the WireGuard interface, IPv4-mapped for IPv4
  */
-void change_free_address(struct State *state) {
-    struct in_addr *first_free = (struct in_addr*) malloc(sizeof (struct in_addr));
-    first_free->s_addr = get_random_in_range(state->start_address->s_addr,state->end_address->s_addr);
+void build_address_pool(struct State *state, const struct in6_addr *interface_address) {
+    uint32_t shards = state->cluster == NULL ? (uint32_t) WORKERS : CLUSTER_SHARDS_PER_NODE * state->cluster->node_count;
 
-    while (find_element(state->list, first_free))
-        first_free->s_addr = get_random_in_range(state->start_address->s_addr, state->end_address->s_addr);
+    initialize_state(state);
 
-    state->next_free_address = first_free;
+    if (!address_pool_init(state->pool, interface_address, state->prefix_length, shards))
+        error("address_pool_init() - build_address_pool - mask of the interface address is out of the supported range");
 }
 
 /**
- * Prints all elements of SLL
- * @param list - *SLL: list that needs to be printed
- * @return -
+ * Rebuilds the address pool and the peer table from the lease database. Records that expired, whose address is outside
+ * the pool, already in use or held by a public key restored before are dropped, so are records whose fields could not
+ * be written to a config file, see peer_table_valid_fields().
+ * @param state
  */
-void print_list(struct SLL *list) {
-    if (list->head != NULL) {
-        struct node *aux;
+void restore_leases(struct State *state) {
+    struct LeaseDb *leases = state->leases;
+    struct timespec started, finished;
 
-        aux = list->head;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    if (!lease_db_open(leases, state->lease_db_file, &state->pool->network, (uint32_t) state->prefix_length))
+        error("lease_db_open() - restore_leases");
 
-        while (aux != NULL) {
-            printf("| %d |", aux->data->s_addr);
-            aux = aux->next;
+    for (uint32_t slot = 0; slot < leases->header->capacity; slot++) {
+        struct LeaseRecord *record = &leases->records[slot];
+        struct Peer *peer;
 
-            if (aux != NULL)
-                printf(" -----> ");
+        if (!lease_db_is_valid(leases, slot))
+            continue;
+        if ((record->expires != 0 && record->expires <= (uint32_t) time(NULL)) ||
+            peer_table_find_by_key(state->peers, record->public_key) != NULL ||
+            !peer_table_valid_fields(record->public_key, record->allowed_ips, record->endpoint, record->port) ||
+            !address_pool_reserve(state->pool, &record->address)) {
+            lease_db_erase(leases, slot);
+            continue;
         }
+
+        peer = peer_table_add(state->peers, record->public_key, record->allowed_ips, record->endpoint, record->port,
+                              &record->address);
+        if (peer == NULL)
+            error("peer_table_add() - restore_leases");
+        peer->record = slot;
+        schedule_lease(state, peer, record->expires);
     }
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    printf("Restored %u leases of %s in %.3f ms\n", state->peers->count, state->interface_name,
+           (double) (finished.tv_sec - started.tv_sec) * 1e3 + (double) (finished.tv_nsec - started.tv_nsec) / 1e6);
 }
 
 /**
- * Deletes all elements of the list and deallocates memory of list
- * @param list - *SLL: list that needs to be deleted
- * @return -
+ * Adds the host routes of every peer in the peer table, the routes are sent in as few netlink messages as possible
+ * @param state
  */
-void empty_list(struct SLL *list) {
-    while (list->head != NULL && list->tail != NULL)
-        delete_from_head(list);
+void restore_routes(struct State *state) {
+    struct RouteChange *changes;
+    size_t count = 0;
 
-    free(list);
-}
+    if (state->peers->count == 0)
+        return;
 
-void error(char *message) {
-    perror(message);
-    exit(0);
+    changes = (struct RouteChange *) malloc(state->peers->count * sizeof (struct RouteChange));
+    if (changes == NULL)
+        error("malloc() - restore_routes");
+
+    for (struct Peer *peer = state->peers->head; peer != NULL; peer = peer->next) {
+        changes[count].address = peer->address;
+        changes[count++].remove = false;
+    }
+    if (!route_manager_apply(state->routes, changes, count))
+        printf("Some of %zu restored routes could not be added\n", count);
+    free(changes);
 }
 
 /**
- * Used to send address to client
- * @param sock - int: socket used
- * @param from - sockaddr_in: we get data from here
- * @param from_length - int: length of
- * @return -
+ * Configures initial state of the DHCP server: builds the address pool from the address of the interface.
+ * @param state
  */
-void send_address_and_mask(int sock, struct sockaddr_in *from, int from_length, struct State *state) {
-    char *readable_address = inet_ntoa(*state->next_free_address);
+void configure_state(struct State *state) {
+    char aux[INET6_ADDRSTRLEN];
+    struct in6_addr last_address;
 
-    printf("Sending address...\n");
+    if (!state->wg_config.has_address)
+        error("configure_state - "
+              "config file should contain the address of the interface together with the mask to determine allowed peers");
 
-    if(sendto(sock, &state->next_free_address->s_addr, sizeof (in_addr_t), 0, (const struct sockaddr *) from, from_length) < 0 )
-        error("sendto() - send_address_and_mask -> send of address failed");
-    else
-        printf("\tSent: address: %s\n-----------------\n",  readable_address);
+    state->prefix_length = state->wg_config.prefix_length;
+    printf("interface: %s\naddr: %s\nmask: %d\n", state->interface_name,
+           address_format(&state->wg_config.address, aux, sizeof (aux)), state->prefix_length);
 
-    if(sendto(sock, &NET_MASK, sizeof (int ), 0, (const struct sockaddr *) from, from_length) < 0 )
-        error("sendto() - send_address_and_mask -> send of mask failed");
-    else
-        printf("\tSent: mask: %d\n-----------------\n", NET_MASK);
+    build_address_pool(state, &state->wg_config.address);
 
-    add_at_tail(state->list, state->next_free_address);
-    change_free_address(state);
+    printf("pool: %s", address_format(&state->pool->network, aux, sizeof (aux)));
+    address_pool_last(state->pool, &last_address);
+    printf(" - %s (%llu addresses, %s allocator, %u shards)\n", address_format(&last_address, aux, sizeof (aux)),
+           (unsigned long long) address_pool_size(state->pool), state->pool->is_sparse ? "sparse" : "bitmap",
+           state->pool->shard_count);
 }
 
 /**
- * Used to send address to client
- * @param sock - int: socket used
- * @param from - sockaddr_in: we get data from here
- * @param from_length - int: length of
- * @return -
+ * Server structure, one worker: everything its event loop needs to serve clients. Every worker has its own socket bound
+ * to DHCP_PORT, the kernel spreads the clients between them; every worker serves every interface.
+ *  - daemon - *Daemon: interfaces served, shared by the workers
+ *  - index - uint32_t: number of the worker, also the shard of the pools it allocates from
+ *  - thread - pthread_t: thread that runs the loop, worker 0 runs on the main thread
+ *  - stats - Stats: counters and latency histograms of the worker, read by the stats socket
+ *  - admission - Admission: token buckets of the sources heard by the worker
+ *  - responses - ResponseCache: replies recently sent by the worker, retransmitted requests are answered from it
+ *  - batch - Batch: requests waiting for the next commit
+ *  - commits - uint64_t: number of batches committed by the worker
+ *  - pool_commits - *uint64_t: one per interface, value of commits when the interface was last committed
+ *  - udp - UdpSocket: socket on which clients are served
+ *  - loop - EventLoop: waits for datagrams, the batch timer and the shutdown event
+ *  - batch_timer - int: timer that closes the batch window
+ *  - batch_timer_armed - bool: True, while the batch window is open
+ *  - expiry_timer - int: periodic timer that advances the expiry wheel, worker 0 only, -1 otherwise
+ *  - socket_handler, batch_timer_handler, expiry_timer_handler, shutdown_handler - EventHandler: handlers registered in the loop
+ *  - signal_handler, link_handler - EventHandler: termination signals and link events, worker 0 only
  */
-void return_address(struct State *state, in_addr_t address_data) {
-
-    struct in_addr *returned_address = (struct in_addr*) malloc(sizeof (struct in_addr));
-    char command[256] = "route del ", address[256];
+struct Server {
+    struct Daemon *daemon;
+    uint32_t index;
+    pthread_t thread;
+    struct Stats stats;
+    struct Admission admission;
+    struct ResponseCache responses;
+    struct Batch batch;
+    uint64_t commits;
+    uint64_t *pool_commits;
+    struct UdpSocket udp;
+    struct EventLoop loop;
+    int batch_timer;
+    bool batch_timer_armed;
+    int expiry_timer;
+    struct EventHandler socket_handler;
+    struct EventHandler batch_timer_handler;
+    struct EventHandler expiry_timer_handler;
+    struct EventHandler shutdown_handler;
+    struct EventHandler signal_handler;
+    struct EventHandler link_handler;
+};
 
-    returned_address->s_addr = address_data;
+/**
+ * Drops, before they are decoded, the requests of sources that exceed ADMISSION_RATE and the requests that would take
+ * the requests in flight of every worker over MAX_IN_FLIGHT. The admitted requests are moved to the front of the
+ * requests just received.
+ * @param server
+ * @param first - size_t: first request received by the last call to udp_receive()
+ */
+void admit_requests(struct Server *server, size_t first) {
+    struct Batch *batch = &server->batch;
+    uint64_t now = stats_now();
+    size_t kept = first;
 
-    if (delete_element(state->list, returned_address) < 0)
-        error("delete_element() - address not found");
+    for (size_t i = first; i < batch->count; i++) {
+        struct BatchRequest *request = &batch->requests[i];
+        uint64_t in_flight;
 
-    inet_ntop(AF_INET, returned_address, address, 255);
-    strcat(command, address);
-    system(command);
+        if (!admission_allow(&server->admission, request->from.sin_addr.s_addr, now)) {
+            stats_add(&server->stats, STATS_DROPPED_RATE_LIMITED, 1);
+            continue;
+        }
+        in_flight = __atomic_add_fetch(&server->daemon->in_flight, 1, __ATOMIC_RELAXED);
+        if (MAX_IN_FLIGHT > 0 && in_flight > (uint64_t) MAX_IN_FLIGHT) {
+            __atomic_sub_fetch(&server->daemon->in_flight, 1, __ATOMIC_RELAXED);
+            stats_add(&server->stats, STATS_DROPPED_OVERLOADED, 1);
+            continue;
+        }
 
-    free(returned_address);
+        if (kept != i)
+            batch->requests[kept] = *request;
+        kept++;
+    }
+    batch->count = kept;
 }
 
 /**
- * Configures WireGuard interface for the DHCP scenario. It clones the configuration of the default WireGuard interface.
+ * Answers again, without applying them again, the version 2 requests already answered by the worker: clients retry
+ * when a reply is lost or late. The other requests are moved to the front of the requests just received.
+ * @param server
+ * @param first - size_t: first request received by the last call to udp_receive()
  */
-void configure_dummy_interface() {
-    char line[512], *word_list[64], delimit[] = " ", new_line[512];
-    FILE *config_file, *dummy_config_file;
-    int words_per_line;
+void answer_retransmits(struct Server *server, size_t first) {
+    struct Batch *batch = &server->batch;
+    uint64_t now = stats_now();
+    size_t kept = first, answered = 0;
 
-    system(REMOVE_OLD_DUMMY_CONFIG_FILE_COMMAND);
-    config_file = fopen(CONFIG_FILE, "r");
-    system(CREATE_DUMMY_FILE_COMMAND);
-    dummy_config_file = fopen(CONFIG_DUMMY_FILE, "w");
+    for (size_t i = first; i < batch->count; i++) {
+        struct BatchRequest *request = &batch->requests[i];
 
-    if (config_file == NULL)
-        error("fopen() - configure_state - CONFIG_FILE");
+        if (response_cache_find(&server->responses, request, now)) {
+            answer_request(&server->udp, request, server->daemon->states[request->pool]->prefix_length);
+            answered++;
+            continue;
+        }
+        if (kept != i)
+            batch->requests[kept] = *request;
+        kept++;
+    }
+    batch->count = kept;
 
-    while (fgets (line, 512, config_file)) {
-        words_per_line = 0;
-        word_list[words_per_line] = strtok(line, delimit);
-        while (word_list[words_per_line] != NULL)
-            word_list[++words_per_line] = strtok(NULL, delimit);
+    if (answered > 0) {
+        udp_flush(&server->udp);
+        __atomic_sub_fetch(&server->daemon->in_flight, answered, __ATOMIC_RELAXED);
+        stats_add(&server->stats, STATS_RETRANSMITS_ANSWERED, answered);
+    }
+}
 
-        if (strcmp(word_list[0], "SaveConfig") == 0 && strcmp(word_list[2], "true"))
-            strcpy(line, "SaveConfig = false\n");
-        if (strcmp(word_list[0], "AutoConfigurable") != 0) {
-            strcpy(new_line, "");
-            for (int i = 0; i < words_per_line - 1; i++) {
-                strcat(new_line, word_list[i]);
-                strcat(new_line, " ");
-            }
-            strcat(new_line, word_list[words_per_line - 1]);
-            fprintf(dummy_config_file, "%s", new_line);
+/**
+ * Finds the interface that serves a decoded request: the one of the pool ID the request carries, otherwise the one
+ * whose listen address the request was sent to, otherwise the first one
+ * @param daemon
+ * @param request - *BatchRequest: its pool is set
+ * @return True, if the interface is served
+ *         False, if the request carries the pool ID of no served interface
+ */
+bool route_request(struct Daemon *daemon, struct BatchRequest *request) {
+    request->pool = 0;
+    if (request->request.pool != PROTOCOL_NO_POOL) {
+        request->pool = request->request.pool;
+        return request->pool < daemon->state_count;
+    }
+
+    if (request->destination.s_addr == htonl(INADDR_ANY))
+        return true;
+    for (uint32_t i = 0; i < daemon->state_count; i++) {
+        if (daemon->states[i]->listen_address.s_addr == request->destination.s_addr) {
+            request->pool = i;
+            break;
         }
     }
-    fclose(config_file);
-    fclose(dummy_config_file);
+    return true;
 }
 
 /**
- * Starts specified interface, if the DHCP server will be used, it also configures the default interface if it the application just started.
- * @param interface_name
+ * Function used in order to receive messages from clients: every datagram waiting on the socket, up to the room left
+ * in the batch, is received with one system call. Requests that are not admitted are dropped before they are decoded,
+ * decoded requests are routed to their interface and retransmitted requests are answered.
+ * @param server
+ * @return number of messages received
+ *         -1, on failure
  */
-void start_interface(char *interface_name) {
-    if (strcmp(interface_name, WG_INTERFACE_NAME) == 0) {
-        system(START_INTERFACE_COMMAND);
-        return;
+int receive_client_configuration(struct Server *server) {
+    struct Stats *stats = &server->stats;
+    size_t first = server->batch.count;
+    uint64_t started = stats_now();
+    int received = udp_receive(&server->udp, &server->batch);
+
+    if (received < 0) {
+        perror("recvmmsg() - receive_client_configuration -> receival of new client configuration");
+        return -1;
     }
-    if (!DUMMY_INTERFACE_CONFIGURED) {
-        configure_dummy_interface();
-        DUMMY_INTERFACE_CONFIGURED = true;
+    started = stats_record_since(stats, STATS_STAGE_RECEIVE, started);
+    admit_requests(server, first);
+
+    for (size_t i = first; i < server->batch.count; i++) {
+        struct BatchRequest *request = &server->batch.requests[i];
+        struct Request *received_configuration = &request->request;
+
+        request->pool = 0;
+        if (!protocol_decode(request->datagram, request->length, received_configuration)) {
+            event_log(EVENT_LOG_INFO, EVENT_REQUEST_INVALID, 0, 0, request->length, NULL, NULL);
+            stats_add(stats, STATS_REQUESTS_INVALID, 1);
+            continue;
+        }
+        if (!route_request(server->daemon, request)) {
+            event_log(EVENT_LOG_INFO, EVENT_POOL_NOT_SERVED, received_configuration->pool, 0, 0, NULL, NULL);
+            stats_add(stats, STATS_REQUESTS_INVALID, 1);
+            received_configuration->option = OPTION_INVALID;
+            request->pool = 0;
+            continue;
+        }
+
+        event_log(EVENT_LOG_DEBUG, EVENT_REQUEST_RECEIVED, (uint32_t) received_configuration->option,
+                  received_configuration->request_id, (uint64_t) received_configuration->version,
+                  &received_configuration->address, received_configuration->public_key);
     }
-    system(START_DUMMY_INTERFACE_COMMAND);
+    if (received > 0)
+        stats_record_since(stats, STATS_STAGE_DECODE, started);
+    answer_retransmits(server, first);
+
+    return received;
 }
 
-void stop_interface() {
-    system(STOP_INTERFACE_COMMAND);
+/**
+ * Rewrites the dummy config file from memory: the cloned configuration followed by every peer in the peer table.
+ * The file is replaced atomically, no process is forked.
+ * @param state
+ * @param stats - *Stats: stats of the thread that writes the file
+ */
+void write_config(struct State *state, struct Stats *stats) {
+    stats_add(stats, STATS_CONFIG_REWRITES, 1);
+    if (!config_writer_write(state->config, state->config_base, state->config_base_length, state->peers))
+        perror("config_writer_write() - write_config - config file unchanged");
 }
 
 /**
- * Shuts server down
- * @param sock
- * @param list
+ * Appends to the dummy config file the peers added since @param first_peer
+ * @param state
+ * @param stats - *Stats: stats of the thread that writes the file
+ * @param first_peer
  */
-void shutdown_server(int sock, struct State *state) {
-    print_list(state->list);
-    empty_list(state->list);
-    close(sock);
-    free(state);
-    stop_interface();
+void append_config(struct State *state, struct Stats *stats, struct Peer *first_peer) {
+    stats_add(stats, STATS_CONFIG_APPENDS, 1);
+    if (!config_writer_append(state->config, first_peer))
+        perror("config_writer_append() - append_config - couldn't append to config file");
 }
 
 /**
- * Checks if wireguard interface is down and if so, stops the application
+ * Takes a peer out of the peer table, its address stays reserved in the pool for the peer that replaces it. The data
+ * plane and route changes are applied at commit.
+ * @param state
+ * @param batch
+ * @param peer
+ * @param remove_from_interface - bool: False, if the peer is replaced by a peer with the same public key
  */
-void *check_for_shutdown() {
-    struct ifaddrs *ifaddr;
-    bool found;
+void unlink_peer(struct State *state, struct Batch *batch, struct Peer *peer, bool remove_from_interface) {
+    lease_db_erase(state->leases, peer->record);
+    timer_wheel_cancel(state->expiry, &peer->expiry);
+    if (remove_from_interface)
+        batch_add_change(batch, peer, true);
+    batch_add_route(batch, &peer->address, true);
+
+    peer_table_detach(state->peers, peer);
+    batch_detach(batch, peer);
+    batch->rewrite_config = true;
+}
 
+/**
+ * Takes a peer out of the peer table, its address goes back to the pool. The data plane and route changes are applied
+ * at commit.
+ * @param state
+ * @param batch
+ * @param peer
+ * @param remove_from_interface - bool: False, if the peer is replaced by a peer with the same public key
+ */
+void detach_peer(struct State *state, struct Batch *batch, struct Peer *peer, bool remove_from_interface) {
+    address_pool_release(state->pool, &peer->address);
+    unlink_peer(state, batch, peer, remove_from_interface);
+}
 
-    LOOP:
-    sleep(120);
+/**
+ * Gives the shard of a pool a worker allocates from: shards are interleaved between the nodes of the cluster, a worker
+ * allocates from one of the shards its node owns
+ * @param state
+ * @param worker - uint32_t: index of the worker
+ * @return index of the shard
+ */
+uint32_t home_shard(const struct State *state, uint32_t worker) {
+    if (state->cluster == NULL)
+        return worker;
+    return worker % CLUSTER_SHARDS_PER_NODE * state->cluster->node_count + state->cluster->node;
+}
 
-    found = false;
-    if (getifaddrs(&ifaddr) == -1)
-        error("getifaddrs() - check_for_shutdown()");
+/**
+ * Records a lease changed by a client or the control socket, it is replicated to the other nodes when the batch is
+ * committed
+ * @param state
+ * @param batch
+ * @param peer
+ * @param remove - bool: True, if the lease was given back
+ */
+void replicate_lease(struct State *state, struct Batch *batch, const struct Peer *peer, bool remove) {
+    if (state->cluster != NULL)
+        batch_add_replica(batch, peer, remove);
+}
 
-    for (struct ifaddrs *current = ifaddr; current != NULL && found == false; current = current->ifa_next) {
-        if (current->ifa_addr == NULL)
+/**
+ * Gives an address to every join of the batch before the shared states are locked, from the pool of the interface of
+ * the join. Every worker allocates from its own shard of the pools, so workers do not wait for each other here.
+ * @param server
+ */
+void allocate_addresses(struct Server *server) {
+    for (size_t i = 0; i < server->batch.count; i++) {
+        struct BatchRequest *request = &server->batch.requests[i];
+        struct State *state;
+        struct AddressPool *pool;
+        uint64_t started;
+        bool allocated;
+
+        if (request->request.option != OPTION_JOIN)
             continue;
+        state = server->daemon->states[request->pool];
+        pool = state->pool;
+        if (request->request.version == PROTOCOL_LEGACY_VERSION && pool->ipv6) {
+            event_log(EVENT_LOG_INFO, EVENT_LEGACY_IPV6, 0, 0, 0, NULL, NULL);
+            request->status = REPLY_POOL_EXHAUSTED;
+            continue;
+        }
 
-        if (strcmp(current->ifa_name, WG_DUMMY_INTERFACE_NAME) == 0)
-            found = true;
+        started = stats_now();
+        allocated = address_pool_allocate(pool, home_shard(state, server->index), &request->address);
+        stats_record_since(&server->stats, STATS_STAGE_ALLOCATE, started);
+        if (!allocated) {
+            event_log(EVENT_LOG_INFO, EVENT_POOL_EXHAUSTED, 0, 0, 0, NULL, NULL);
+            stats_add(&server->stats, STATS_POOL_EXHAUSTED, 1);
+            request->status = REPLY_POOL_EXHAUSTED;
+        }
     }
+}
 
-    freeifaddrs(ifaddr);
+/**
+ * Extends the lease of a peer that joins again without any change, nothing is written to the config file or the interface
+ * @param state
+ * @param peer
+ * @param request
+ */
+void keep_lease(struct State *state, struct Peer *peer, struct BatchRequest *request) {
+    request->lease_time = request->request.version == PROTOCOL_LEGACY_VERSION ? 0 : LEASE_TIME;
+    schedule_lease(state, peer, lease_expires(request->lease_time));
+    lease_db_renew(state->leases, peer->record, peer->expires);
+}
 
-    if (found == false) {
-        SHUTDOWN = true;
-        return NULL;
+/**
+ * @return True, if the peer already has these allowed IPs, endpoint and port
+ */
+bool same_settings(const struct Peer *peer, const char *allowed_ips, const char *endpoint, const char *port) {
+    return strcmp(peer->allowed_ips, allowed_ips) == 0 && strcmp(peer->endpoint, endpoint) == 0 &&
+           strcmp(peer->port, port) == 0;
+}
+
+/**
+ * Adds a peer with an address already taken from the pool to the peer table, the expiry wheel and the lease database.
+ * It reaches the config file, the interface and the routes when the batch is committed.
+ * @param state
+ * @param batch
+ * @param public_key, allowed_ips, endpoint, port - *char: fields of the peer
+ * @param address - *in6_addr: leased address
+ * @param expires - uint32_t: when the lease expires, in seconds since the epoch, 0 if it never does
+ * @return *Peer, the new peer
+ */
+struct Peer *insert_peer(struct State *state, struct Batch *batch, const char *public_key, const char *allowed_ips,
+                         const char *endpoint, const char *port, const struct in6_addr *address, uint32_t expires) {
+    struct Peer *peer = peer_table_add(state->peers, public_key, allowed_ips, endpoint, port, address);
+
+    if (peer == NULL)
+        error("peer_table_add() - insert_peer");
+    schedule_lease(state, peer, expires);
+    peer->record = lease_db_store(state->leases, peer, peer->expires);
+    if (peer->record == PEER_NO_RECORD)
+        event_log(EVENT_LOG_WARNING, EVENT_LEASE_NOT_STORED, 0, 0, 0, NULL, peer->public_key);
+    if (batch->first_new == NULL)
+        batch->first_new = peer;
+    batch_add_change(batch, peer, false);
+    batch_add_route(batch, &peer->address, false);
+    return peer;
+}
+
+/**
+ * Adds new peer by information received in message from client, with the address given by allocate_addresses. The peer
+ * reaches the config file and the interface when the batch is committed. A client that joins again with the same public
+ * key gets its current address back: the address given by allocate_addresses returns to the pool, and the previous peer
+ * is only replaced when its allowed IPs or endpoint changed.
+ * Leases of version 2 clients expire after LEASE_TIME unless renewed; legacy clients cannot renew, their leases never expire.
+ * @param state
+ * @param batch
+ * @param request
+ */
+void add_new_peer(struct State *state, struct Batch *batch, struct BatchRequest *request) {
+    struct Request *new_client = &request->request;
+    struct Peer *peer = peer_table_find_by_key(state->peers, new_client->public_key);
+
+    if (peer != NULL && !(new_client->version == PROTOCOL_LEGACY_VERSION && state->pool->ipv6)) {
+        if (request->status == REPLY_OK)
+            address_pool_release(state->pool, &request->address);
+        request->address = peer->address;
+        request->status = REPLY_OK;
+
+        if (same_settings(peer, new_client->allowed_ips, new_client->endpoint, new_client->port)) {
+            keep_lease(state, peer, request);
+            replicate_lease(state, batch, peer, false);
+            return;
+        }
+        unlink_peer(state, batch, peer, false);
+    } else if (request->status != REPLY_OK) {
+        return;
     }
-    goto LOOP;
+
+    request->lease_time = new_client->version == PROTOCOL_LEGACY_VERSION ? 0 : LEASE_TIME;
+    peer = insert_peer(state, batch, new_client->public_key, new_client->allowed_ips, new_client->endpoint,
+                       new_client->port, &request->address, lease_expires(request->lease_time));
+    replicate_lease(state, batch, peer, false);
+
+    event_log(EVENT_LOG_DEBUG, EVENT_ADDRESS_LEASED, 0, 0, request->lease_time, &request->address,
+              new_client->public_key);
+
+    request->status = REPLY_OK;
 }
 
 /**
- * Checks if WireGuard will use or not the DHCP server
- * @return True, if autoconfigurable option is true
+ * Removes peer that holds the address returned by the client. Version 2 clients have to send the public key of that
+ * peer; legacy clients send no key, those that are not found by address are looked up by endpoint.
+ * The address of the peer goes back to the pool through detach_peer() only, once the peer is found: the address of the
+ * request is never released by itself, a worker may have allocated it in the meantime.
+ * @param state
+ * @param batch
+ * @param peer_information
+ * @return True, if a peer was removed
  *         False, otherwise
  */
-bool is_auto_configurable() {
-    char line[512], *word_list[64], delimit[] = " ";
-    FILE *config_file;
-    int words_per_line;
-    config_file = fopen(CONFIG_FILE, "r");
+bool remove_peer(struct State *state, struct Batch *batch, struct Request *peer_information) {
+    struct Peer *peer = peer_table_find_by_address(state->peers, &peer_information->address);
+
+    if (peer_information->version == PROTOCOL_VERSION) {
+        if (peer != NULL && strcmp(peer->public_key, peer_information->public_key) != 0)
+            peer = NULL;
+    } else if (peer == NULL) {
+        peer = peer_table_find_by_endpoint(state->peers, peer_information->endpoint, peer_information->port);
+    }
+    if (peer == NULL) {
+        event_log(EVENT_LOG_INFO, EVENT_PEER_NOT_FOUND, 0, 0, 0, &peer_information->address, NULL);
+        return false;
+    }
 
-    if (config_file == NULL)
-        error("fopen() - is_auto_configurable - CONFIG_FILE");
+    replicate_lease(state, batch, peer, true);
+    detach_peer(state, batch, peer, true);
+    return true;
+}
 
-    while (fgets (line, 512, config_file)) {
-        words_per_line = 0;
-        word_list[words_per_line] = strtok(line, delimit);
-        while (word_list[words_per_line] != NULL)
-            word_list[++words_per_line] = strtok(NULL, delimit);
+/**
+ * Extends the lease of the peer that holds the address of the request, the public key has to match
+ * @param state
+ * @param batch
+ * @param request
+ */
+void renew_lease(struct State *state, struct Batch *batch, struct BatchRequest *request) {
+    struct Peer *peer = peer_table_find_by_address(state->peers, &request->request.address);
 
-        if (strcmp(word_list[0], "AutoConfigurable") == 0 && strcmp(word_list[2], "True\n") == 0) {
-            fclose(config_file);
-            return true;
-        }
+    if (peer == NULL || strcmp(peer->public_key, request->request.public_key) != 0) {
+        request->status = REPLY_NOT_LEASED;
+        return;
     }
-    fclose(config_file);
-    return false;
+
+    request->lease_time = LEASE_TIME;
+    schedule_lease(state, peer, lease_expires(LEASE_TIME));
+    lease_db_renew(state->leases, peer->record, peer->expires);
+    replicate_lease(state, batch, peer, false);
+    request->address = peer->address;
+    request->status = REPLY_OK;
 }
 
 /**
- * Allocates memory for the state of the state
+ * Copies into the stats of a shared state the values that other modules keep count of, the lock is held
  * @param state
  */
-void initialize_state(struct State *state) {
-    state->start_address = (struct in_addr*) malloc(sizeof (struct in_addr));
-    state->start_address->s_addr = (in_addr_t*) malloc(sizeof (in_addr_t));
-
-    state->end_address = (struct in_addr*) malloc(sizeof (struct in_addr));
-    state->end_address->s_addr = (in_addr_t*) malloc(sizeof (in_addr_t));
+void update_gauges(struct State *state) {
+    struct Stats *stats = state->stats;
+
+    stats_set(stats, STATS_POOL_SIZE, address_pool_size(state->pool));
+    stats_set(stats, STATS_POOL_USED, address_pool_used(state->pool));
+    stats_set(stats, STATS_ALLOCATION_RETRIES, address_pool_retries(state->pool));
+    stats_set(stats, STATS_ALLOCATION_STEALS, address_pool_steals(state->pool));
+    stats_set(stats, STATS_PEERS, state->peers->count);
+}
 
-    state->next_free_address = (struct in_addr*) malloc(sizeof (struct in_addr));
-    state->next_free_address->s_addr = (in_addr_t*) malloc(sizeof (in_addr_t));
+/**
+ * Copies into the stats of the daemon the values that every interface shares. Only stores are made, so any thread can
+ * update them.
+ * @param daemon
+ */
+void update_shared_gauges(struct Daemon *daemon) {
+    stats_set(daemon->stats, STATS_APPLY_STALLS, apply_queue_stalls(daemon->applies));
+    stats_set(daemon->stats, STATS_HEAP_ALLOCATIONS, heap_counter_allocations());
+    stats_set(daemon->stats, STATS_HEAP_FREES, heap_counter_frees());
+}
 
-    init_SLL(state);
+/**
+ * Closes the batch window and gives an address to every join, before the shared states are locked
+ * @param server
+ */
+void prepare_batch(struct Server *server) {
+    if (server->batch_timer_armed) {
+        timer_disarm(server->batch_timer);
+        server->batch_timer_armed = false;
+    }
+    allocate_addresses(server);
 }
 
 /**
- * Configures initial state of the DHCP server: loads from file the required data in order to build the address pool.
+ * Syncs the lease database once for a whole batch, replicates its leases to the other nodes of the cluster, then hands
+ * its config file, data plane and route changes to the apply thread in the slot reserved before the lock was taken. The
+ * lock of the shared state is held.
  * @param state
+ * @param batch
+ * @return sequence of the job handed to the apply thread, to wait for with apply_queue_wait()
+ *         0, if the batch changed nothing the apply thread has to apply
  */
-void configure_state(struct State *state) {
-    char line[512], *word_list[64], delimit[] = " ";
-    FILE *config_file;
-    int words_per_line;
-    config_file = fopen(CONFIG_FILE, "r");
+uint64_t commit_changes(struct State *state, struct Batch *batch) {
+    uint64_t stage = stats_now(), sequence = 0;
+
+    lease_db_sync(state->leases);
+    stage = stats_record_since(state->stats, STATS_STAGE_LEASE_SYNC, stage);
+
+    if (state->cluster != NULL)
+        cluster_publish(state->cluster, (uint16_t) state->index, batch->replicas, batch->replica_count);
+    state->config_rewrite |= batch->rewrite_config;
+    if (state->config_first_new == NULL)
+        state->config_first_new = batch->first_new;
+    if (batch->change_count > 0 || batch->route_count > 0 || batch->detached_count > 0) {
+        sequence = apply_queue_publish(state->applies, batch, state, stage);
+        if (sequence == 0)
+            error("apply_queue_publish() - commit_changes");
+    } else {
+        apply_queue_cancel(state->applies);
+    }
+    update_gauges(state);
+    return sequence;
+}
 
-    if (config_file == NULL)
-        error("fopen() - configure_state - CONFIG_FILE");
+/**
+ * Applies the requests of a batch for one interface to its shared state, then commits their changes. The lock of the
+ * shared state is held.
+ * @param server
+ * @param pool - uint32_t: interface whose requests are applied
+ */
+void apply_batch(struct Server *server, uint32_t pool) {
+    struct State *state = server->daemon->states[pool];
+    struct Batch *batch = &server->batch;
+    struct Stats *stats = state->stats;
+    uint64_t stage = stats_now();
 
-    while (fgets (line, 512, config_file)) {
-        words_per_line = 0;
-        word_list[words_per_line] = strtok(line, delimit);
-        while (word_list[words_per_line] != NULL)
-            word_list[++words_per_line] = strtok(NULL, delimit);
+    for (size_t i = 0; i < batch->count; i++) {
+        struct BatchRequest *request = &batch->requests[i];
 
-        if (strcmp(word_list[0], "Address") == 0) {
-            char *address, *mask;
-            address = strtok(word_list[2], "/");
-            mask = strtok(NULL, "/");
+        if (request->pool != pool)
+            continue;
+        switch (request->request.option) {
+            case OPTION_JOIN:
+                stats_add(stats, STATS_REQUESTS_JOIN, 1);
+                add_new_peer(state, batch, request);
+                break;
+            case OPTION_LEAVE:
+                stats_add(stats, STATS_REQUESTS_LEAVE, 1);
+                request->status = remove_peer(state, batch, &request->request) ? REPLY_OK : REPLY_NOT_LEASED;
+                break;
+            case OPTION_RENEW:
+                stats_add(stats, STATS_REQUESTS_RENEW, 1);
+                renew_lease(state, batch, request);
+                break;
+            default:
+                continue;
+        }
+        if (request->status == REPLY_NOT_LEASED)
+            stats_add(stats, STATS_NOT_LEASED, 1);
 
-            NET_MASK= atoi(mask);
-            struct sockaddr_in a1, a2;
-            inet_pton(AF_INET, address, &(a1.sin_addr));
+        request->answer = request->request.version != PROTOCOL_LEGACY_VERSION ||
+                          (request->request.option == OPTION_JOIN && request->status == REPLY_OK);
+    }
 
-            printf("-------  %d\n", a1.sin_addr.s_addr);
+    stats_record_since(stats, STATS_STAGE_APPLY, stage);
+    commit_changes(state, batch);
+}
+
+/**
+ * Applier structure, the thread that applies committed batches to the config files, the interfaces and the routes, so
+ * that workers answer clients without waiting for the interfaces. One thread serves every interface.
+ *  - daemon - *Daemon: its apply queue feeds the thread
+ *  - thread - pthread_t
+ *  - stats - Stats: counters and latency histograms of the apply stages, read by the stats socket
+ */
+struct Applier {
+    struct Daemon *daemon;
+    pthread_t thread;
+    struct Stats stats;
+};
 
-            a1.sin_addr.s_addr = a1.sin_addr.s_addr;
+/**
+ * Applies one job to the interface it was committed for. The config file is written from the peer table under the lock
+ * of the shared state, once for every job committed since it was last written; the data plane and the routes are
+ * applied without the lock, then the peers the job detached go back to the peer table. When the data plane fails, the
+ * interface is synced with the peer table under the lock.
+ * @param applier
+ * @param job
+ */
+void apply_job(struct Applier *applier, struct ApplyJob *job) {
+    struct State *state = (struct State *) job->context;
+    struct Stats *stats = &applier->stats;
+    uint64_t stage = stats_record_since(stats, STATS_STAGE_APPLY_QUEUE, job->published);
+
+    pthread_mutex_lock(&state->lock);
+    if (state->config_rewrite || state->config_first_new != NULL) {
+        if (state->config_rewrite)
+            write_config(state, stats);
+        else
+            append_config(state, stats, state->config_first_new);
+        state->config_rewrite = false;
+        state->config_first_new = NULL;
+        stage = stats_record_since(stats, STATS_STAGE_CONFIG, stage);
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    if (job->change_count > 0) {
+        stats_add(stats, STATS_REFRESHES, 1);
+        if (!dataplane_apply(state->dataplane, job->changes, job->change_count)) {
+            event_log(EVENT_LOG_WARNING, EVENT_DATAPLANE_FAILED, 0, 0, job->change_count, NULL, NULL);
+            stats_add(stats, STATS_REFRESH_FAILURES, 1);
+            /* the interface took only part of the job, it is brought back to the peer table */
+            pthread_mutex_lock(&state->lock);
+            if (!dataplane_sync(state->dataplane, state->peers))
+                stats_add(stats, STATS_REFRESH_FAILURES, 1);
+            pthread_mutex_unlock(&state->lock);
+        }
+        stage = stats_record_since(stats, STATS_STAGE_REFRESH, stage);
+    }
+    if (job->route_count > 0) {
+        if (!route_manager_apply(state->routes, job->routes, job->route_count))
+            event_log(EVENT_LOG_WARNING, EVENT_ROUTES_FAILED, 0, 0, job->route_count, NULL, NULL);
+        stats_record_since(stats, STATS_STAGE_ROUTES, stage);
+        stats_set(state->stats, STATS_ROUTE_FAILURES, state->routes->failures);
+    }
 
-            char aux[INET_ADDRSTRLEN];
+    if (job->detached_count > 0) {
+        pthread_mutex_lock(&state->lock);
+        for (size_t i = 0; i < job->detached_count; i++)
+            peer_table_release(state->peers, job->detached[i]);
+        pthread_mutex_unlock(&state->lock);
+    }
+}
 
-            inet_ntop(AF_INET, &(a1.sin_addr), aux, INET_ADDRSTRLEN);
+/**
+ * Applies jobs in commit order until the queue is closed and empty
+ * @param argument - *Applier
+ */
+void *run_applier(void *argument) {
+    struct Applier *applier = (struct Applier *) argument;
+    struct ApplyQueue *queue = applier->daemon->applies;
+    struct ApplyJob *job;
+
+    while ((job = apply_queue_take(queue)) != NULL) {
+        apply_job(applier, job);
+        apply_queue_complete(queue);
+        stats_set(&applier->stats, STATS_APPLY_BACKLOG, apply_queue_backlog(queue));
+    }
+    return NULL;
+}
 
-            printf("addr: %s\nmask: %d", address, NET_MASK);
+/**
+ * Answers the clients of an applied batch with one flush of the socket and empties the batch
+ * @param server
+ * @param started - uint64_t: value of stats_now() when the commit started
+ */
+void answer_batch(struct Server *server, uint64_t started) {
+    struct Batch *batch = &server->batch;
+    struct Stats *stats = &server->stats;
+    uint64_t stage = stats_now();
 
+    for (size_t i = 0; i < batch->count; i++) {
+        if (!batch->requests[i].answer)
+            continue;
+        answer_request(&server->udp, &batch->requests[i], server->daemon->states[batch->requests[i].pool]->prefix_length);
+        response_cache_store(&server->responses, &batch->requests[i], stage);
+    }
+    udp_flush(&server->udp);
+    stats_record_since(stats, STATS_STAGE_REPLY, stage);
+
+    stats_record(stats, STATS_BATCH_SIZE, batch->count);
+    stats_add(stats, STATS_BATCHES, 1);
+    stats_set(stats, STATS_DATAGRAMS_RECEIVED, server->udp.received);
+    stats_set(stats, STATS_REPLIES_SENT, server->udp.sent);
+    stats_set(stats, STATS_REPLIES_DROPPED, server->udp.dropped);
+    __atomic_sub_fetch(&server->daemon->in_flight, batch->count, __ATOMIC_RELAXED);
+    batch_reset(batch);
+    stats_record_since(stats, STATS_STAGE_COMMIT, started);
+}
 
-            a2.sin_addr.s_addr = 0;
-            for (int i = 0; i < NET_MASK; i++) {
-                a2.sin_addr.s_addr <<= 1;
-                a2.sin_addr.s_addr |= 1;
-            }
-            initialize_state(state);
-            state->start_address = &a1.sin_addr;
-            state->end_address = &a2.sin_addr;
-            change_free_address(state);
+/**
+ * Commits a batch: addresses are allocated from the shard of the worker, the requests of every interface are applied
+ * to its shared state under its lock, one interface after the other, then the clients are answered once the locks are
+ * released, before the apply thread updates the interfaces. When the apply queue is full the worker waits for room
+ * before it takes a lock.
+ * @param server
+ */
+void commit_batch(struct Server *server) {
+    struct Daemon *daemon = server->daemon;
+    struct Batch *batch = &server->batch;
+    uint64_t started = stats_now();
+
+    prepare_batch(server);
+    server->commits++;
+    for (size_t i = 0; i < batch->count; i++) {
+        uint32_t pool = batch->requests[i].pool;
+        struct State *state = daemon->states[pool];
+
+        if (batch->requests[i].request.option == OPTION_INVALID || server->pool_commits[pool] == server->commits)
+            continue;
+        server->pool_commits[pool] = server->commits;
 
-            inet_ntop(AF_INET, &(a2.sin_addr), aux, INET_ADDRSTRLEN);
-            printf("-------  %s\n", aux);
+        apply_queue_reserve(daemon->applies);
+        pthread_mutex_lock(&state->lock);
+        apply_batch(server, pool);
+        pthread_mutex_unlock(&state->lock);
+        batch_reset_changes(batch);
+    }
+    update_shared_gauges(daemon);
+    answer_batch(server, started);
+}
+
+/**
+ * Provisioner structure, executes the requests of the control socket on the thread of the socket
+ *  - daemon - *Daemon: interfaces served
+ *  - batch - Batch: changes of the request being executed, it holds no client requests
+ *  - pending - *size_t: one per interface, entries of the request being executed for it
+ */
+struct Provisioner {
+    struct Daemon *daemon;
+    struct Batch batch;
+    size_t *pending;
+};
 
-            fclose(config_file);
+/**
+ * Adds the peer of a control entry, its lease never expires. A public key that already has a peer keeps its address,
+ * unless another address is pinned; the previous peer is only replaced when something changed. The lock of the shared
+ * state is held.
+ * @param state
+ * @param batch
+ * @param entry - *ControlEntry: its address and result are set
+ * @param shard - uint32_t: spreads the allocations over the shards this node owns, when no address is pinned
+ */
+void provision_peer(struct State *state, struct Batch *batch, struct ControlEntry *entry, uint32_t shard) {
+    struct Peer *peer = peer_table_find_by_key(state->peers, entry->public_key);
+
+    if (peer != NULL && (!entry->pinned || address_equal(&entry->address, &peer->address))) {
+        entry->address = peer->address;
+        if (same_settings(peer, entry->allowed_ips, entry->endpoint, entry->port)) {
+            schedule_lease(state, peer, 0);
+            lease_db_renew(state->leases, peer->record, peer->expires);
+            replicate_lease(state, batch, peer, false);
+            entry->result = CONTROL_OK;
+            return;
+        }
+        unlink_peer(state, batch, peer, false);
+    } else {
+        if (entry->pinned ? !address_pool_reserve(state->pool, &entry->address) :
+            !address_pool_allocate(state->pool, home_shard(state, shard), &entry->address)) {
+            entry->result = CONTROL_NO_ADDRESS;
             return;
         }
+        if (peer != NULL)
+            detach_peer(state, batch, peer, false);
     }
-    fclose(config_file);
-    error("configure_state - "
-          "config file should contain the address of the interface together with the mask to determine allowed peers");
+
+    peer = insert_peer(state, batch, entry->public_key, entry->allowed_ips, entry->endpoint, entry->port,
+                       &entry->address, 0);
+    replicate_lease(state, batch, peer, false);
+    entry->result = CONTROL_OK;
 }
 
 /**
- * Function used in order to receive message from the client.
- * @param sock
- * @param from
- * @param from_length
- * @return
+ * Finds the interface of every entry of a control request, entries without one are meant for the first interface
+ * @param provisioner
+ * @param entries - *ControlEntry: their pool is set, or their result when their interface is not served
+ * @param count - size_t: number of entries
  */
-struct Message *receive_client_configuration(int sock, struct sockaddr_in *from, int from_length) {
-    struct Message *received_configuration = (struct Message*) malloc(sizeof (struct Message));
+void route_entries(struct Provisioner *provisioner, struct ControlEntry *entries, size_t count) {
+    struct Daemon *daemon = provisioner->daemon;
 
-    printf("Receiving configuration...\n");
-    if (recvfrom(sock, received_configuration, sizeof (struct Message), 0, (struct sockaddr*)from, &from_length) < 0)
-        error("recvfrom() - receive_client_configuration -> receival of new client configuration");
-    else
-        printf("Successfully Received: MY_CONFIGURATION (struct Configuration)"
-               "\n\t\tOPTION (int) : %d"
-               "\n\t\tPUBLIC_KEY (char[256]) : %s"
-               "\n\t\tALLOWED_IPS (char[256] : %s"
-               "\n\t\tADDRESS (in_addr_t) : %d"
-               "\n\t\tENDPOINT (char[30]) : %s"
-               "\n\t\tPORT (char[6]) : %s\n",
-               received_configuration->OPTION, received_configuration->PUBLIC_KEY, received_configuration->ALLOWED_IPS, received_configuration->ADDRESS, received_configuration->ENDPOINT, received_configuration->PORT);
+    memset(provisioner->pending, 0, daemon->state_count * sizeof (size_t));
+    for (size_t i = 0; i < count; i++) {
+        struct ControlEntry *entry = &entries[i];
 
-    return received_configuration;
+        if (entry->result == CONTROL_INVALID)
+            continue;
+        entry->pool = 0;
+        if (entry->interface_name[0] != '\0') {
+            for (entry->pool = 0; entry->pool < daemon->state_count; entry->pool++)
+                if (strcmp(daemon->states[entry->pool]->interface_name, entry->interface_name) == 0)
+                    break;
+            if (entry->pool == daemon->state_count) {
+                entry->result = CONTROL_NO_INTERFACE;
+                continue;
+            }
+        }
+        provisioner->pending[entry->pool]++;
+    }
 }
 
 /**
- * Shuts down and starts the interface in order to load new peers or remove old ones.
+ * Executes a control request as one transaction per interface: every lease of an interface is decided in one pass
+ * under the lock of its shared state, then the lease database is synced and the config file, the interface and the
+ * routes are updated once for all of them. The request is answered once the apply thread has applied every interface,
+ * so the peers it reports are on their interfaces.
+ * @param context - *Provisioner
+ * @param entries - *ControlEntry: lines of the request, invalid lines are skipped
+ * @param count - size_t: number of entries
  */
-void refresh_interface() {
-    sleep(5);
-    system(STOP_INTERFACE_COMMAND);
-    system(START_DUMMY_INTERFACE_COMMAND);
+void provision_peers(void *context, struct ControlEntry *entries, size_t count) {
+    struct Provisioner *provisioner = (struct Provisioner *) context;
+    struct Daemon *daemon = provisioner->daemon;
+    struct Batch *batch = &provisioner->batch;
+    uint64_t started = stats_now(), applied = 0;
+    size_t added = 0, removed = 0;
+
+    if (!batch_make_room(batch, count))
+        error("batch_make_room() - provision_peers");
+    route_entries(provisioner, entries, count);
+
+    for (uint32_t pool = 0; pool < daemon->state_count; pool++) {
+        struct State *state = daemon->states[pool];
+        size_t pool_added = 0, pool_removed = 0;
+        uint64_t sequence;
+
+        if (provisioner->pending[pool] == 0)
+            continue;
+        apply_queue_reserve(daemon->applies);
+        pthread_mutex_lock(&state->lock);
+        for (size_t i = 0; i < count; i++) {
+            struct ControlEntry *entry = &entries[i];
+            struct Peer *peer;
+
+            if (entry->result == CONTROL_INVALID || entry->result == CONTROL_NO_INTERFACE || entry->pool != pool)
+                continue;
+            if (!entry->remove) {
+                provision_peer(state, batch, entry, (uint32_t) i);
+                pool_added += entry->result == CONTROL_OK;
+                continue;
+            }
+
+            peer = peer_table_find_by_key(state->peers, entry->public_key);
+            if (peer == NULL) {
+                entry->result = CONTROL_NOT_FOUND;
+                continue;
+            }
+            entry->address = peer->address;
+            replicate_lease(state, batch, peer, true);
+            detach_peer(state, batch, peer, true);
+            pool_removed++;
+        }
+        sequence = commit_changes(state, batch);
+        if (sequence > applied)
+            applied = sequence;
+        stats_add(state->stats, STATS_PEERS_PROVISIONED, pool_added);
+        stats_add(state->stats, STATS_PEERS_DEPROVISIONED, pool_removed);
+        pthread_mutex_unlock(&state->lock);
+        batch_reset(batch);
+        added += pool_added;
+        removed += pool_removed;
+    }
+    update_shared_gauges(daemon);
+    /* jobs are applied in the order they were published, the last one covers every interface */
+    if (applied > 0)
+        apply_queue_wait(daemon->applies, applied);
+
+    event_log(EVENT_LOG_INFO, EVENT_CONTROL_REQUEST, (uint32_t) added, (uint32_t) removed, stats_now() - started, NULL,
+              NULL);
 }
 
 /**
- * Adds new peer by information received in message from client.
- * @param new_client
- * @param client_address
+ * Replicator structure, applies the leases replicated by the other nodes of the cluster on the thread of the cluster
+ *  - daemon - *Daemon: interfaces served
+ *  - batch - Batch: changes of the events being applied, it holds no client requests
  */
-void add_new_peer(struct Message *new_client, struct in_addr *client_address) {
-    char command[256] = "route add ", address[256], buffer[2048];
-    struct in_addr endpoint;
-    FILE *config_file;
+struct Replicator {
+    struct Daemon *daemon;
+    struct Batch batch;
+};
 
-    strcpy(buffer, "\n[Peer]\nPublicKey = ");
-    strcat(buffer, new_client->PUBLIC_KEY);
-    strcat(buffer, "AllowedIPs = ");
-    strcat(buffer, new_client->ALLOWED_IPS);
-    strcat(buffer, "Endpoint = ");
-    strcat(buffer, new_client->ENDPOINT);
-    strcat(buffer, ":");
-    strcat(buffer, new_client->PORT);
+/**
+ * Applies the lease of another node: the peer is added, or refreshed when it did not change. Two nodes can lease at the
+ * same time the same address to different peers, while they disagree on who owns a partition, or different addresses
+ * to the same peer, when it joins both; every node then keeps the same lease: the address goes to the peer with the
+ * smallest public key, the peer keeps the smallest address. An address this node is still handing out to a client is
+ * left alone. The address of the lease stays reserved while its previous holder is replaced, the previous address of
+ * the peer is only released once the new one is reserved. The lock of the shared state is held.
+ * @param state
+ * @param batch
+ * @param event - *ClusterEvent: a CLUSTER_LEASE
+ * @param stats - *Stats: stats of the cluster
+ */
+void apply_replicated_lease(struct State *state, struct Batch *batch, const struct ClusterEvent *event,
+                            struct Stats *stats) {
+    struct Peer *holder = peer_table_find_by_address(state->peers, &event->address);
+    struct Peer *peer = peer_table_find_by_key(state->peers, event->public_key);
 
-    config_file = fopen(CONFIG_DUMMY_FILE, "a");
-    if (config_file == NULL)
-        error("fopen() - add_new_peer - couldn't open config file");
+    if (!address_pool_contains(state->pool, &event->address))
+        return;
+    if (peer != NULL && !address_equal(&peer->address, &event->address)) {
+        stats_add(stats, STATS_CLUSTER_CONFLICTS, 1);
+        if (memcmp(peer->address.s6_addr, event->address.s6_addr, sizeof (peer->address.s6_addr)) < 0)
+            return;
+    }
+    if (holder != NULL && holder != peer) {
+        stats_add(stats, STATS_CLUSTER_CONFLICTS, 1);
+        if (strcmp(holder->public_key, event->public_key) < 0)
+            return;
+    }
 
-    fprintf(config_file, "%s", buffer);
-    fclose(config_file);
+    if (holder != NULL && holder == peer && same_settings(peer, event->allowed_ips, event->endpoint, event->port)) {
+        schedule_lease(state, peer, event->expires);
+        lease_db_renew(state->leases, peer->record, peer->expires);
+        return;
+    }
+    /* the address is reserved before anything is released, a worker may be handing it out */
+    if (holder == NULL && !address_pool_reserve(state->pool, &event->address)) {
+        stats_add(stats, STATS_CLUSTER_CONFLICTS, 1);
+        return;
+    }
+    if (holder != NULL)
+        unlink_peer(state, batch, holder, holder != peer);
+    if (peer != NULL && peer != holder)
+        detach_peer(state, batch, peer, false);
 
-    inet_ntop(AF_INET, client_address, address, 255);
-    fprintf("ADDR: %s/n", address);
-    strcat(command, new_client->ENDPOINT);
-    strcat(command, " wg_dummmy");
-    system(command);
-    refresh_interface();
+    insert_peer(state, batch, event->public_key, event->allowed_ips, event->endpoint, event->port, &event->address,
+                event->expires);
 }
 
 /**
- * Removes peer that matches specification of data received in message from client.
- * @param peer_information
+ * Applies the events of another node as one transaction per interface, like a control request: the peers are changed
+ * under the lock of the shared state, then the lease database is synced and the config file, the interface and the
+ * routes are updated once for all of them. The events are not replicated again.
+ * @param context - *Replicator
+ * @param events - *ClusterEvent
+ * @param count - size_t: number of events
  */
-void remove_peer(struct Message *peer_information) {
-    uint start_index = 0, end_index = 0, words_per_line, current_index = 0, comparable_endpoint[40];
-    char line[512], *word_list[64], delimit[] = " ";
-    bool found = false;
-    FILE *config_file, *aux_file;
-
-    config_file = fopen(CONFIG_DUMMY_FILE, "r");
-    if (config_file == NULL)
-        error("fopen() - remove_peer - CONFIG_DUMMY_FILE");
-
-    while (!found && fgets(line, 512, config_file)) {
-        if (strcmp(line, "[Peer]\n") == 0) {
-            found = true;
-            start_index = current_index;
-            end_index = current_index;
+void apply_replicated_events(void *context, const struct ClusterEvent *events, size_t count) {
+    struct Replicator *replicator = (struct Replicator *) context;
+    struct Daemon *daemon = replicator->daemon;
+    struct Batch *batch = &replicator->batch;
+    struct Stats *stats = &daemon->cluster->stats;
+
+    if (!batch_make_room(batch, 2 * count))
+        error("batch_make_room() - apply_replicated_events");
+
+    for (uint32_t pool = 0; pool < daemon->state_count; pool++) {
+        struct State *state = daemon->states[pool];
+        bool pending = false;
+
+        for (size_t i = 0; i < count && !pending; i++)
+            pending = events[i].pool == pool;
+        if (!pending)
+            continue;
+
+        apply_queue_reserve(daemon->applies);
+        pthread_mutex_lock(&state->lock);
+        for (size_t i = 0; i < count; i++) {
+            struct Peer *peer;
+
+            if (events[i].pool != pool)
+                continue;
+            if (events[i].type == CLUSTER_LEASE) {
+                apply_replicated_lease(state, batch, &events[i], stats);
+                continue;
+            }
+            peer = peer_table_find_by_key(state->peers, events[i].public_key);
+            if (peer != NULL && address_equal(&peer->address, &events[i].address))
+                detach_peer(state, batch, peer, true);
         }
-        current_index++;
+        commit_changes(state, batch);
+        pthread_mutex_unlock(&state->lock);
+        batch_reset(batch);
     }
+    update_shared_gauges(daemon);
+}
 
-    found = false;
-    while (!found && fgets(line, 512, config_file)) {
-        words_per_line = 0;
-        word_list[words_per_line] = strtok(line, delimit);
-        while (word_list[words_per_line] != NULL)
-            word_list[++words_per_line] = strtok(NULL, delimit);
+/**
+ * Gives every pool the partitions the cluster assigns to this node, the pools keep the addresses leased from the
+ * partitions they lose
+ * @param daemon
+ */
+void assign_partitions(struct Daemon *daemon) {
+    struct Cluster *cluster = daemon->cluster;
 
-        if (strcmp(word_list[0], "[Peer]\n") == 0) {
-            start_index = current_index;
-            end_index = current_index;
-        }
-        if (strcmp(word_list[0], "Endpoint") == 0) {
-            strcpy(comparable_endpoint, "");
-            strcat(comparable_endpoint, peer_information->ENDPOINT);
-            strcat(comparable_endpoint, ":");
-            strcat(comparable_endpoint, peer_information->PORT);
-            if (strcmp (word_list[2], comparable_endpoint) == 0) {
-                bool peer_indices_set = false;
-                found = true;
-
-                while (!peer_indices_set && fgets(line, 512, config_file)) {
-                    if (strcmp(line, "[Peer]\n") == 0)
-                        peer_indices_set = true;
-                    else
-                        current_index++;
-                }
-                end_index = current_index;
-            }
+    for (uint32_t i = 0; i < daemon->state_count; i++) {
+        struct AddressPool *pool = daemon->states[i]->pool;
+        uint32_t owned = 0;
+
+        for (uint32_t shard = 0; shard < pool->shard_count; shard++) {
+            bool mine = cluster_owner(cluster, shard) == cluster->node;
+
+            address_pool_set_owned(pool, shard, mine);
+            owned += mine;
         }
-        current_index++;
-    }
-    fclose(config_file);
-    system(CREATE_AUX_FILE_COMMAND);
-    config_file = fopen(CONFIG_DUMMY_FILE, "r");
-    if (config_file == NULL)
-        error("fopen() - remove_peer - 2nd CONFIG_DUMMY_FILE");
-    aux_file = fopen(AUX_FILE, "w");
-    if (aux_file == NULL)
-        error("fopen() - remove_peer - AUX_FILE");
-    current_index = 0;
-    while (fgets(line, 512, config_file)) {
-        if (current_index < start_index || current_index > end_index)
-            fprintf(aux_file, "%s", line);
-        current_index++;
-    }
-    fclose(config_file);
-    fclose(aux_file);
-    system(REPLACE_OLD_CONFIG_FILE_COMMAND);
-    refresh_interface();
-}
-
-/**
- * Waits for message from client and initiates action requested by client: adding a new peer or removing a peer
- * @param sock
- * @param from
- * @param server
- * @param from_length
- * @param state
+        event_log(EVENT_LOG_INFO, EVENT_PARTITIONS_OWNED, owned, pool->shard_count, cluster->node, NULL,
+                  daemon->states[i]->interface_name);
+    }
+}
+
+/**
+ * Follows the nodes of the cluster: the partitions are assigned again, and a node that joined is sent every lease of
+ * every interface, in case it missed some
+ * @param context - *Replicator
+ * @param node - uint32_t: index of the node
+ * @param joined - bool: True, if the node joined
  */
-void run_loop(int sock, struct sockaddr_in *from, struct sockaddr_in *server, int from_length, struct State* state) {
-    struct Message *new_message = receive_client_configuration(sock, from, from_length);
+void handle_cluster_change(void *context, uint32_t node, bool joined) {
+    struct Daemon *daemon = ((struct Replicator *) context)->daemon;
+
+    assign_partitions(daemon);
+    if (!joined)
+        return;
+
+    for (uint32_t i = 0; i < daemon->state_count; i++) {
+        struct State *state = daemon->states[i];
 
-    switch (new_message->OPTION) {
-        case 0:
-            send_address_and_mask(sock, from, from_length, state);
-            add_new_peer(new_message, state->list->tail->data);
+        pthread_mutex_lock(&state->lock);
+        for (struct Peer *peer = state->peers->head; peer != NULL; peer = peer->next)
+            cluster_publish_to(daemon->cluster, node, (uint16_t) state->index, peer);
+        pthread_mutex_unlock(&state->lock);
+    }
+}
+
+/**
+ * Drains the socket into batches. Full batches are committed right away; the window of a partial batch is started,
+ * or the batch is committed at once when batching is disabled.
+ * @param handler
+ * @param events
+ */
+void handle_socket(struct EventHandler *handler, uint32_t events) {
+    struct Server *server = (struct Server *) handler->data;
+    struct Batch *batch = &server->batch;
+    (void) events;
+
+    for (;;) {
+        size_t room = batch->capacity - batch->count;
+        int received = receive_client_configuration(server);
+
+        if (received < 0)
             break;
-        case 1:
-            return_address(state, new_message->ADDRESS);
-            remove_peer(new_message);
+        if (batch_is_full(batch))
+            commit_batch(server);
+        if ((size_t) received < room)
             break;
     }
+
+    if (batch->count == 0)
+        return;
+    if (batch->window_ms == 0) {
+        commit_batch(server);
+    } else if (!server->batch_timer_armed) {
+        timer_arm_ms(server->batch_timer, batch_remaining_ms(batch));
+        server->batch_timer_armed = true;
+    }
 }
 
-void usage() {
+/**
+ * The batch window closed, the requests gathered so far are committed
+ * @param handler
+ * @param events
+ */
+void handle_batch_timer(struct EventHandler *handler, uint32_t events) {
+    struct Server *server = (struct Server *) handler->data;
+    (void) events;
+
+    timer_acknowledge(server->batch_timer);
+    server->batch_timer_armed = false;
+    if (server->batch.count > 0)
+        commit_batch(server);
+}
 
-    if (!is_auto_configurable()) {
-        start_interface(WG_INTERFACE_NAME);
-        goto END;
+/**
+ * Advances the expiry wheel of an interface, its expired leases are removed from the pool, the peer table and the lease
+ * database in one commit; the apply thread removes them from the config file and the interface
+ * @param server
+ * @param state
+ * @return number of expired leases
+ */
+uint32_t expire_leases(struct Server *server, struct State *state) {
+    struct TimerEntry *expired, *next;
+    uint32_t count = 0;
+    uint64_t started;
+
+    apply_queue_reserve(state->applies);
+    pthread_mutex_lock(&state->lock);
+    expired = timer_wheel_advance(state->expiry, monotonic_seconds());
+    if (expired == NULL) {
+        pthread_mutex_unlock(&state->lock);
+        apply_queue_cancel(state->applies);
+        return 0;
+    }
+    started = stats_now();
+
+    for (; expired != NULL; expired = next) {
+        next = expired->next;
+        if (!batch_make_room(&server->batch, 1))
+            error("batch_make_room() - expire_leases");
+        detach_peer(state, &server->batch, (struct Peer *) expired->data, true);
+        count++;
     }
+    commit_changes(state, &server->batch);
+    batch_reset(&server->batch);
+    stats_add(state->stats, STATS_LEASES_EXPIRED, count);
+    stats_record_since(state->stats, STATS_STAGE_EXPIRY, started);
+    pthread_mutex_unlock(&state->lock);
+    event_log(EVENT_LOG_INFO, EVENT_LEASES_EXPIRED, count, 0, 0, NULL, state->interface_name);
+    return count;
+}
+
+/**
+ * Advances the expiry wheels of every interface. Requests waiting in the batch are committed first.
+ * @param handler
+ * @param events
+ */
+void handle_expiry_timer(struct EventHandler *handler, uint32_t events) {
+    struct Server *server = (struct Server *) handler->data;
+    struct Daemon *daemon = server->daemon;
+    uint32_t count = 0;
+    (void) events;
+
+    timer_acknowledge(server->expiry_timer);
+    if (server->batch.count > 0)
+        commit_batch(server);
+
+    for (uint32_t i = 0; i < daemon->state_count; i++)
+        count += expire_leases(server, daemon->states[i]);
+    if (count > 0)
+        update_shared_gauges(daemon);
+}
+
+/**
+ * SIGTERM or SIGINT was received, every worker is told to stop; SIGUSR1 dumps the flight recorder of the event log
+ * @param handler
+ * @param events
+ */
+void handle_signal(struct EventHandler *handler, uint32_t events) {
+    struct signalfd_siginfo signal_information;
+    bool shutdown = false;
+    (void) events;
+
+    while (read(handler->fd, &signal_information, sizeof (signal_information)) == sizeof (signal_information)) {
+        if (signal_information.ssi_signo == SIGUSR1) {
+            event_log_dump();
+            continue;
+        }
+        event_log(EVENT_LOG_INFO, EVENT_SIGNAL, signal_information.ssi_signo, 0, 0, NULL, NULL);
+        shutdown = true;
+    }
+    if (shutdown)
+        eventfd_write(SHUTDOWN_EVENT, 1);
+}
+
+/**
+ * A link changed, every worker is told to stop if it is one of the dummy interfaces and it was removed or set down
+ * @param handler
+ * @param events
+ */
+void handle_link_event(struct EventHandler *handler, uint32_t events) {
+    const char *gone = link_monitor_gone(&LINK_MONITOR);
+    (void) handler;
+    (void) events;
 
-    struct sockaddr_in *si_me = (struct sockaddr_in*) malloc(sizeof (struct sockaddr_in));
-    struct sockaddr_in *si_other = (struct sockaddr_in*) malloc(sizeof (struct sockaddr_in));
+    if (gone == NULL)
+        return;
+    event_log(EVENT_LOG_WARNING, EVENT_INTERFACE_GONE, 0, 0, 0, NULL, gone);
+    eventfd_write(SHUTDOWN_EVENT, 1);
+}
 
-        int s, slen = sizeof(struct sockaddr_in);
+/**
+ * The interface is gone or the server was asked to stop: pending requests are committed and the loop stops. The event
+ * is not read, so it stays signaled for the loops of the other workers.
+ * @param handler
+ * @param events
+ */
+void handle_shutdown(struct EventHandler *handler, uint32_t events) {
+    struct Server *server = (struct Server *) handler->data;
+    (void) events;
 
-        if ((s=socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
-            error("socket");
+    if (server->batch.count > 0)
+        commit_batch(server);
+    event_loop_stop(&server->loop);
+}
 
+/**
+ * Creates the socket, the timers and the event loop of a worker, and registers their handlers. Only worker 0 advances
+ * the expiry wheel and watches the termination signals and the link events.
+ * @param server
+ * @param daemon
+ * @param index - uint32_t: number of the worker
+ */
+void initialize_server(struct Server *server, struct Daemon *daemon, uint32_t index) {
+    server->daemon = daemon;
+    server->index = index;
+    server->batch_timer_armed = false;
+    server->commits = 0;
+    stats_init(&server->stats);
+
+    server->pool_commits = (uint64_t *) calloc(daemon->state_count, sizeof (uint64_t));
+    if (server->pool_commits == NULL)
+        error("calloc() - initialize_server");
+    if (!batch_init(&server->batch, (size_t) BATCH_MAX_REQUESTS, BATCH_WINDOW_MS))
+        error("batch_init() - initialize_server");
+    if (!admission_init(&server->admission, ADMISSION_BUCKETS, ADMISSION_RATE, ADMISSION_BURST))
+        error("admission_init() - initialize_server");
+    if (!response_cache_init(&server->responses, RESPONSE_CACHE_ENTRIES, RESPONSE_CACHE_TTL_MS))
+        error("response_cache_init() - initialize_server");
+    if (!udp_socket_open(&server->udp, (uint16_t) DHCP_PORT, server->batch.capacity, 2 * server->batch.capacity,
+                         WORKERS > 1))
+        error("udp_socket_open() - initialize_server");
+    if (!event_loop_init(&server->loop))
+        error("event_loop_init() - initialize_server");
+
+    server->batch_timer = timer_open();
+    server->expiry_timer = index == 0 ? timer_open() : -1;
+    if (server->batch_timer < 0 || (index == 0 && server->expiry_timer < 0))
+        error("timerfd - initialize_server");
+    if (index == 0 && !timer_arm_periodic_ms(server->expiry_timer, EXPIRY_TICK_MS))
+        error("timer_arm_periodic_ms() - initialize_server");
+
+    server->socket_handler = (struct EventHandler) {.fd = server->udp.fd, .handle = handle_socket, .data = server};
+    server->batch_timer_handler = (struct EventHandler) {.fd = server->batch_timer, .handle = handle_batch_timer, .data = server};
+    server->expiry_timer_handler = (struct EventHandler) {.fd = server->expiry_timer, .handle = handle_expiry_timer, .data = server};
+    server->shutdown_handler = (struct EventHandler) {.fd = SHUTDOWN_EVENT, .handle = handle_shutdown, .data = server};
+    server->signal_handler = (struct EventHandler) {.fd = SIGNAL_EVENT, .handle = handle_signal, .data = server};
+    server->link_handler = (struct EventHandler) {.fd = LINK_MONITOR.fd, .handle = handle_link_event, .data = server};
+
+    if (!event_loop_add(&server->loop, &server->socket_handler, EPOLLIN) ||
+        !event_loop_add(&server->loop, &server->batch_timer_handler, EPOLLIN) ||
+        (index == 0 && !event_loop_add(&server->loop, &server->expiry_timer_handler, EPOLLIN)) ||
+        !event_loop_add(&server->loop, &server->shutdown_handler, EPOLLIN) ||
+        (index == 0 && !event_loop_add(&server->loop, &server->signal_handler, EPOLLIN)) ||
+        (index == 0 && LINK_MONITOR.fd >= 0 && !event_loop_add(&server->loop, &server->link_handler, EPOLLIN)))
+        error("event_loop_add() - initialize_server");
+}
 
-        si_me->sin_family = AF_INET;
-        si_me->sin_port = htons(DHCP_PORT);
-        si_me->sin_addr.s_addr = htonl(INADDR_ANY);
-        if( bind(s , (struct sockaddr*)si_me, slen ) == -1)
-            error("bind");
+void destroy_server(struct Server *server) {
+    batch_destroy(&server->batch);
+    free(server->pool_commits);
+    admission_destroy(&server->admission);
+    response_cache_destroy(&server->responses);
+    close(server->batch_timer);
+    if (server->expiry_timer >= 0)
+        close(server->expiry_timer);
+    event_loop_destroy(&server->loop);
+    udp_socket_close(&server->udp);
+}
 
-    struct State *state = (struct State *) malloc(sizeof (struct State));
-    configure_state(state);
-    start_interface(WG_DUMMY_INTERFACE_NAME);
-    pthread_t thread;
-    pthread_create(&thread, NULL, check_for_shutdown, NULL);
+void *run_worker(void *argument) {
+    struct Server *server = (struct Server *) argument;
+
+    event_loop_run(&server->loop);
+    return NULL;
+}
+
+/**
+ * Builds the state of every interface given with -i, the interfaces that are not AutoConfigurable are only started.
+ * Two options can not name the same interface, their files would be shared.
+ * @param daemon - *Daemon: its states are set
+ */
+void configure_interfaces(struct Daemon *daemon) {
+    daemon->state_count = 0;
+    daemon->states = (struct State **) malloc(INTERFACE_OPTION_COUNT * sizeof (struct State *));
+    if (daemon->states == NULL)
+        error("malloc() - configure_interfaces");
+
+    for (size_t i = 0; i < INTERFACE_OPTION_COUNT; i++) {
+        struct State *state = (struct State *) malloc(sizeof (struct State));
+
+        if (state == NULL)
+            error("malloc() - configure_interfaces");
+        configure_interface(state, INTERFACE_OPTIONS[i]);
+        for (uint32_t j = 0; j < daemon->state_count; j++) {
+            if (strcmp(daemon->states[j]->interface_name, state->interface_name) == 0) {
+                fprintf(stderr, "configure_interfaces - %s is given twice\n", state->interface_name);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        load_config(state);
+        if (!is_auto_configurable(state)) {
+            run_wg_quick(START_INTERFACE_COMMAND, state->config_file);
+            wg_config_destroy(&state->wg_config);
+            free(state);
+            continue;
+        }
+        state->index = daemon->state_count;
+        state->cluster = daemon->cluster;
+        configure_state(state);
+        state->applies = daemon->applies;
+        restore_leases(state);
+        daemon->states[daemon->state_count++] = state;
+    }
+}
+
+void usage() {
+    struct StatsSocket stats_socket;
+    struct ControlSocket control_socket;
+    struct Provisioner provisioner;
+    struct Applier applier;
+    struct Replicator replicator;
+    struct Daemon daemon;
+    struct Server *servers;
+    const struct Stats **stats_sources;
+    size_t stats_source_count;
+    sigset_t handled_signals;
+
+    if (!event_log_open(PRINT_LEVEL, FLIGHT_LEVEL))
+        error("event_log_open() - usage");
+    daemon.in_flight = 0;
+    daemon.applies = (struct ApplyQueue *) malloc(sizeof (struct ApplyQueue));
+    daemon.stats = (struct Stats *) malloc(sizeof (struct Stats));
+    if (daemon.applies == NULL || daemon.stats == NULL || !apply_queue_init(daemon.applies, (size_t) APPLY_QUEUE_LENGTH))
+        error("apply_queue_init() - usage");
+    stats_init(daemon.stats);
+    daemon.cluster = NULL;
+    replicator.daemon = &daemon;
+    if (CLUSTER_NODES != NULL) {
+        daemon.cluster = (struct Cluster *) malloc(sizeof (struct Cluster));
+        if (daemon.cluster == NULL || !cluster_open(daemon.cluster, CLUSTER_NODES, CLUSTER_NODE,
+                                                    apply_replicated_events, handle_cluster_change, &replicator))
+            error("cluster_open() - usage");
+    }
+    configure_interfaces(&daemon);
+    if (daemon.state_count == 0)
+        goto END;
+
+    sigemptyset(&handled_signals);
+    sigaddset(&handled_signals, SIGTERM);
+    sigaddset(&handled_signals, SIGINT);
+    sigaddset(&handled_signals, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &handled_signals, NULL) != 0)
+        error("pthread_sigmask() - usage");
+    SIGNAL_EVENT = signalfd(-1, &handled_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    SHUTDOWN_EVENT = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (SHUTDOWN_EVENT < 0 || SIGNAL_EVENT < 0)
+        error("eventfd() - usage");
+
+    if (!STUB_MODE && !link_monitor_open(&LINK_MONITOR))
+        error("link_monitor_open() - usage");
+    for (uint32_t i = 0; i < daemon.state_count; i++) {
+        start_interface(daemon.states[i]);
+        if (!STUB_MODE && !link_monitor_watch(&LINK_MONITOR, daemon.states[i]->dummy_interface_name))
+            error("link_monitor_watch() - usage - a dummy interface is not up");
+    }
 
-    while(!SHUTDOWN)
-        run_loop(s, si_other, si_me, slen, state);
+    stats_source_count = daemon.state_count + (size_t) WORKERS + 2 + (daemon.cluster != NULL);
+    servers = (struct Server *) calloc((size_t) WORKERS, sizeof (struct Server));
+    stats_sources = (const struct Stats **) malloc(stats_source_count * sizeof (struct Stats *));
+    if (servers == NULL || stats_sources == NULL)
+        error("malloc() - usage");
+    stats_sources[0] = daemon.stats;
+    applier.daemon = &daemon;
+    stats_init(&applier.stats);
+    stats_sources[1] = &applier.stats;
+    for (long i = 0; i < WORKERS; i++) {
+        initialize_server(&servers[i], &daemon, (uint32_t) i);
+        stats_sources[i + 2] = &servers[i].stats;
+    }
 
-    pthread_join(thread, NULL);
-    shutdown_server(s, state);
-    close(s);
+    for (uint32_t i = 0; i < daemon.state_count; i++) {
+        struct State *state = daemon.states[i];
+
+        if (!dataplane_init(state->dataplane, DATAPLANE_BACKEND, state->dummy_interface_name))
+            error("dataplane_init() - usage");
+        if (!dataplane_sync(state->dataplane, state->peers))
+            printf("Restored peers of %s could not be applied to the interface\n", state->interface_name);
+        if (!route_manager_init(state->routes, ROUTE_BACKEND, state->dummy_interface_name))
+            error("route_manager_init() - usage");
+        restore_routes(state);
+        stats_set(state->stats, STATS_ROUTE_FAILURES, state->routes->failures);
+        update_gauges(state);
+        stats_sources[(size_t) WORKERS + 2 + i] = state->stats;
+    }
+    update_shared_gauges(&daemon);
+    if (daemon.cluster != NULL) {
+        assign_partitions(&daemon);
+        stats_sources[stats_source_count - 1] = &daemon.cluster->stats;
+    }
+    if (!stats_socket_open(&stats_socket, STATS_SOCKET_FILE, stats_sources, stats_source_count))
+        error("stats_socket_open() - usage");
+    provisioner.daemon = &daemon;
+    provisioner.pending = (size_t *) malloc(daemon.state_count * sizeof (size_t));
+    if (provisioner.pending == NULL || !batch_init(&provisioner.batch, 1, 0))
+        error("batch_init() - usage - provisioner");
+    if (!batch_init(&replicator.batch, 1, 0))
+        error("batch_init() - usage - replicator");
+
+    if (pthread_create(&applier.thread, NULL, run_applier, &applier) != 0)
+        error("pthread_create() - usage - applier");
+    if (daemon.cluster != NULL && !cluster_start(daemon.cluster))
+        error("pthread_create() - usage - cluster");
+    for (long i = 1; i < WORKERS; i++)
+        if (pthread_create(&servers[i].thread, NULL, run_worker, &servers[i]) != 0)
+            error("pthread_create() - usage - worker");
+    if (!control_socket_open(&control_socket, CONTROL_SOCKET_FILE, provision_peers, &provisioner))
+        error("control_socket_open() - usage");
+    printf("Serving %u interfaces on port %d with %ld workers\n", daemon.state_count, DHCP_PORT, WORKERS);
+    event_loop_run(&servers[0].loop);
+    for (long i = 1; i < WORKERS; i++)
+        pthread_join(servers[i].thread, NULL);
+    control_socket_close(&control_socket);
+    if (daemon.cluster != NULL)
+        cluster_close(daemon.cluster);
+    batch_destroy(&replicator.batch);
+    batch_destroy(&provisioner.batch);
+    free(provisioner.pending);
+    apply_queue_close(daemon.applies);
+    pthread_join(applier.thread, NULL);
+    stats_socket_close(&stats_socket);
+    for (long i = 0; i < WORKERS; i++)
+        destroy_server(&servers[i]);
+    free(servers);
+    free(stats_sources);
+    close(SHUTDOWN_EVENT);
+    close(SIGNAL_EVENT);
+    link_monitor_close(&LINK_MONITOR);
+    for (uint32_t i = 0; i < daemon.state_count; i++)
+        shutdown_server(daemon.states[i]);
 
     END:
+    free(daemon.cluster);
+    free(daemon.states);
+    apply_queue_destroy(daemon.applies);
+    free(daemon.applies);
+    free(daemon.stats);
+    event_log_close();
     exit(EXIT_SUCCESS);
 }
 
+/**
+ * Places the stats socket and the control socket in the config directory, the files of every interface are placed by
+ * configure_interface()
+ * @param directory
+ */
+void configure_paths(const char *directory) {
+    CONFIG_DIRECTORY = directory;
+    if (snprintf(STATS_SOCKET_FILE, PATH_MAX, "%s/%s", directory, STATS_SOCKET_FILE_NAME) >= PATH_MAX ||
+        snprintf(CONTROL_SOCKET_FILE, PATH_MAX, "%s/%s", directory, CONTROL_SOCKET_FILE_NAME) >= PATH_MAX) {
+        fprintf(stderr, "configure_paths - directory name is too long\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Adds an interface given with -i
+ * @param option - *char: "<interface>" or "<interface>@<IPv4 listen address>"
+ */
+void add_interface_option(const char *option) {
+    const char **options = (const char **) realloc(INTERFACE_OPTIONS, (INTERFACE_OPTION_COUNT + 1) * sizeof (char *));
+
+    if (options == NULL)
+        error("realloc() - add_interface_option");
+    INTERFACE_OPTIONS = options;
+    INTERFACE_OPTIONS[INTERFACE_OPTION_COUNT++] = option;
+}
+
 int main(int argc, char *argv[]) {
+    const char *directory = DEFAULT_CONFIG_DIRECTORY;
+    int option;
+
+    while ((option = getopt(argc, argv, "w:b:l:d:p:sj:r:u:q:a:i:c:n:v:f:")) != -1) {
+        switch (option) {
+            case 'w':
+                BATCH_WINDOW_MS = atol(optarg);
+                break;
+            case 'b':
+                BATCH_MAX_REQUESTS = atol(optarg);
+                break;
+            case 'l':
+                LEASE_TIME = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                directory = optarg;
+                break;
+            case 'p':
+                DHCP_PORT = atoi(optarg);
+                break;
+            case 's':
+                STUB_MODE = true;
+                DATAPLANE_BACKEND = "stub";
+                ROUTE_BACKEND = "stub";
+                break;
+            case 'j':
+                WORKERS = atol(optarg);
+                if (WORKERS < 1)
+                    WORKERS = 1;
+                break;
+            case 'r':
+                ADMISSION_RATE = atof(optarg);
+                break;
+            case 'u':
+                ADMISSION_BURST = atof(optarg);
+                break;
+            case 'q':
+                MAX_IN_FLIGHT = atol(optarg);
+                break;
+            case 'a':
+                APPLY_QUEUE_LENGTH = atol(optarg);
+                if (APPLY_QUEUE_LENGTH < 1)
+                    APPLY_QUEUE_LENGTH = 1;
+                break;
+            case 'i':
+                add_interface_option(optarg);
+                break;
+            case 'c':
+                CLUSTER_NODES = optarg;
+                break;
+            case 'n':
+                CLUSTER_NODE = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                PRINT_LEVEL = atoi(optarg);
+                break;
+            case 'f':
+                FLIGHT_LEVEL = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-w batch window ms] [-b max requests per batch] [-l lease time s, 0 never expires]"
+                                " [-d config directory] [-p port] [-s stub data plane, no wg-quick] [-j worker threads]"
+                                " [-r requests/s per source, 0 unlimited] [-u burst per source]"
+                                " [-q max requests in flight, 0 unlimited] [-a committed batches waiting for the interface]"
+                                " [-i interface[@listen address], repeated for every interface served, " WG_INTERFACE_NAME
+                                " by default] [-c host:port of every node of the cluster, comma separated]"
+                                " [-n index of this node in the cluster]"
+                                " [-v printed log level, 0 errors, 1 warnings, 2 info, 3 debug]"
+                                " [-f log level kept by the flight recorder, dumped on SIGUSR1]\n",
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (INTERFACE_OPTION_COUNT == 0)
+        add_interface_option(WG_INTERFACE_NAME);
+    configure_paths(directory);
+    signal(SIGPIPE, SIG_IGN);
+
     usage();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef DHCP_V1_MESSAGE_H
+#define DHCP_V1_MESSAGE_H
+
+#include <netinet/in.h>
+
+/**
+ * Message structure:
+ *  - OPTION - int: specifies wether server should add or remove peer information specified by this message
+ *  - PUBLIC_KEY - char[256]: PUBLIC_KEY of the client, derived from PRIVATE_KEY found in the configuration file
+ *  - ALLOWED_IPS - char[256]: string that represents ips that the client wants to route through the WireGuard tunnel
+ *  - ADDRESS - in_addr_t: address that the client will receive from the server, this address is also being used when client wants to return the address
+ *  - ENDPOINT - char[30]: real endpoint of the client, where server will send the routed packets
+ *  - PORT - char[10]: port to which client WireGuard interface is listening
+ */
+struct Message {
+    int OPTION;
+    char PUBLIC_KEY[256];
+    char ALLOWED_IPS[256];
+    in_addr_t ADDRESS;
+    char ENDPOINT[30];
+    char PORT[10];
+};
+
+#endif //DHCP_V1_MESSAGE_H
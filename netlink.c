@@ -0,0 +1,285 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/genetlink.h>
+
+#include "netlink.h"
+
+/* an error acknowledgement may echo a whole request, the receive buffer holds the largest one with its headers */
+#define NETLINK_RECEIVE_SIZE (NETLINK_BUFFER_SIZE + 4096)
+#define NETLINK_RECEIVE_TIMEOUT_MS 5000
+
+static struct nlmsghdr *current_message(struct NetlinkBuffer *buffer) {
+    return (struct nlmsghdr *) (buffer->data + buffer->message);
+}
+
+/**
+ * Opens a netlink socket of the given protocol. Error acknowledgements do not echo the request, when the kernel
+ * supports it, and a receive that gets no answer for NETLINK_RECEIVE_TIMEOUT_MS fails instead of blocking forever.
+ * @param protocol - int: NETLINK_ROUTE, NETLINK_GENERIC, ...
+ * @param groups - uint32_t: multicast groups the socket subscribes to, 0 for none
+ * @return file descriptor of the socket
+ *         -1, on failure
+ */
+int netlink_open(int protocol, uint32_t groups) {
+    struct sockaddr_nl local;
+    struct timeval timeout = {.tv_sec = NETLINK_RECEIVE_TIMEOUT_MS / 1000,
+                              .tv_usec = NETLINK_RECEIVE_TIMEOUT_MS % 1000 * 1000};
+    int enable = 1;
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, protocol);
+
+    if (sock < 0)
+        return -1;
+
+    /* older kernels do not know the acknowledgement options, the receive buffer is large enough without them */
+    setsockopt(sock, SOL_NETLINK, NETLINK_CAP_ACK, &enable, sizeof (enable));
+    setsockopt(sock, SOL_NETLINK, NETLINK_EXT_ACK, &enable, sizeof (enable));
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    memset(&local, 0, sizeof (local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = groups;
+    if (bind(sock, (struct sockaddr *) &local, sizeof (local)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+void netlink_reset(struct NetlinkBuffer *buffer) {
+    buffer->length = 0;
+    buffer->message = 0;
+}
+
+/**
+ * Starts a new message at the end of the buffer
+ * @param buffer
+ * @param type - uint16_t: message type, family id for generic netlink
+ * @param flags - uint16_t: NLM_F_* flags, NLM_F_REQUEST is always added
+ * @param sequence - uint32_t: sequence number used to match the acknowledgement
+ * @param header - *void: family specific header that follows the netlink header (genlmsghdr, rtmsg, ...)
+ * @param header_length - size_t: length of @param header
+ * @return True, if the message fits in the buffer
+ *         False, otherwise
+ */
+bool netlink_begin(struct NetlinkBuffer *buffer, uint16_t type, uint16_t flags, uint32_t sequence,
+                   const void *header, size_t header_length) {
+    size_t needed = NLMSG_SPACE(header_length);
+    struct nlmsghdr *message;
+
+    if (buffer->length + needed > NETLINK_BUFFER_SIZE)
+        return false;
+
+    buffer->message = buffer->length;
+    message = current_message(buffer);
+    memset(message, 0, needed);
+    message->nlmsg_len = NLMSG_LENGTH(header_length);
+    message->nlmsg_type = type;
+    message->nlmsg_flags = NLM_F_REQUEST | flags;
+    message->nlmsg_seq = sequence;
+    memcpy(NLMSG_DATA(message), header, header_length);
+
+    buffer->length += needed;
+    return true;
+}
+
+/**
+ * Closes the message currently being built, its length covers every attribute added since netlink_begin()
+ * @param buffer
+ */
+void netlink_end(struct NetlinkBuffer *buffer) {
+    current_message(buffer)->nlmsg_len = (uint32_t) (buffer->length - buffer->message);
+}
+
+bool netlink_put(struct NetlinkBuffer *buffer, uint16_t type, const void *data, size_t length) {
+    size_t needed = NLA_ALIGN(NLA_HDRLEN + length);
+    struct nlattr *attribute;
+
+    if (buffer->length + needed > NETLINK_BUFFER_SIZE)
+        return false;
+
+    attribute = (struct nlattr *) (buffer->data + buffer->length);
+    memset(attribute, 0, needed);
+    attribute->nla_type = type;
+    attribute->nla_len = (uint16_t) (NLA_HDRLEN + length);
+    if (length > 0)
+        memcpy((char *) attribute + NLA_HDRLEN, data, length);
+
+    buffer->length += needed;
+    return true;
+}
+
+bool netlink_put_u8(struct NetlinkBuffer *buffer, uint16_t type, uint8_t value) {
+    return netlink_put(buffer, type, &value, sizeof (value));
+}
+
+bool netlink_put_u16(struct NetlinkBuffer *buffer, uint16_t type, uint16_t value) {
+    return netlink_put(buffer, type, &value, sizeof (value));
+}
+
+bool netlink_put_u32(struct NetlinkBuffer *buffer, uint16_t type, uint32_t value) {
+    return netlink_put(buffer, type, &value, sizeof (value));
+}
+
+bool netlink_put_string(struct NetlinkBuffer *buffer, uint16_t type, const char *value) {
+    return netlink_put(buffer, type, value, strlen(value) + 1);
+}
+
+/**
+ * Starts a nested attribute
+ * @param buffer
+ * @param type - uint16_t: type of the nested attribute, NLA_F_NESTED is added
+ * @return offset of the nest, to be given to netlink_nest_end()
+ *         0, if the buffer is full
+ */
+size_t netlink_nest_start(struct NetlinkBuffer *buffer, uint16_t type) {
+    size_t nest = buffer->length;
+
+    if (!netlink_put(buffer, type | NLA_F_NESTED, NULL, 0))
+        return 0;
+    return nest;
+}
+
+void netlink_nest_end(struct NetlinkBuffer *buffer, size_t nest) {
+    ((struct nlattr *) (buffer->data + nest))->nla_len = (uint16_t) (buffer->length - nest);
+}
+
+/**
+ * Drops everything added to the buffer after the given offset
+ * @param buffer
+ * @param offset - size_t: length of the buffer to go back to
+ */
+void netlink_cancel(struct NetlinkBuffer *buffer, size_t offset) {
+    buffer->length = offset;
+}
+
+/**
+ * Sends every message in the buffer with one system call and waits for their acknowledgements
+ * @param sock
+ * @param buffer
+ * @param first_sequence - uint32_t: sequence number of the first message in the buffer
+ * @param last_sequence - uint32_t: sequence number of the last message in the buffer
+ * @return 0, if every message was acknowledged without error
+ *         negative errno of the first message that failed, otherwise; -EAGAIN if the kernel did not answer in time,
+ *         -EMSGSIZE if an answer did not fit in the receive buffer
+ */
+int netlink_transact(int sock, struct NetlinkBuffer *buffer, uint32_t first_sequence, uint32_t last_sequence) {
+    return netlink_transact_each(sock, buffer, first_sequence, last_sequence, NULL);
+}
+
+/**
+ * Same as netlink_transact(), the outcome of every message is also stored
+ * @param results - *int: results[i] receives 0 or the negative errno of the message numbered first_sequence + i,
+ *                  NULL if only the first failure matters
+ */
+int netlink_transact_each(int sock, struct NetlinkBuffer *buffer, uint32_t first_sequence, uint32_t last_sequence,
+                          int *results) {
+    char response[NETLINK_RECEIVE_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    uint32_t pending = last_sequence - first_sequence + 1;
+    struct sockaddr_nl kernel;
+    int result = 0;
+
+    if (buffer->length == 0)
+        return 0;
+
+    memset(&kernel, 0, sizeof (kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(sock, buffer->data, buffer->length, 0, (struct sockaddr *) &kernel, sizeof (kernel)) < 0)
+        return -errno;
+
+    while (pending > 0) {
+        ssize_t received = recv(sock, response, sizeof (response), MSG_TRUNC);
+        int length = (int) received;
+
+        if (received < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if ((size_t) received > sizeof (response))
+            return -EMSGSIZE;
+
+        for (struct nlmsghdr *message = (struct nlmsghdr *) response; NLMSG_OK(message, length);
+             message = NLMSG_NEXT(message, length)) {
+            if (message->nlmsg_type != NLMSG_ERROR)
+                continue;
+            if (message->nlmsg_seq < first_sequence || message->nlmsg_seq > last_sequence)
+                continue;
+
+            struct nlmsgerr *acknowledgement = (struct nlmsgerr *) NLMSG_DATA(message);
+            if (results != NULL)
+                results[message->nlmsg_seq - first_sequence] = acknowledgement->error;
+            if (acknowledgement->error != 0 && result == 0)
+                result = acknowledgement->error;
+            pending--;
+        }
+    }
+    return result;
+}
+
+/**
+ * Asks the generic netlink controller for the id of a family
+ * @param sock - int: NETLINK_GENERIC socket
+ * @param name - *char: name of the family, e.g. "wireguard"
+ * @param sequence - uint32_t: sequence number of the request
+ * @return id of the family
+ *         negative errno, on failure
+ */
+int netlink_resolve_family(int sock, const char *name, uint32_t sequence) {
+    struct NetlinkBuffer buffer;
+    char response[NETLINK_RECEIVE_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    struct genlmsghdr header = {.cmd = CTRL_CMD_GETFAMILY, .version = 1};
+    struct sockaddr_nl kernel;
+
+    netlink_reset(&buffer);
+    if (!netlink_begin(&buffer, GENL_ID_CTRL, 0, sequence, &header, sizeof (header)) ||
+        !netlink_put_string(&buffer, CTRL_ATTR_FAMILY_NAME, name))
+        return -ENOBUFS;
+    netlink_end(&buffer);
+
+    memset(&kernel, 0, sizeof (kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(sock, buffer.data, buffer.length, 0, (struct sockaddr *) &kernel, sizeof (kernel)) < 0)
+        return -errno;
+
+    for (;;) {
+        ssize_t received = recv(sock, response, sizeof (response), MSG_TRUNC);
+        int length = (int) received;
+
+        if (received < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        if ((size_t) received > sizeof (response))
+            return -EMSGSIZE;
+
+        for (struct nlmsghdr *message = (struct nlmsghdr *) response; NLMSG_OK(message, length);
+             message = NLMSG_NEXT(message, length)) {
+            if (message->nlmsg_seq != sequence)
+                continue;
+            if (message->nlmsg_type == NLMSG_ERROR)
+                return ((struct nlmsgerr *) NLMSG_DATA(message))->error;
+            if (message->nlmsg_type != GENL_ID_CTRL)
+                continue;
+
+            int attributes_length = (int) (message->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN));
+            struct nlattr *attribute = (struct nlattr *) ((char *) NLMSG_DATA(message) + GENL_HDRLEN);
+
+            while (attributes_length >= NLA_HDRLEN && attribute->nla_len >= NLA_HDRLEN &&
+                   attribute->nla_len <= attributes_length) {
+                if ((attribute->nla_type & NLA_TYPE_MASK) == CTRL_ATTR_FAMILY_ID)
+                    return *(uint16_t *) ((char *) attribute + NLA_HDRLEN);
+
+                attributes_length -= NLA_ALIGN(attribute->nla_len);
+                attribute = (struct nlattr *) ((char *) attribute + NLA_ALIGN(attribute->nla_len));
+            }
+            return -ENOENT;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef DHCP_V1_NETLINK_H
+#define DHCP_V1_NETLINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/netlink.h>
+
+#define NETLINK_BUFFER_SIZE 32768
+
+/**
+ * NetlinkBuffer structure, used to build one or more netlink messages that are sent together
+ *  - data - char[]: messages, aligned as netlink requires
+ *  - length - size_t: bytes used in data
+ *  - message - size_t: offset of the message currently being built
+ */
+struct NetlinkBuffer {
+    char data[NETLINK_BUFFER_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+    size_t length;
+    size_t message;
+};
+
+int netlink_open(int protocol, uint32_t groups);
+void netlink_reset(struct NetlinkBuffer *buffer);
+bool netlink_begin(struct NetlinkBuffer *buffer, uint16_t type, uint16_t flags, uint32_t sequence,
+                   const void *header, size_t header_length);
+void netlink_end(struct NetlinkBuffer *buffer);
+bool netlink_put(struct NetlinkBuffer *buffer, uint16_t type, const void *data, size_t length);
+bool netlink_put_u8(struct NetlinkBuffer *buffer, uint16_t type, uint8_t value);
+bool netlink_put_u16(struct NetlinkBuffer *buffer, uint16_t type, uint16_t value);
+bool netlink_put_u32(struct NetlinkBuffer *buffer, uint16_t type, uint32_t value);
+bool netlink_put_string(struct NetlinkBuffer *buffer, uint16_t type, const char *value);
+size_t netlink_nest_start(struct NetlinkBuffer *buffer, uint16_t type);
+void netlink_nest_end(struct NetlinkBuffer *buffer, size_t nest);
+void netlink_cancel(struct NetlinkBuffer *buffer, size_t offset);
+int netlink_transact(int sock, struct NetlinkBuffer *buffer, uint32_t first_sequence, uint32_t last_sequence);
+int netlink_transact_each(int sock, struct NetlinkBuffer *buffer, uint32_t first_sequence, uint32_t last_sequence,
+                          int *results);
+int netlink_resolve_family(int sock, const char *name, uint32_t sequence);
+
+#endif //DHCP_V1_NETLINK_H
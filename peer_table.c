@@ -0,0 +1,341 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "peer_table.h"
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint32_t hash_string(uint32_t hash, const char *value) {
+    while (*value != '\0') {
+        hash ^= (unsigned char) *value++;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t hash_key(const char *public_key) {
+    return hash_string(FNV_OFFSET, public_key);
+}
+
+static uint32_t hash_endpoint(const char *endpoint, const char *port) {
+    return hash_string(hash_string(hash_string(FNV_OFFSET, endpoint), ":"), port);
+}
+
+/**
+ * Links a peer into the three hash indexes
+ * @param table
+ * @param peer
+ */
+static void link_peer(struct PeerTable *table, struct Peer *peer) {
+    uint32_t mask = table->bucket_count - 1, bucket;
+
+    bucket = hash_key(peer->public_key) & mask;
+    peer->next_by_key = table->by_key[bucket];
+    table->by_key[bucket] = peer;
+
+    bucket = address_hash(&peer->address) & mask;
+    peer->next_by_address = table->by_address[bucket];
+    table->by_address[bucket] = peer;
+
+    bucket = hash_endpoint(peer->endpoint, peer->port) & mask;
+    peer->next_by_endpoint = table->by_endpoint[bucket];
+    table->by_endpoint[bucket] = peer;
+}
+
+/**
+ * Allocates the buckets of the three indexes
+ * @param table
+ * @param bucket_count - uint32_t: power of 2
+ * @return True, if the buckets could be allocated
+ *         False, otherwise
+ */
+static bool allocate_buckets(struct PeerTable *table, uint32_t bucket_count) {
+    table->by_key = (struct Peer **) calloc(bucket_count, sizeof (struct Peer *));
+    table->by_address = (struct Peer **) calloc(bucket_count, sizeof (struct Peer *));
+    table->by_endpoint = (struct Peer **) calloc(bucket_count, sizeof (struct Peer *));
+    table->bucket_count = bucket_count;
+
+    if (table->by_key == NULL || table->by_address == NULL || table->by_endpoint == NULL) {
+        free(table->by_key);
+        free(table->by_address);
+        free(table->by_endpoint);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Doubles the number of buckets once the table holds more peers than buckets, so chains stay short
+ * @param table
+ */
+static void grow(struct PeerTable *table) {
+    struct PeerTable grown = *table;
+
+    if (!allocate_buckets(&grown, table->bucket_count * 2))
+        return;
+
+    free(table->by_key);
+    free(table->by_address);
+    free(table->by_endpoint);
+
+    table->by_key = grown.by_key;
+    table->by_address = grown.by_address;
+    table->by_endpoint = grown.by_endpoint;
+    table->bucket_count = grown.bucket_count;
+
+    for (struct Peer *peer = table->head; peer != NULL; peer = peer->next)
+        link_peer(table, peer);
+}
+
+/**
+ * Takes a peer from the free list, a new slab is allocated when the list is empty
+ * @param table
+ * @return *Peer, not linked anywhere
+ *         NULL, if the memory could not be allocated
+ */
+static struct Peer *take_peer(struct PeerTable *table) {
+    struct Peer *peer;
+
+    if (table->free_peers == NULL) {
+        struct PeerSlab *slab = (struct PeerSlab *) malloc(sizeof (struct PeerSlab));
+
+        if (slab == NULL)
+            return NULL;
+        slab->next = table->slabs;
+        table->slabs = slab;
+        for (uint32_t i = 0; i < PEER_SLAB_PEERS; i++) {
+            slab->peers[i].next = table->free_peers;
+            table->free_peers = &slab->peers[i];
+        }
+    }
+
+    peer = table->free_peers;
+    table->free_peers = peer->next;
+    return peer;
+}
+
+/**
+ * Copies a text field received from a client, the copy is always terminated and has no trailing whitespace
+ * @param destination - *char: buffer of @param destination_length bytes
+ * @param destination_length - size_t
+ * @param source - *char: field of at most @param source_length bytes, not necessarily terminated
+ * @param source_length - size_t
+ */
+void peer_table_copy_field(char *destination, size_t destination_length, const char *source, size_t source_length) {
+    size_t size = strnlen(source, source_length < destination_length ? source_length : destination_length - 1);
+
+    while (size > 0 && isspace((unsigned char) source[size - 1]))
+        size--;
+
+    memmove(destination, source, size);
+    destination[size] = '\0';
+}
+
+/**
+ * Checks the text fields of a peer before they can reach a config file: the public key is base64 of KEY_LENGTH bytes,
+ * the allowed IPs a list of addresses, the endpoint an address and the port a number from 1 to 65535
+ * @return True, if every field is valid
+ *         False, otherwise
+ */
+bool peer_table_valid_fields(const char *public_key, const char *allowed_ips, const char *endpoint, const char *port) {
+    uint8_t key[KEY_LENGTH];
+    struct in6_addr address;
+    char *end;
+    unsigned long number;
+
+    if (port[0] < '0' || port[0] > '9')
+        return false;
+    number = strtoul(port, &end, 10);
+    return *end == '\0' && number > 0 && number <= 65535 && address_valid_allowed_ips(allowed_ips) &&
+           key_from_base64(public_key, key) && address_parse(endpoint, &address);
+}
+
+/**
+ * Initializes an empty peer table
+ * @param table
+ * @param bucket_count - uint32_t: initial number of buckets, rounded up to a power of 2
+ * @return True, if the table could be initialized
+ *         False, otherwise
+ */
+bool peer_table_init(struct PeerTable *table, uint32_t bucket_count) {
+    uint32_t buckets = 1;
+
+    while (buckets < bucket_count)
+        buckets <<= 1;
+
+    table->count = 0;
+    table->head = NULL;
+    table->tail = NULL;
+    table->slabs = NULL;
+    table->free_peers = NULL;
+
+    return allocate_buckets(table, buckets);
+}
+
+/**
+ * Deletes all peers, detached ones included, and deallocates the indexes
+ * @param table
+ */
+void peer_table_destroy(struct PeerTable *table) {
+    struct PeerSlab *slab = table->slabs, *next;
+
+    while (slab != NULL) {
+        next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    free(table->by_key);
+    free(table->by_address);
+    free(table->by_endpoint);
+    table->head = NULL;
+    table->tail = NULL;
+    table->slabs = NULL;
+    table->free_peers = NULL;
+    table->count = 0;
+}
+
+/**
+ * Creates a peer and adds it to the table
+ * @param table
+ * @param public_key
+ * @param allowed_ips
+ * @param endpoint
+ * @param port
+ * @param address - *in6_addr: address leased to the peer
+ * @return *Peer that was added
+ *         NULL, if the memory could not be allocated
+ */
+struct Peer *peer_table_add(struct PeerTable *table, const char *public_key, const char *allowed_ips,
+                            const char *endpoint, const char *port, const struct in6_addr *address) {
+    struct Peer *peer = take_peer(table);
+
+    if (peer == NULL)
+        return NULL;
+
+    peer_table_copy_field(peer->public_key, PEER_PUBLIC_KEY_LENGTH, public_key, PEER_PUBLIC_KEY_LENGTH);
+    peer_table_copy_field(peer->allowed_ips, PEER_ALLOWED_IPS_LENGTH, allowed_ips, PEER_ALLOWED_IPS_LENGTH);
+    peer_table_copy_field(peer->endpoint, PEER_ENDPOINT_LENGTH, endpoint, PEER_ENDPOINT_LENGTH);
+    peer_table_copy_field(peer->port, PEER_PORT_LENGTH, port, PEER_PORT_LENGTH);
+    peer->key_valid = key_from_base64(peer->public_key, peer->key);
+    peer->address = *address;
+    peer->record = PEER_NO_RECORD;
+    peer->expires = 0;
+    timer_entry_init(&peer->expiry, peer);
+
+    peer->previous = table->tail;
+    peer->next = NULL;
+    if (table->tail == NULL)
+        table->head = peer;
+    else
+        table->tail->next = peer;
+    table->tail = peer;
+
+    link_peer(table, peer);
+    if (++table->count > table->bucket_count)
+        grow(table);
+
+    return peer;
+}
+
+/**
+ * Unlinks a peer from the indexes, the peer stays valid until it is released
+ * @param table
+ * @param peer - *Peer: peer that belongs to @param table
+ */
+void peer_table_detach(struct PeerTable *table, struct Peer *peer) {
+    uint32_t mask = table->bucket_count - 1;
+    struct Peer **link;
+
+    for (link = &table->by_key[hash_key(peer->public_key) & mask]; *link != peer; link = &(*link)->next_by_key);
+    *link = peer->next_by_key;
+
+    for (link = &table->by_address[address_hash(&peer->address) & mask]; *link != peer; link = &(*link)->next_by_address);
+    *link = peer->next_by_address;
+
+    for (link = &table->by_endpoint[hash_endpoint(peer->endpoint, peer->port) & mask]; *link != peer;
+         link = &(*link)->next_by_endpoint);
+    *link = peer->next_by_endpoint;
+
+    if (peer->previous == NULL)
+        table->head = peer->next;
+    else
+        peer->previous->next = peer->next;
+    if (peer->next == NULL)
+        table->tail = peer->previous;
+    else
+        peer->next->previous = peer->previous;
+
+    table->count--;
+}
+
+/**
+ * Unlinks a peer from the indexes and releases it
+ * @param table
+ * @param peer - *Peer: peer that belongs to @param table
+ */
+void peer_table_remove(struct PeerTable *table, struct Peer *peer) {
+    peer_table_detach(table, peer);
+    peer_table_release(table, peer);
+}
+
+/**
+ * Gives a detached peer back to the table, the next peer added can reuse it
+ * @param table
+ * @param peer - *Peer: peer detached from @param table
+ */
+void peer_table_release(struct PeerTable *table, struct Peer *peer) {
+    peer->next = table->free_peers;
+    table->free_peers = peer;
+}
+
+/**
+ * Finds peer by public key
+ * @param table
+ * @param public_key - *char: key without trailing whitespace
+ * @return *Peer, if found
+ *         NULL, otherwise
+ */
+struct Peer *peer_table_find_by_key(const struct PeerTable *table, const char *public_key) {
+    struct Peer *peer = table->by_key[hash_key(public_key) & (table->bucket_count - 1)];
+
+    while (peer != NULL && strcmp(peer->public_key, public_key) != 0)
+        peer = peer->next_by_key;
+
+    return peer;
+}
+
+/**
+ * Finds peer by leased address
+ * @param table
+ * @param address - *in6_addr: address, IPv4-mapped for IPv4
+ * @return *Peer, if found
+ *         NULL, otherwise
+ */
+struct Peer *peer_table_find_by_address(const struct PeerTable *table, const struct in6_addr *address) {
+    struct Peer *peer = table->by_address[address_hash(address) & (table->bucket_count - 1)];
+
+    while (peer != NULL && !address_equal(&peer->address, address))
+        peer = peer->next_by_address;
+
+    return peer;
+}
+
+/**
+ * Finds peer by real endpoint
+ * @param table
+ * @param endpoint - *char: endpoint without trailing whitespace
+ * @param port - *char: port without trailing whitespace
+ * @return *Peer, if found
+ *         NULL, otherwise
+ */
+struct Peer *peer_table_find_by_endpoint(const struct PeerTable *table, const char *endpoint, const char *port) {
+    struct Peer *peer = table->by_endpoint[hash_endpoint(endpoint, port) & (table->bucket_count - 1)];
+
+    while (peer != NULL && (strcmp(peer->endpoint, endpoint) != 0 || strcmp(peer->port, port) != 0))
+        peer = peer->next_by_endpoint;
+
+    return peer;
+}
@@ -0,0 +1,98 @@
+#ifndef DHCP_V1_PEER_TABLE_H
+#define DHCP_V1_PEER_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "address.h"
+#include "key.h"
+#include "timer_wheel.h"
+
+#define PEER_PUBLIC_KEY_LENGTH 256
+#define PEER_ALLOWED_IPS_LENGTH 256
+#define PEER_ENDPOINT_LENGTH INET6_ADDRSTRLEN
+#define PEER_PORT_LENGTH 10
+#define PEER_NO_RECORD UINT32_MAX
+#define PEER_SLAB_PEERS 256
+
+/**
+ * Peer structure:
+ *  - public_key - char[]: PUBLIC_KEY of the peer, without trailing whitespace
+ *  - key - uint8_t[]: public key decoded from base64, valid when key_valid is True
+ *  - allowed_ips - char[]: ips that the peer routes through the WireGuard tunnel
+ *  - endpoint - char[]: real endpoint of the peer
+ *  - port - char[]: port to which the peer WireGuard interface is listening
+ *  - address - in6_addr: address leased to the peer, IPv4-mapped for IPv4
+ *  - record - uint32_t: record of the lease in the lease database, PEER_NO_RECORD if it has none
+ *  - expires - uint32_t: when the lease expires, in seconds since the epoch, 0 if it never does
+ *  - expiry - TimerEntry: deadline of the lease in the expiry wheel
+ *  - next_by_key, next_by_address, next_by_endpoint - *Peer: chains of the hash indexes
+ *  - previous, next - *Peer: insertion order, used when the peers are written to the config file
+ */
+struct Peer {
+    char public_key[PEER_PUBLIC_KEY_LENGTH];
+    uint8_t key[KEY_LENGTH];
+    bool key_valid;
+    char allowed_ips[PEER_ALLOWED_IPS_LENGTH];
+    char endpoint[PEER_ENDPOINT_LENGTH];
+    char port[PEER_PORT_LENGTH];
+    struct in6_addr address;
+    uint32_t record;
+    uint32_t expires;
+    struct TimerEntry expiry;
+
+    struct Peer *next_by_key;
+    struct Peer *next_by_address;
+    struct Peer *next_by_endpoint;
+    struct Peer *previous;
+    struct Peer *next;
+};
+
+/**
+ * PeerSlab structure, a block of PEER_SLAB_PEERS peers allocated at once
+ *  - next - *PeerSlab: slab allocated before this one
+ *  - peers - Peer[]: peers of the slab
+ */
+struct PeerSlab {
+    struct PeerSlab *next;
+    struct Peer peers[PEER_SLAB_PEERS];
+};
+
+/**
+ * PeerTable structure. Peers are carved from slabs and go back to a free list when they are released, so once the
+ * table reached its largest size, adding and removing peers does not touch the heap.
+ *  - by_key, by_address, by_endpoint - **Peer: hash indexes on public key, leased address and endpoint:port
+ *  - bucket_count - uint32_t: number of buckets of every index, always a power of 2
+ *  - count - uint32_t: number of peers in the table
+ *  - head, tail - *Peer: first and last peer in insertion order
+ *  - slabs - *PeerSlab: every slab of the table, deallocated with it
+ *  - free_peers - *Peer: peers that can be reused, linked by next
+ */
+struct PeerTable {
+    struct Peer **by_key;
+    struct Peer **by_address;
+    struct Peer **by_endpoint;
+    uint32_t bucket_count;
+    uint32_t count;
+    struct Peer *head;
+    struct Peer *tail;
+    struct PeerSlab *slabs;
+    struct Peer *free_peers;
+};
+
+bool peer_table_init(struct PeerTable *table, uint32_t bucket_count);
+void peer_table_destroy(struct PeerTable *table);
+struct Peer *peer_table_add(struct PeerTable *table, const char *public_key, const char *allowed_ips,
+                            const char *endpoint, const char *port, const struct in6_addr *address);
+void peer_table_detach(struct PeerTable *table, struct Peer *peer);
+void peer_table_remove(struct PeerTable *table, struct Peer *peer);
+void peer_table_release(struct PeerTable *table, struct Peer *peer);
+struct Peer *peer_table_find_by_key(const struct PeerTable *table, const char *public_key);
+struct Peer *peer_table_find_by_address(const struct PeerTable *table, const struct in6_addr *address);
+struct Peer *peer_table_find_by_endpoint(const struct PeerTable *table, const char *endpoint, const char *port);
+void peer_table_copy_field(char *destination, size_t destination_length, const char *source, size_t source_length);
+bool peer_table_valid_fields(const char *public_key, const char *allowed_ips, const char *endpoint, const char *port);
+
+#endif //DHCP_V1_PEER_TABLE_H
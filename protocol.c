@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "protocol.h"
+
+/**
+ * Decodes a legacy struct Message. Short datagrams are accepted, the missing bytes are taken as zero.
+ */
+static bool decode_legacy(const void *datagram, size_t length, struct Request *request) {
+    struct Message message;
+
+    memset(&message, 0, sizeof (message));
+    memcpy(&message, datagram, length < sizeof (message) ? length : sizeof (message));
+
+    request->version = PROTOCOL_LEGACY_VERSION;
+    request->option = message.OPTION == OPTION_JOIN || message.OPTION == OPTION_LEAVE ? (uint8_t) message.OPTION
+                                                                                       : OPTION_INVALID;
+    request->request_id = 0;
+    request->pool = PROTOCOL_NO_POOL;
+    address_from_ipv4(&request->address, message.ADDRESS);
+    peer_table_copy_field(request->public_key, sizeof (request->public_key), message.PUBLIC_KEY,
+                          sizeof (message.PUBLIC_KEY));
+    peer_table_copy_field(request->allowed_ips, sizeof (request->allowed_ips), message.ALLOWED_IPS,
+                          sizeof (message.ALLOWED_IPS));
+    peer_table_copy_field(request->endpoint, sizeof (request->endpoint), message.ENDPOINT, sizeof (message.ENDPOINT));
+    peer_table_copy_field(request->port, sizeof (request->port), message.PORT, sizeof (message.PORT));
+    return request->option != OPTION_INVALID;
+}
+
+/**
+ * Decodes a version 2 request, no text is parsed: binary fields are only formatted for the config file
+ */
+static bool decode_v2(const void *datagram, size_t length, struct Request *request) {
+    const struct MessageV2 *message = (const struct MessageV2 *) datagram;
+    size_t allowed_ips_length;
+
+    if (length < sizeof (struct MessageV2) || message->version != PROTOCOL_VERSION)
+        return false;
+    if (message->option != OPTION_JOIN && message->option != OPTION_LEAVE && message->option != OPTION_RENEW)
+        return false;
+    if ((message->endpoint_family != ENDPOINT_FAMILY_IPV4 && message->endpoint_family != ENDPOINT_FAMILY_IPV6) ||
+        (message->address_family != ENDPOINT_FAMILY_IPV4 && message->address_family != ENDPOINT_FAMILY_IPV6))
+        return false;
+
+    allowed_ips_length = ntohs(message->allowed_ips_length);
+    if (allowed_ips_length > PROTOCOL_MAX_ALLOWED_IPS || length < sizeof (struct MessageV2) + allowed_ips_length)
+        return false;
+
+    request->version = PROTOCOL_VERSION;
+    request->option = message->option;
+    request->request_id = ntohl(message->request_id);
+    key_to_base64(message->public_key, request->public_key);
+
+    memcpy(request->allowed_ips, (const char *) datagram + sizeof (struct MessageV2), allowed_ips_length);
+    request->allowed_ips[allowed_ips_length] = '\0';
+
+    request->pool = PROTOCOL_NO_POOL;
+    if (length >= sizeof (struct MessageV2) + allowed_ips_length + sizeof (uint16_t)) {
+        uint16_t pool;
+
+        memcpy(&pool, (const char *) datagram + sizeof (struct MessageV2) + allowed_ips_length, sizeof (pool));
+        request->pool = ntohs(pool);
+    }
+
+    if (message->endpoint_family == ENDPOINT_FAMILY_IPV6)
+        inet_ntop(AF_INET6, message->endpoint, request->endpoint, sizeof (request->endpoint));
+    else
+        inet_ntop(AF_INET, message->endpoint, request->endpoint, sizeof (request->endpoint));
+    snprintf(request->port, sizeof (request->port), "%u", ntohs(message->port));
+
+    if (message->address_family == ENDPOINT_FAMILY_IPV4) {
+        in_addr_t address;
+
+        memcpy(&address, message->address, sizeof (in_addr_t));
+        address_from_ipv4(&request->address, address);
+    } else {
+        memcpy(&request->address, message->address, sizeof (struct in6_addr));
+    }
+    return true;
+}
+
+/**
+ * Checks the text fields of a join, they are written to the config file of the interface: the allowed IPs have to be a
+ * list of addresses with prefix lengths, the public key a WireGuard key, the endpoint an address and the port a number.
+ * Fields of version 2 requests other than the allowed IPs are formatted from binary and always pass.
+ */
+static bool valid_join(const struct Request *request) {
+    return peer_table_valid_fields(request->public_key, request->allowed_ips, request->endpoint, request->port);
+}
+
+/**
+ * Decodes a request of any version. Version 2 requests start with PROTOCOL_MAGIC, everything else is a legacy
+ * struct Message.
+ * @param datagram - *void: datagram as received
+ * @param length - size_t: length of the datagram
+ * @param request - *Request: where the decoded request is stored
+ * @return True, if the request is valid; the text fields of a join are checked, so they can be written to a config file
+ *         False, otherwise; the option of the request is then OPTION_INVALID
+ */
+bool protocol_decode(const void *datagram, size_t length, struct Request *request) {
+    uint32_t magic = 0;
+    bool valid;
+
+    if (length >= sizeof (magic))
+        memcpy(&magic, datagram, sizeof (magic));
+
+    if (ntohl(magic) == PROTOCOL_MAGIC)
+        valid = decode_v2(datagram, length, request);
+    else
+        valid = decode_legacy(datagram, length, request);
+    if (valid && request->option == OPTION_JOIN)
+        valid = valid_join(request);
+
+    if (!valid)
+        request->option = OPTION_INVALID;
+    return valid;
+}
+
+/**
+ * Encodes a version 2 request, used by clients
+ * @param request - *Request: text fields are converted to their binary form, the pool ID is only sent when it is not
+ *        PROTOCOL_NO_POOL
+ * @param buffer
+ * @param size - size_t: size of @param buffer
+ * @return length of the datagram
+ *         0, if a field is invalid or the buffer is too small
+ */
+size_t protocol_encode_request(const struct Request *request, void *buffer, size_t size) {
+    struct MessageV2 message;
+    size_t allowed_ips_length = strlen(request->allowed_ips);
+    size_t pool_length = request->pool == PROTOCOL_NO_POOL ? 0 : sizeof (uint16_t);
+    uint16_t pool = htons(request->pool);
+
+    if (allowed_ips_length > PROTOCOL_MAX_ALLOWED_IPS || size < sizeof (message) + allowed_ips_length + pool_length)
+        return 0;
+
+    memset(&message, 0, sizeof (message));
+    message.magic = htonl(PROTOCOL_MAGIC);
+    message.version = PROTOCOL_VERSION;
+    message.option = request->option;
+    message.request_id = htonl(request->request_id);
+    message.port = htons((uint16_t) atoi(request->port));
+    message.allowed_ips_length = htons((uint16_t) allowed_ips_length);
+
+    if (!key_from_base64(request->public_key, message.public_key))
+        return 0;
+
+    if (inet_pton(AF_INET, request->endpoint, message.endpoint) == 1)
+        message.endpoint_family = ENDPOINT_FAMILY_IPV4;
+    else if (inet_pton(AF_INET6, request->endpoint, message.endpoint) == 1)
+        message.endpoint_family = ENDPOINT_FAMILY_IPV6;
+    else
+        return 0;
+
+    if (address_is_ipv4(&request->address)) {
+        message.address_family = ENDPOINT_FAMILY_IPV4;
+        memcpy(message.address, &request->address.s6_addr[12], sizeof (in_addr_t));
+    } else {
+        message.address_family = ENDPOINT_FAMILY_IPV6;
+        memcpy(message.address, &request->address, sizeof (struct in6_addr));
+    }
+
+    memcpy(buffer, &message, sizeof (message));
+    memcpy((char *) buffer + sizeof (message), request->allowed_ips, allowed_ips_length);
+    memcpy((char *) buffer + sizeof (message) + allowed_ips_length, &pool, pool_length);
+    return sizeof (message) + allowed_ips_length + pool_length;
+}
+
+/**
+ * Encodes the single datagram that answers a version 2 request
+ * @param request - *Request: request being answered
+ * @param status - uint8_t: REPLY_OK, REPLY_POOL_EXHAUSTED or REPLY_NOT_LEASED
+ * @param address - *in6_addr: leased address, IPv4-mapped for IPv4
+ * @param prefix_length - int: mask of the network
+ * @param lease_time - uint32_t: seconds the lease is valid for, 0 if it never expires
+ * @param buffer
+ * @param size - size_t: size of @param buffer
+ * @return length of the datagram
+ *         0, if the buffer is too small
+ */
+size_t protocol_encode_reply(const struct Request *request, uint8_t status, const struct in6_addr *address, int prefix_length,
+                             uint32_t lease_time, void *buffer, size_t size) {
+    struct ReplyV2 reply;
+
+    if (size < sizeof (reply))
+        return 0;
+
+    memset(&reply, 0, sizeof (reply));
+    reply.magic = htonl(PROTOCOL_MAGIC);
+    reply.version = PROTOCOL_VERSION;
+    reply.status = status;
+    reply.prefix_length = (uint8_t) prefix_length;
+    reply.request_id = htonl(request->request_id);
+    reply.lease_time = htonl(lease_time);
+    if (address_is_ipv4(address)) {
+        reply.address_family = ENDPOINT_FAMILY_IPV4;
+        memcpy(reply.address, &address->s6_addr[12], sizeof (in_addr_t));
+    } else {
+        reply.address_family = ENDPOINT_FAMILY_IPV6;
+        memcpy(reply.address, address, sizeof (struct in6_addr));
+    }
+
+    memcpy(buffer, &reply, sizeof (reply));
+    return sizeof (reply);
+}
@@ -0,0 +1,112 @@
+#ifndef DHCP_V1_PROTOCOL_H
+#define DHCP_V1_PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "address.h"
+#include "key.h"
+#include "message.h"
+#include "peer_table.h"
+
+#define PROTOCOL_MAGIC 0x57474432u
+#define PROTOCOL_LEGACY_VERSION 1
+#define PROTOCOL_VERSION 2
+#define PROTOCOL_MAX_ALLOWED_IPS (PEER_ALLOWED_IPS_LENGTH - 1)
+#define PROTOCOL_MAX_DATAGRAM 640
+#define PROTOCOL_NO_POOL 0xFFFF
+
+#define OPTION_JOIN 0
+#define OPTION_LEAVE 1
+#define OPTION_RENEW 2
+#define OPTION_INVALID 255
+
+#define REPLY_OK 0
+#define REPLY_POOL_EXHAUSTED 1
+#define REPLY_NOT_LEASED 2
+
+#define ENDPOINT_FAMILY_IPV4 4
+#define ENDPOINT_FAMILY_IPV6 6
+
+/**
+ * MessageV2 structure, fixed part of a version 2 request, every field is in network byte order
+ *  - magic - uint32_t: PROTOCOL_MAGIC, tells version 2 requests apart from the legacy struct Message
+ *  - version - uint8_t: PROTOCOL_VERSION
+ *  - option - uint8_t: OPTION_JOIN, OPTION_LEAVE or OPTION_RENEW
+ *  - endpoint_family - uint8_t: ENDPOINT_FAMILY_IPV4 or ENDPOINT_FAMILY_IPV6
+ *  - address_family - uint8_t: family of address, ENDPOINT_FAMILY_IPV4 or ENDPOINT_FAMILY_IPV6
+ *  - request_id - uint32_t: chosen by the client, copied in the reply so retries can be matched
+ *  - public_key - uint8_t[32]: raw public key of the client
+ *  - endpoint - uint8_t[16]: real endpoint of the client, the first 4 bytes are used for IPv4
+ *  - port - uint16_t: port to which the client WireGuard interface is listening
+ *  - allowed_ips_length - uint16_t: length of the allowed ips text that follows this structure
+ *  - address - uint8_t[16]: address given back by OPTION_LEAVE or renewed by OPTION_RENEW
+ * The allowed ips text can be followed by a uint16_t pool ID, the interface the request is meant for when the server
+ * serves several of them.
+ */
+struct MessageV2 {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t option;
+    uint8_t endpoint_family;
+    uint8_t address_family;
+    uint32_t request_id;
+    uint8_t public_key[KEY_LENGTH];
+    uint8_t endpoint[16];
+    uint16_t port;
+    uint16_t allowed_ips_length;
+    uint8_t address[16];
+} __attribute__((packed));
+
+/**
+ * ReplyV2 structure, the single datagram that answers a version 2 request, every field is in network byte order
+ *  - magic - uint32_t: PROTOCOL_MAGIC
+ *  - version - uint8_t: PROTOCOL_VERSION
+ *  - status - uint8_t: REPLY_OK, REPLY_POOL_EXHAUSTED or REPLY_NOT_LEASED
+ *  - address_family - uint8_t: ENDPOINT_FAMILY_IPV4 or ENDPOINT_FAMILY_IPV6
+ *  - prefix_length - uint8_t: mask of the network the address belongs to, up to 128 for IPv6
+ *  - request_id - uint32_t: copied from the request
+ *  - lease_time - uint32_t: seconds the lease is valid for, 0 if it never expires
+ *  - address - uint8_t[16]: leased address, the first 4 bytes are used for IPv4
+ */
+struct ReplyV2 {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t status;
+    uint8_t address_family;
+    uint8_t prefix_length;
+    uint32_t request_id;
+    uint32_t lease_time;
+    uint8_t address[16];
+} __attribute__((packed));
+
+/**
+ * Request structure, a request of any version once decoded
+ *  - version - uint8_t: PROTOCOL_LEGACY_VERSION or PROTOCOL_VERSION
+ *  - option - uint8_t: OPTION_JOIN, OPTION_LEAVE, OPTION_RENEW or OPTION_INVALID
+ *  - request_id - uint32_t: 0 for legacy requests
+ *  - public_key - char[]: base64 public key, as written in the config file
+ *  - allowed_ips, endpoint, port - char[]: text fields, as written in the config file
+ *  - address - in6_addr: address given back by OPTION_LEAVE or renewed by OPTION_RENEW, IPv4-mapped for IPv4
+ *  - pool - uint16_t: pool ID sent by the client, PROTOCOL_NO_POOL if it sent none or for legacy requests
+ */
+struct Request {
+    uint8_t version;
+    uint8_t option;
+    uint32_t request_id;
+    char public_key[PEER_PUBLIC_KEY_LENGTH];
+    char allowed_ips[PEER_ALLOWED_IPS_LENGTH];
+    char endpoint[PEER_ENDPOINT_LENGTH];
+    char port[PEER_PORT_LENGTH];
+    struct in6_addr address;
+    uint16_t pool;
+};
+
+bool protocol_decode(const void *datagram, size_t length, struct Request *request);
+size_t protocol_encode_request(const struct Request *request, void *buffer, size_t size);
+size_t protocol_encode_reply(const struct Request *request, uint8_t status, const struct in6_addr *address, int prefix_length,
+                             uint32_t lease_time, void *buffer, size_t size);
+
+#endif //DHCP_V1_PROTOCOL_H
@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "response_cache.h"
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+static uint64_t hash_text(uint64_t hash, const char *text) {
+    for (; *text != '\0'; text++)
+        hash = (hash ^ (uint8_t) *text) * FNV_PRIME;
+    return (hash ^ 0xFF) * FNV_PRIME;
+}
+
+static uint64_t hash_request(const struct BatchRequest *request) {
+    uint64_t hash = FNV_OFFSET;
+
+    hash = hash_text(hash, request->request.public_key);
+    hash = hash_text(hash, request->request.endpoint);
+    return hash_text(hash, request->request.port);
+}
+
+static uint32_t home_slot(const struct ResponseCache *cache, uint64_t hash, uint32_t request_id) {
+    uint64_t mixed = (hash ^ request_id) * 0x9E3779B97F4A7C15ull;
+
+    return (uint32_t) (mixed >> 32) & cache->mask;
+}
+
+static bool matches(const struct CachedResponse *entry, uint64_t hash, const struct BatchRequest *request) {
+    return entry->in_use && entry->hash == hash && entry->request_id == request->request.request_id &&
+           entry->option == request->request.option && entry->source == request->from.sin_addr.s_addr &&
+           entry->source_port == request->from.sin_port;
+}
+
+/**
+ * Builds an empty cache
+ * @param cache
+ * @param entries - uint32_t: number of responses kept at once, rounded up to a power of 2
+ * @param ttl_ms - uint64_t: milliseconds a response is kept for, longer than the retry window of the clients
+ * @return True, if the entries could be allocated
+ *         False, otherwise
+ */
+bool response_cache_init(struct ResponseCache *cache, uint32_t entries, uint64_t ttl_ms) {
+    uint32_t size = RESPONSE_CACHE_PROBES;
+
+    while (size < entries && size < (1u << 31))
+        size <<= 1;
+
+    cache->mask = size - 1;
+    cache->ttl = ttl_ms * 1000000ull;
+    cache->entries = (struct CachedResponse *) calloc(size, sizeof (struct CachedResponse));
+    return cache->entries != NULL;
+}
+
+void response_cache_destroy(struct ResponseCache *cache) {
+    free(cache->entries);
+    cache->entries = NULL;
+}
+
+/**
+ * Looks up the response to a decoded request. Only version 2 requests are cached: legacy requests have no request id,
+ * so a retry cannot be told apart from a new request.
+ * @param cache
+ * @param request - *BatchRequest: on a hit, its status, lease time and address are those of the cached response
+ * @param now - uint64_t: CLOCK_MONOTONIC time, in nanoseconds
+ * @return True, if the request was answered before
+ *         False, otherwise
+ */
+bool response_cache_find(struct ResponseCache *cache, struct BatchRequest *request, uint64_t now) {
+    uint64_t hash;
+    uint32_t slot;
+
+    if (request->request.version == PROTOCOL_LEGACY_VERSION || request->request.option == OPTION_INVALID)
+        return false;
+
+    hash = hash_request(request);
+    slot = home_slot(cache, hash, request->request.request_id);
+    for (int i = 0; i < RESPONSE_CACHE_PROBES; i++, slot = (slot + 1) & cache->mask) {
+        const struct CachedResponse *entry = &cache->entries[slot];
+
+        if (!matches(entry, hash, request))
+            continue;
+        if (now - entry->stored > cache->ttl)
+            return false;
+
+        request->status = entry->status;
+        request->lease_time = entry->lease_time;
+        request->address = entry->address;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Keeps the response to a version 2 request that was answered
+ * @param cache
+ * @param request - *BatchRequest: request with its outcome
+ * @param now - uint64_t: CLOCK_MONOTONIC time, in nanoseconds
+ */
+void response_cache_store(struct ResponseCache *cache, const struct BatchRequest *request, uint64_t now) {
+    struct CachedResponse *chosen = NULL;
+    uint64_t hash;
+    uint32_t slot;
+
+    if (request->request.version == PROTOCOL_LEGACY_VERSION || request->request.option == OPTION_INVALID)
+        return;
+
+    hash = hash_request(request);
+    slot = home_slot(cache, hash, request->request.request_id);
+    for (int i = 0; i < RESPONSE_CACHE_PROBES; i++, slot = (slot + 1) & cache->mask) {
+        struct CachedResponse *entry = &cache->entries[slot];
+
+        if (matches(entry, hash, request) || !entry->in_use || now - entry->stored > cache->ttl) {
+            chosen = entry;
+            break;
+        }
+        if (chosen == NULL || entry->stored < chosen->stored)
+            chosen = entry;
+    }
+
+    *chosen = (struct CachedResponse) {
+            .hash = hash,
+            .request_id = request->request.request_id,
+            .option = request->request.option,
+            .source = request->from.sin_addr.s_addr,
+            .source_port = request->from.sin_port,
+            .in_use = true,
+            .status = request->status,
+            .lease_time = request->lease_time,
+            .address = request->address,
+            .stored = now,
+    };
+}
@@ -0,0 +1,57 @@
+#ifndef DHCP_V1_RESPONSE_CACHE_H
+#define DHCP_V1_RESPONSE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "batch.h"
+
+#define RESPONSE_CACHE_PROBES 4
+
+/**
+ * CachedResponse structure, the outcome of a version 2 request that was answered. A request matches it when the hash
+ * of its public key, endpoint and port, its request id, its option and the source of its datagram are the same.
+ *  - hash - uint64_t: hash of the public key, endpoint and port of the request
+ *  - request_id - uint32_t
+ *  - option - uint8_t
+ *  - source - in_addr_t, source_port - in_port_t: source of the datagram, in network byte order
+ *  - in_use - bool: True, if the entry holds a response
+ *  - status - uint8_t: status of the reply
+ *  - lease_time - uint32_t: lease time of the reply
+ *  - address - in6_addr: address of the reply
+ *  - stored - uint64_t: CLOCK_MONOTONIC time the response was stored at, in nanoseconds
+ */
+struct CachedResponse {
+    uint64_t hash;
+    uint32_t request_id;
+    uint8_t option;
+    in_addr_t source;
+    in_port_t source_port;
+    bool in_use;
+    uint8_t status;
+    uint32_t lease_time;
+    struct in6_addr address;
+    uint64_t stored;
+};
+
+/**
+ * ResponseCache structure, recent responses of a worker in a hash table of fixed size, so a retransmitted request is
+ * answered again without being applied again. An entry is looked up in RESPONSE_CACHE_PROBES slots from its home slot;
+ * a new response takes a free or expired slot, or the oldest one. Nothing is allocated after response_cache_init().
+ *  - entries - *CachedResponse: hash table
+ *  - mask - uint32_t: number of entries - 1, the number of entries is a power of 2
+ *  - ttl - uint64_t: nanoseconds a response is kept for
+ */
+struct ResponseCache {
+    struct CachedResponse *entries;
+    uint32_t mask;
+    uint64_t ttl;
+};
+
+bool response_cache_init(struct ResponseCache *cache, uint32_t entries, uint64_t ttl_ms);
+void response_cache_destroy(struct ResponseCache *cache);
+bool response_cache_find(struct ResponseCache *cache, struct BatchRequest *request, uint64_t now);
+void response_cache_store(struct ResponseCache *cache, const struct BatchRequest *request, uint64_t now);
+
+#endif //DHCP_V1_RESPONSE_CACHE_H
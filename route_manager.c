@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "route_manager.h"
+
+static const struct RouteBackend *BACKENDS[] = {
+        &NETLINK_ROUTE_BACKEND,
+        &STUB_ROUTE_BACKEND,
+};
+
+static bool stub_open(struct RouteManager *routes) {
+    (void) routes;
+    return true;
+}
+
+static size_t stub_apply(struct RouteManager *routes, const struct RouteChange *changes, size_t count) {
+    (void) routes;
+    (void) changes;
+    (void) count;
+    return 0;
+}
+
+static void stub_close(struct RouteManager *routes) {
+    (void) routes;
+}
+
+/**
+ * In process backend, routes are only counted. Used to exercise the request path without touching the routing table.
+ */
+const struct RouteBackend STUB_ROUTE_BACKEND = {
+        .name = "stub",
+        .open = stub_open,
+        .apply = stub_apply,
+        .close = stub_close,
+};
+
+/**
+ * Prepares the route manager of an interface
+ * @param routes
+ * @param backend_name - *char: "netlink" or "stub"
+ * @param interface_name - *char: interface the routes go through
+ * @return True, if the backend exists and could be opened
+ *         False, otherwise
+ */
+bool route_manager_init(struct RouteManager *routes, const char *backend_name, const char *interface_name) {
+    memset(routes, 0, sizeof (struct RouteManager));
+    snprintf(routes->interface_name, sizeof (routes->interface_name), "%s", interface_name);
+
+    for (size_t i = 0; i < sizeof (BACKENDS) / sizeof (BACKENDS[0]); i++)
+        if (strcmp(BACKENDS[i]->name, backend_name) == 0)
+            routes->backend = BACKENDS[i];
+
+    return routes->backend != NULL && routes->backend->open(routes);
+}
+
+void route_manager_destroy(struct RouteManager *routes) {
+    routes->backend->close(routes);
+}
+
+/**
+ * Adds and deletes host routes, the backend sends as many changes at once as it can
+ * @param routes
+ * @param changes - *RouteChange: routes to add or delete
+ * @param count - size_t: number of changes
+ * @return True, if every change was applied
+ *         False, otherwise
+ */
+bool route_manager_apply(struct RouteManager *routes, const struct RouteChange *changes, size_t count) {
+    size_t failed;
+
+    if (count == 0)
+        return true;
+
+    routes->applies++;
+    failed = routes->backend->apply(routes, changes, count);
+    routes->failures += failed;
+
+    for (size_t i = 0; i < count; i++) {
+        if (changes[i].remove)
+            routes->routes_removed++;
+        else
+            routes->routes_added++;
+    }
+    return failed == 0;
+}
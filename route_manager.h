@@ -0,0 +1,66 @@
+#ifndef DHCP_V1_ROUTE_MANAGER_H
+#define DHCP_V1_ROUTE_MANAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include "address.h"
+
+struct RouteManager;
+
+/**
+ * RouteChange structure, one host route through the interface that is added or deleted
+ *  - address - in6_addr: destination of the /32 route, or of the /128 route of an IPv6 address
+ *  - remove - bool: True, if the route is deleted
+ */
+struct RouteChange {
+    struct in6_addr address;
+    bool remove;
+};
+
+/**
+ * RouteBackend structure, the operations a backend provides
+ *  - name - *char: name used to select the backend
+ *  - open - function: prepares the backend for the given interface, returns False on failure
+ *  - apply - function: applies a list of route changes, returns the number of changes that failed
+ *  - close - function: releases what open allocated
+ */
+struct RouteBackend {
+    const char *name;
+    bool (*open)(struct RouteManager *routes);
+    size_t (*apply)(struct RouteManager *routes, const struct RouteChange *changes, size_t count);
+    void (*close)(struct RouteManager *routes);
+};
+
+/**
+ * RouteManager structure:
+ *  - backend - *RouteBackend: backend that programs the routes
+ *  - interface_name - char[]: interface the routes go through
+ *  - interface_index - unsigned int: index of the interface, 0 if the backend does not need it
+ *  - context - *void: private data of the backend
+ *  - applies - uint64_t: number of calls to the backend
+ *  - routes_added, routes_removed - uint64_t: number of routes added and deleted
+ *  - failures - uint64_t: number of route changes the backend could not apply
+ */
+struct RouteManager {
+    const struct RouteBackend *backend;
+    char interface_name[IF_NAMESIZE];
+    unsigned int interface_index;
+    void *context;
+    uint64_t applies;
+    uint64_t routes_added;
+    uint64_t routes_removed;
+    uint64_t failures;
+};
+
+extern const struct RouteBackend NETLINK_ROUTE_BACKEND;
+extern const struct RouteBackend STUB_ROUTE_BACKEND;
+
+bool route_manager_init(struct RouteManager *routes, const char *backend_name, const char *interface_name);
+void route_manager_destroy(struct RouteManager *routes);
+bool route_manager_apply(struct RouteManager *routes, const struct RouteChange *changes, size_t count);
+
+#endif //DHCP_V1_ROUTE_MANAGER_H
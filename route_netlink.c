@@ -0,0 +1,169 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+
+#include "route_manager.h"
+#include "netlink.h"
+#include "event_log.h"
+
+#define ROUTE_MESSAGES_PER_SEND 256
+
+/**
+ * RouteNetlinkContext structure:
+ *  - sock - int: rtnetlink socket
+ *  - sequence - uint32_t: sequence number of the last message sent
+ *  - results - int[]: outcome of every message of the last send
+ *  - buffer - NetlinkBuffer: buffer in which RTM_NEWROUTE and RTM_DELROUTE messages are built
+ */
+struct RouteNetlinkContext {
+    int sock;
+    uint32_t sequence;
+    int results[ROUTE_MESSAGES_PER_SEND];
+    struct NetlinkBuffer buffer;
+};
+
+/**
+ * Adds to the buffer the message of one route change, a /32 route for an IPv4 address or a /128 route for an IPv6 one
+ * @param routes
+ * @param context
+ * @param change
+ * @return True, if the message fits in the buffer
+ *         False, otherwise
+ */
+static bool put_route(struct RouteManager *routes, struct RouteNetlinkContext *context,
+                      const struct RouteChange *change) {
+    bool ipv4 = address_is_ipv4(&change->address);
+    struct rtmsg header = {
+            .rtm_family = ipv4 ? AF_INET : AF_INET6,
+            .rtm_dst_len = ipv4 ? 32 : 128,
+            .rtm_table = RT_TABLE_MAIN,
+            .rtm_protocol = RTPROT_STATIC,
+            .rtm_scope = RT_SCOPE_LINK,
+            .rtm_type = RTN_UNICAST,
+    };
+    uint16_t type = change->remove ? RTM_DELROUTE : RTM_NEWROUTE;
+    uint16_t flags = change->remove ? NLM_F_ACK : NLM_F_ACK | NLM_F_CREATE | NLM_F_REPLACE;
+    size_t offset = context->buffer.length;
+
+    if (!netlink_begin(&context->buffer, type, flags, context->sequence + 1, &header, sizeof (header)) ||
+        !(ipv4 ? netlink_put(&context->buffer, RTA_DST, &change->address.s6_addr[12], sizeof (in_addr_t))
+               : netlink_put(&context->buffer, RTA_DST, &change->address, sizeof (change->address))) ||
+        !netlink_put_u32(&context->buffer, RTA_OIF, routes->interface_index)) {
+        netlink_cancel(&context->buffer, offset);
+        return false;
+    }
+
+    netlink_end(&context->buffer);
+    context->sequence++;
+    return true;
+}
+
+/**
+ * Sends the messages in the buffer, a route that already exists or is already gone is not a failure
+ * @param context
+ * @param changes - *RouteChange: changes in the buffer
+ * @param count - size_t: number of messages in the buffer
+ * @return number of changes that failed
+ */
+static size_t flush_routes(struct RouteNetlinkContext *context, const struct RouteChange *changes, size_t count) {
+    uint32_t first = context->sequence - (uint32_t) count + 1;
+    size_t failed = 0;
+    int result;
+
+    if (count == 0)
+        return 0;
+
+    memset(context->results, 0, count * sizeof (int));
+    result = netlink_transact_each(context->sock, &context->buffer, first, context->sequence, context->results);
+    netlink_reset(&context->buffer);
+
+    if (result == 0)
+        return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int error = context->results[i];
+
+        if (error == 0 || (changes[i].remove && error == -ESRCH))
+            continue;
+
+        event_log(EVENT_LOG_WARNING, EVENT_ROUTE_FAILED, changes[i].remove, (uint32_t) -error, 0, &changes[i].address,
+                  NULL);
+        failed++;
+    }
+    /* the send itself failed, none of its routes was applied */
+    if (failed == 0 && result != -ESRCH) {
+        for (size_t i = 0; i < count; i++)
+            event_log(EVENT_LOG_WARNING, EVENT_ROUTE_FAILED, changes[i].remove, (uint32_t) -result, 0,
+                      &changes[i].address, NULL);
+        return count;
+    }
+    return failed;
+}
+
+static bool netlink_route_open(struct RouteManager *routes) {
+    struct RouteNetlinkContext *context;
+
+    routes->interface_index = if_nametoindex(routes->interface_name);
+    if (routes->interface_index == 0) {
+        perror("if_nametoindex() - netlink_route_open");
+        return false;
+    }
+
+    context = (struct RouteNetlinkContext *) malloc(sizeof (struct RouteNetlinkContext));
+    if (context == NULL)
+        return false;
+
+    context->sequence = 0;
+    context->sock = netlink_open(NETLINK_ROUTE, 0);
+    if (context->sock < 0) {
+        free(context);
+        return false;
+    }
+
+    netlink_reset(&context->buffer);
+    routes->context = context;
+    return true;
+}
+
+/**
+ * Applies the changes with as few sends as possible, a send carries up to ROUTE_MESSAGES_PER_SEND messages
+ */
+static size_t netlink_route_apply(struct RouteManager *routes, const struct RouteChange *changes, size_t count) {
+    struct RouteNetlinkContext *context = (struct RouteNetlinkContext *) routes->context;
+    size_t first = 0, failed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (i - first < ROUTE_MESSAGES_PER_SEND && put_route(routes, context, &changes[i]))
+            continue;
+
+        failed += flush_routes(context, &changes[first], i - first);
+        first = i;
+        if (!put_route(routes, context, &changes[i]))
+            return failed + count - i;
+    }
+
+    return failed + flush_routes(context, &changes[first], count - first);
+}
+
+static void netlink_route_close(struct RouteManager *routes) {
+    struct RouteNetlinkContext *context = (struct RouteNetlinkContext *) routes->context;
+
+    close(context->sock);
+    free(context);
+    routes->context = NULL;
+}
+
+/**
+ * Backend that programs host routes through rtnetlink, many route changes are sent with one system call. It needs
+ * CAP_NET_ADMIN in the network namespace of the interface, which an unprivileged user namespace provides.
+ */
+const struct RouteBackend NETLINK_ROUTE_BACKEND = {
+        .name = "netlink",
+        .open = netlink_route_open,
+        .apply = netlink_route_apply,
+        .close = netlink_route_close,
+};
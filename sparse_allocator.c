@@ -0,0 +1,176 @@
+#include <stdlib.h>
+
+#include "sparse_allocator.h"
+
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+#define SEQUENCE_MULTIPLIER 6364136223846793005ull
+#define SEQUENCE_INCREMENT 1442695040888963407ull
+
+static uint64_t home_slot(const struct SparseAllocator *allocator, uint64_t offset) {
+    uint64_t hash = offset * HASH_MULTIPLIER;
+
+    return (hash ^ hash >> 32) & (allocator->capacity - 1);
+}
+
+/**
+ * Next candidate of the sequence. The multiplier is 1 modulo 4 and the increment is odd, so modulo a power of 2 the
+ * sequence visits every offset of the space before it repeats.
+ */
+static uint64_t next_candidate(const struct SparseAllocator *allocator, uint64_t candidate) {
+    return (candidate * SEQUENCE_MULTIPLIER + SEQUENCE_INCREMENT) & allocator->mask;
+}
+
+/**
+ * Finds the slot of an offset, or the empty slot where it would be inserted
+ */
+static uint64_t find_slot(const struct SparseAllocator *allocator, uint64_t offset) {
+    uint64_t slot = home_slot(allocator, offset);
+
+    while (allocator->slots[slot] != SPARSE_ALLOCATOR_EMPTY && allocator->slots[slot] != offset)
+        slot = (slot + 1) & (allocator->capacity - 1);
+    return slot;
+}
+
+static uint64_t *allocate_slots(uint64_t capacity) {
+    uint64_t *slots = (uint64_t *) malloc(capacity * sizeof (uint64_t));
+
+    if (slots != NULL)
+        for (uint64_t i = 0; i < capacity; i++)
+            slots[i] = SPARSE_ALLOCATOR_EMPTY;
+    return slots;
+}
+
+/**
+ * Doubles the number of slots of the hash set
+ * @param allocator
+ * @return True, if the hash set could grow
+ *         False, otherwise
+ */
+static bool grow(struct SparseAllocator *allocator) {
+    uint64_t *old_slots = allocator->slots, old_capacity = allocator->capacity;
+    uint64_t *slots = allocate_slots(old_capacity * 2);
+
+    if (slots == NULL)
+        return false;
+
+    allocator->slots = slots;
+    allocator->capacity = old_capacity * 2;
+    for (uint64_t i = 0; i < old_capacity; i++)
+        if (old_slots[i] != SPARSE_ALLOCATOR_EMPTY)
+            allocator->slots[find_slot(allocator, old_slots[i])] = old_slots[i];
+
+    free(old_slots);
+    return true;
+}
+
+static bool insert(struct SparseAllocator *allocator, uint64_t offset) {
+    if (2 * (allocator->used + 1) > allocator->capacity && !grow(allocator))
+        return false;
+
+    allocator->slots[find_slot(allocator, offset)] = offset;
+    allocator->used++;
+    return true;
+}
+
+/**
+ * Builds an empty allocator
+ * @param allocator
+ * @param bits - int: the space holds 2^bits offsets, at most 64
+ * @return True, if the allocator could be built
+ *         False, otherwise
+ */
+bool sparse_allocator_init(struct SparseAllocator *allocator, int bits) {
+    if (bits < 0 || bits > 64)
+        return false;
+
+    allocator->mask = bits == 64 ? UINT64_MAX : ((uint64_t) 1 << bits) - 1;
+    allocator->used = 0;
+    allocator->cursor = 0;
+    allocator->retries = 0;
+    allocator->capacity = SPARSE_ALLOCATOR_INITIAL_CAPACITY;
+    allocator->slots = allocate_slots(allocator->capacity);
+    return allocator->slots != NULL;
+}
+
+void sparse_allocator_destroy(struct SparseAllocator *allocator) {
+    free(allocator->slots);
+    allocator->slots = NULL;
+    allocator->used = 0;
+}
+
+/**
+ * Takes the next free offset of the sequence
+ * @param allocator
+ * @param offset - *uint64_t: where the allocated offset is stored
+ * @return True, if an offset was allocated
+ *         False, if the space is exhausted or the hash set cannot grow
+ */
+bool sparse_allocator_allocate(struct SparseAllocator *allocator, uint64_t *offset) {
+    uint64_t available = allocator->mask == UINT64_MAX ? UINT64_MAX : allocator->mask + 1;
+
+    if (allocator->used >= available)
+        return false;
+
+    for (;;) {
+        uint64_t candidate = allocator->cursor = next_candidate(allocator, allocator->cursor);
+
+        if (candidate != SPARSE_ALLOCATOR_EMPTY && !sparse_allocator_is_allocated(allocator, candidate))
+            break;
+        allocator->retries++;
+    }
+
+    if (!insert(allocator, allocator->cursor))
+        return false;
+    *offset = allocator->cursor;
+    return true;
+}
+
+/**
+ * Marks a specific offset as allocated
+ * @param allocator
+ * @param offset - uint64_t: offset that needs to be reserved
+ * @return True, if the offset was free and is now allocated
+ *         False, if the offset is out of the space or already allocated
+ */
+bool sparse_allocator_reserve(struct SparseAllocator *allocator, uint64_t offset) {
+    if (offset > allocator->mask || offset == SPARSE_ALLOCATOR_EMPTY || sparse_allocator_is_allocated(allocator, offset))
+        return false;
+
+    return insert(allocator, offset);
+}
+
+/**
+ * Returns an offset to the space. The slots that follow are shifted back, so no deleted marker is left behind and
+ * lookups stay as short as if the offset had never been inserted.
+ * @param allocator
+ * @param offset - uint64_t: offset that needs to be released
+ * @return True, if the offset was allocated and is now free
+ *         False, otherwise
+ */
+bool sparse_allocator_release(struct SparseAllocator *allocator, uint64_t offset) {
+    uint64_t mask = allocator->capacity - 1, hole, slot;
+
+    if (offset == SPARSE_ALLOCATOR_EMPTY)
+        return false;
+    hole = find_slot(allocator, offset);
+    if (allocator->slots[hole] == SPARSE_ALLOCATOR_EMPTY)
+        return false;
+
+    for (slot = (hole + 1) & mask; allocator->slots[slot] != SPARSE_ALLOCATOR_EMPTY; slot = (slot + 1) & mask) {
+        uint64_t home = home_slot(allocator, allocator->slots[slot]);
+
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            allocator->slots[hole] = allocator->slots[slot];
+            hole = slot;
+        }
+    }
+    allocator->slots[hole] = SPARSE_ALLOCATOR_EMPTY;
+    allocator->used--;
+    return true;
+}
+
+bool sparse_allocator_is_allocated(const struct SparseAllocator *allocator, uint64_t offset) {
+    if (offset == SPARSE_ALLOCATOR_EMPTY)
+        return false;
+    return allocator->slots[find_slot(allocator, offset)] == offset;
+}
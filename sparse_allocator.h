@@ -0,0 +1,39 @@
+#ifndef DHCP_V1_SPARSE_ALLOCATOR_H
+#define DHCP_V1_SPARSE_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SPARSE_ALLOCATOR_INITIAL_CAPACITY 1024
+#define SPARSE_ALLOCATOR_EMPTY UINT64_MAX
+
+/**
+ * Allocator for spaces too large for a bitmap, such as the 2^64 offsets of an IPv6 /64. Only allocated offsets are
+ * kept, in an open addressing hash set. Candidates are taken from a full period linear congruential sequence over the
+ * space, so every offset is tried once before any is tried again and allocation is O(1) expected while the space is
+ * sparse.
+ *  - mask - uint64_t: offsets are in [0, mask], mask + 1 is a power of 2
+ *  - used - uint64_t: number of offsets allocated
+ *  - cursor - uint64_t: last candidate of the sequence
+ *  - retries - uint64_t: candidates skipped because they were already allocated
+ *  - slots - *uint64_t: hash set of the allocated offsets, SPARSE_ALLOCATOR_EMPTY marks an empty slot; the offset
+ *    SPARSE_ALLOCATOR_EMPTY itself is never allocated
+ *  - capacity - uint64_t: number of slots, a power of 2, kept at least twice used
+ */
+struct SparseAllocator {
+    uint64_t mask;
+    uint64_t used;
+    uint64_t cursor;
+    uint64_t retries;
+    uint64_t *slots;
+    uint64_t capacity;
+};
+
+bool sparse_allocator_init(struct SparseAllocator *allocator, int bits);
+void sparse_allocator_destroy(struct SparseAllocator *allocator);
+bool sparse_allocator_allocate(struct SparseAllocator *allocator, uint64_t *offset);
+bool sparse_allocator_reserve(struct SparseAllocator *allocator, uint64_t offset);
+bool sparse_allocator_release(struct SparseAllocator *allocator, uint64_t offset);
+bool sparse_allocator_is_allocated(const struct SparseAllocator *allocator, uint64_t offset);
+
+#endif //DHCP_V1_SPARSE_ALLOCATOR_H
@@ -0,0 +1,239 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "stats.h"
+
+static const char *COUNTER_NAMES[STATS_COUNTERS] = {
+        [STATS_REQUESTS_JOIN] = "requests_join",
+        [STATS_REQUESTS_LEAVE] = "requests_leave",
+        [STATS_REQUESTS_RENEW] = "requests_renew",
+        [STATS_REQUESTS_INVALID] = "requests_invalid",
+        [STATS_DROPPED_RATE_LIMITED] = "dropped_rate_limited",
+        [STATS_DROPPED_OVERLOADED] = "dropped_overloaded",
+        [STATS_RETRANSMITS_ANSWERED] = "retransmits_answered",
+        [STATS_POOL_EXHAUSTED] = "pool_exhausted",
+        [STATS_NOT_LEASED] = "not_leased",
+        [STATS_ALLOCATION_RETRIES] = "allocation_retries",
+        [STATS_ALLOCATION_STEALS] = "allocation_steals",
+        [STATS_LEASES_EXPIRED] = "leases_expired",
+        [STATS_PEERS_PROVISIONED] = "peers_provisioned",
+        [STATS_PEERS_DEPROVISIONED] = "peers_deprovisioned",
+        [STATS_BATCHES] = "batches",
+        [STATS_CONFIG_REWRITES] = "config_rewrites",
+        [STATS_CONFIG_APPENDS] = "config_appends",
+        [STATS_REFRESHES] = "refreshes",
+        [STATS_REFRESH_FAILURES] = "refresh_failures",
+        [STATS_ROUTE_FAILURES] = "route_failures",
+        [STATS_APPLY_STALLS] = "apply_stalls",
+        [STATS_DATAGRAMS_RECEIVED] = "datagrams_received",
+        [STATS_REPLIES_SENT] = "replies_sent",
+        [STATS_REPLIES_DROPPED] = "replies_dropped",
+        [STATS_POOL_SIZE] = "pool_size",
+        [STATS_POOL_USED] = "pool_used",
+        [STATS_PEERS] = "peers",
+        [STATS_APPLY_BACKLOG] = "apply_backlog",
+        [STATS_HEAP_ALLOCATIONS] = "heap_allocations",
+        [STATS_HEAP_FREES] = "heap_frees",
+        [STATS_CLUSTER_EVENTS_SENT] = "cluster_events_sent",
+        [STATS_CLUSTER_EVENTS_RECEIVED] = "cluster_events_received",
+        [STATS_CLUSTER_RETRANSMITS] = "cluster_retransmits",
+        [STATS_CLUSTER_RESYNCS] = "cluster_resyncs",
+        [STATS_CLUSTER_CONFLICTS] = "cluster_conflicts",
+        [STATS_CLUSTER_NODES_ALIVE] = "cluster_nodes_alive",
+};
+
+static const char *HISTOGRAM_NAMES[STATS_HISTOGRAMS] = {
+        [STATS_STAGE_RECEIVE] = "receive_ns",
+        [STATS_STAGE_DECODE] = "decode_ns",
+        [STATS_STAGE_ALLOCATE] = "allocate_ns",
+        [STATS_STAGE_APPLY] = "apply_requests_ns",
+        [STATS_STAGE_LEASE_SYNC] = "lease_sync_ns",
+        [STATS_STAGE_APPLY_QUEUE] = "apply_queue_ns",
+        [STATS_STAGE_CONFIG] = "config_write_ns",
+        [STATS_STAGE_REFRESH] = "refresh_ns",
+        [STATS_STAGE_ROUTES] = "routes_ns",
+        [STATS_STAGE_REPLY] = "reply_ns",
+        [STATS_STAGE_COMMIT] = "commit_ns",
+        [STATS_STAGE_EXPIRY] = "expiry_ns",
+        [STATS_BATCH_SIZE] = "batch_size",
+};
+
+/**
+ * Adds to a field that only the thread of the event loop writes. No read-modify-write instruction is needed, the
+ * store only has to be seen whole by readers.
+ */
+static void increase(uint64_t *field, uint64_t value) {
+    __atomic_store_n(field, __atomic_load_n(field, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static uint64_t load(const uint64_t *field) {
+    return __atomic_load_n(field, __ATOMIC_RELAXED);
+}
+
+void stats_init(struct Stats *stats) {
+    memset(stats, 0, sizeof (struct Stats));
+    for (int i = 0; i < STATS_HISTOGRAMS; i++)
+        histogram_reset(&stats->histograms[i]);
+    stats->started = stats_now();
+}
+
+/**
+ * @return CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t stats_now() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+void stats_add(struct Stats *stats, enum StatsCounter counter, uint64_t value) {
+    increase(&stats->counters[counter], value);
+}
+
+void stats_set(struct Stats *stats, enum StatsCounter counter, uint64_t value) {
+    __atomic_store_n(&stats->counters[counter], value, __ATOMIC_RELAXED);
+}
+
+void stats_record(struct Stats *stats, enum StatsHistogram histogram, uint64_t value) {
+    struct Histogram *destination = &stats->histograms[histogram];
+
+    increase(&destination->counts[histogram_bucket(value)], 1);
+    increase(&destination->count, 1);
+    increase(&destination->sum, value);
+    if (value < load(&destination->min))
+        __atomic_store_n(&destination->min, value, __ATOMIC_RELAXED);
+    if (value > load(&destination->max))
+        __atomic_store_n(&destination->max, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * Records the time spent in a stage
+ * @param stats
+ * @param histogram - StatsHistogram: stage that ends now
+ * @param started - uint64_t: value of stats_now() when the stage started
+ * @return current value of stats_now(), so the next stage can start from it
+ */
+uint64_t stats_record_since(struct Stats *stats, enum StatsHistogram histogram, uint64_t started) {
+    uint64_t now = stats_now();
+
+    stats_record(stats, histogram, now - started);
+    return now;
+}
+
+/**
+ * Copies the stats while the event loop keeps writing them. Every value is whole, but values are not taken at the
+ * same instant: the count of a histogram can be a few values off the sum of its buckets.
+ * @param stats
+ * @param snapshot - *Stats: where the copy is stored
+ */
+void stats_snapshot(const struct Stats *stats, struct Stats *snapshot) {
+    snapshot->started = stats->started;
+    for (int i = 0; i < STATS_COUNTERS; i++)
+        snapshot->counters[i] = load(&stats->counters[i]);
+
+    for (int i = 0; i < STATS_HISTOGRAMS; i++) {
+        const struct Histogram *source = &stats->histograms[i];
+        struct Histogram *destination = &snapshot->histograms[i];
+
+        for (uint32_t j = 0; j < HISTOGRAM_BUCKETS; j++)
+            destination->counts[j] = load(&source->counts[j]);
+        destination->count = load(&source->count);
+        destination->sum = load(&source->sum);
+        destination->min = load(&source->min);
+        destination->max = load(&source->max);
+    }
+}
+
+/**
+ * Adds the stats of another writer to a snapshot: counters are added, histograms merged
+ * @param destination - *Stats: snapshot that receives the values
+ * @param source - *Stats: snapshot of the other writer
+ */
+void stats_merge(struct Stats *destination, const struct Stats *source) {
+    if (source->started < destination->started)
+        destination->started = source->started;
+    for (int i = 0; i < STATS_COUNTERS; i++)
+        destination->counters[i] += source->counters[i];
+    for (int i = 0; i < STATS_HISTOGRAMS; i++)
+        histogram_merge(&destination->histograms[i], &source->histograms[i]);
+}
+
+/**
+ * Writes the stats as lines of text: one "name value" line per counter, then one line per histogram with its count,
+ * percentiles, extremes and mean
+ * @param snapshot
+ * @param fd - int: file descriptor written to
+ * @return True, if everything was written
+ *         False, otherwise
+ */
+bool stats_write_text(const struct Stats *snapshot, int fd) {
+    if (dprintf(fd, "uptime_ms %llu\n", (unsigned long long) ((stats_now() - snapshot->started) / 1000000)) < 0)
+        return false;
+
+    for (int i = 0; i < STATS_COUNTERS; i++)
+        if (dprintf(fd, "%s %llu\n", COUNTER_NAMES[i], (unsigned long long) snapshot->counters[i]) < 0)
+            return false;
+
+    for (int i = 0; i < STATS_HISTOGRAMS; i++) {
+        const struct Histogram *histogram = &snapshot->histograms[i];
+
+        if (dprintf(fd, "%s count=%llu min=%llu p50=%llu p90=%llu p99=%llu p999=%llu max=%llu mean=%llu\n",
+                    HISTOGRAM_NAMES[i], (unsigned long long) histogram->count,
+                    (unsigned long long) (histogram->count == 0 ? 0 : histogram->min),
+                    (unsigned long long) histogram_percentile(histogram, 50.0),
+                    (unsigned long long) histogram_percentile(histogram, 90.0),
+                    (unsigned long long) histogram_percentile(histogram, 99.0),
+                    (unsigned long long) histogram_percentile(histogram, 99.9),
+                    (unsigned long long) histogram->max,
+                    (unsigned long long) (histogram->count == 0 ? 0 : histogram->sum / histogram->count)) < 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the stats in binary form: a StatsBinaryHeader, the counters and the histograms
+ * @param snapshot
+ * @param fd - int: file descriptor written to
+ * @return True, if everything was written
+ *         False, otherwise
+ */
+bool stats_write_binary(const struct Stats *snapshot, int fd) {
+    struct StatsBinaryHeader header = {
+            .magic = STATS_BINARY_MAGIC,
+            .version = STATS_BINARY_VERSION,
+            .counter_count = STATS_COUNTERS,
+            .histogram_count = STATS_HISTOGRAMS,
+            .bucket_count = HISTOGRAM_BUCKETS,
+            .reserved = 0,
+            .uptime = stats_now() - snapshot->started,
+    };
+    struct iovec vectors[3] = {
+            {.iov_base = &header, .iov_len = sizeof (header)},
+            {.iov_base = (void *) snapshot->counters, .iov_len = sizeof (snapshot->counters)},
+            {.iov_base = (void *) snapshot->histograms, .iov_len = sizeof (snapshot->histograms)},
+    };
+    int current = 0;
+
+    while (current < 3) {
+        ssize_t written = writev(fd, &vectors[current], 3 - current);
+
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        while (current < 3 && (size_t) written >= vectors[current].iov_len)
+            written -= (ssize_t) vectors[current++].iov_len;
+        if (current < 3) {
+            vectors[current].iov_base = (char *) vectors[current].iov_base + written;
+            vectors[current].iov_len -= (size_t) written;
+        }
+    }
+    return true;
+}
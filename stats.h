@@ -0,0 +1,123 @@
+#ifndef DHCP_V1_STATS_H
+#define DHCP_V1_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+#define STATS_BINARY_MAGIC 0x54534757
+#define STATS_BINARY_VERSION 1
+
+/**
+ * Counters and gauges of the server. Gauges are set at the end of every commit, counters only grow.
+ */
+enum StatsCounter {
+    STATS_REQUESTS_JOIN,
+    STATS_REQUESTS_LEAVE,
+    STATS_REQUESTS_RENEW,
+    STATS_REQUESTS_INVALID,
+    STATS_DROPPED_RATE_LIMITED,
+    STATS_DROPPED_OVERLOADED,
+    STATS_RETRANSMITS_ANSWERED,
+    STATS_POOL_EXHAUSTED,
+    STATS_NOT_LEASED,
+    STATS_ALLOCATION_RETRIES,
+    STATS_ALLOCATION_STEALS,
+    STATS_LEASES_EXPIRED,
+    STATS_PEERS_PROVISIONED,
+    STATS_PEERS_DEPROVISIONED,
+    STATS_BATCHES,
+    STATS_CONFIG_REWRITES,
+    STATS_CONFIG_APPENDS,
+    STATS_REFRESHES,
+    STATS_REFRESH_FAILURES,
+    STATS_ROUTE_FAILURES,
+    STATS_APPLY_STALLS,
+    STATS_DATAGRAMS_RECEIVED,
+    STATS_REPLIES_SENT,
+    STATS_REPLIES_DROPPED,
+    STATS_POOL_SIZE,
+    STATS_POOL_USED,
+    STATS_PEERS,
+    STATS_APPLY_BACKLOG,
+    STATS_HEAP_ALLOCATIONS,
+    STATS_HEAP_FREES,
+    STATS_CLUSTER_EVENTS_SENT,
+    STATS_CLUSTER_EVENTS_RECEIVED,
+    STATS_CLUSTER_RETRANSMITS,
+    STATS_CLUSTER_RESYNCS,
+    STATS_CLUSTER_CONFLICTS,
+    STATS_CLUSTER_NODES_ALIVE,
+    STATS_COUNTERS
+};
+
+/**
+ * Histograms of the server, one per stage of the request path. Durations are in nanoseconds.
+ */
+enum StatsHistogram {
+    STATS_STAGE_RECEIVE,
+    STATS_STAGE_DECODE,
+    STATS_STAGE_ALLOCATE,
+    STATS_STAGE_APPLY,
+    STATS_STAGE_LEASE_SYNC,
+    STATS_STAGE_APPLY_QUEUE,
+    STATS_STAGE_CONFIG,
+    STATS_STAGE_REFRESH,
+    STATS_STAGE_ROUTES,
+    STATS_STAGE_REPLY,
+    STATS_STAGE_COMMIT,
+    STATS_STAGE_EXPIRY,
+    STATS_BATCH_SIZE,
+    STATS_HISTOGRAMS
+};
+
+/**
+ * Stats structure, written by one thread at a time: a worker writes its own stats, the stats of the shared state are
+ * written under its lock. Every field is updated with relaxed atomic stores, so a reader on another thread sees whole
+ * values without a lock and without slowing the writer down.
+ *  - started - uint64_t: CLOCK_MONOTONIC time the stats were reset at, in nanoseconds
+ *  - counters - uint64_t[]: indexed by StatsCounter
+ *  - histograms - Histogram[]: indexed by StatsHistogram
+ */
+struct Stats {
+    uint64_t started;
+    uint64_t counters[STATS_COUNTERS];
+    struct Histogram histograms[STATS_HISTOGRAMS];
+};
+
+/**
+ * StatsBinaryHeader structure, starts the binary form of the stats. It is followed by the counters, as uint64_t in
+ * the order of StatsCounter, then by the histograms in the order of StatsHistogram, each laid out as a Histogram.
+ * Values are in the byte order of the host.
+ *  - magic - uint32_t: STATS_BINARY_MAGIC
+ *  - version - uint16_t: STATS_BINARY_VERSION
+ *  - counter_count - uint16_t: number of counters that follow
+ *  - histogram_count - uint16_t: number of histograms that follow the counters
+ *  - bucket_count - uint16_t: number of buckets of every histogram
+ *  - reserved - uint32_t: 0
+ *  - uptime - uint64_t: nanoseconds since the stats were reset
+ */
+struct StatsBinaryHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t counter_count;
+    uint16_t histogram_count;
+    uint16_t bucket_count;
+    uint32_t reserved;
+    uint64_t uptime;
+};
+
+void stats_init(struct Stats *stats);
+uint64_t stats_now();
+void stats_add(struct Stats *stats, enum StatsCounter counter, uint64_t value);
+void stats_set(struct Stats *stats, enum StatsCounter counter, uint64_t value);
+void stats_record(struct Stats *stats, enum StatsHistogram histogram, uint64_t value);
+uint64_t stats_record_since(struct Stats *stats, enum StatsHistogram histogram, uint64_t started);
+void stats_snapshot(const struct Stats *stats, struct Stats *snapshot);
+void stats_merge(struct Stats *destination, const struct Stats *source);
+bool stats_write_text(const struct Stats *snapshot, int fd);
+bool stats_write_binary(const struct Stats *snapshot, int fd);
+
+#endif //DHCP_V1_STATS_H
@@ -0,0 +1,139 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "stats_socket.h"
+
+#define STATS_REQUEST_MAX_LENGTH 16
+#define STATS_CLIENT_TIMEOUT_MS 1000
+
+/**
+ * Answers one client. A client that sends nothing before the timeout or shuts down its side gets the text form.
+ * @param stats_socket
+ * @param client - int: connected socket
+ */
+static void serve_client(struct StatsSocket *stats_socket, int client) {
+    struct timeval timeout = {.tv_sec = STATS_CLIENT_TIMEOUT_MS / 1000, .tv_usec = STATS_CLIENT_TIMEOUT_MS % 1000 * 1000};
+    char request[STATS_REQUEST_MAX_LENGTH];
+    ssize_t length;
+
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+    length = recv(client, request, sizeof (request) - 1, 0);
+    request[length > 0 ? length : 0] = '\0';
+
+    stats_snapshot(stats_socket->sources[0], stats_socket->snapshot);
+    for (size_t i = 1; i < stats_socket->source_count; i++) {
+        stats_snapshot(stats_socket->sources[i], stats_socket->scratch);
+        stats_merge(stats_socket->snapshot, stats_socket->scratch);
+    }
+    if (strncmp(request, "binary", strlen("binary")) == 0)
+        stats_write_binary(stats_socket->snapshot, client);
+    else
+        stats_write_text(stats_socket->snapshot, client);
+}
+
+static void *serve_stats(void *argument) {
+    struct StatsSocket *stats_socket = (struct StatsSocket *) argument;
+    struct pollfd descriptors[2] = {
+            {.fd = stats_socket->fd, .events = POLLIN},
+            {.fd = stats_socket->stop, .events = POLLIN},
+    };
+
+    for (;;) {
+        int client;
+
+        if (poll(descriptors, 2, -1) < 0)
+            continue;
+        if (descriptors[1].revents != 0)
+            return NULL;
+        if (descriptors[0].revents == 0)
+            continue;
+
+        client = accept4(stats_socket->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0)
+            continue;
+        serve_client(stats_socket, client);
+        close(client);
+    }
+}
+
+/**
+ * Creates the stats socket and starts the thread that serves it. A socket file left behind by a previous run is replaced.
+ * @param stats_socket
+ * @param path - *char: path of the socket
+ * @param sources - **Stats: stats of every writer, the array is copied
+ * @param source_count - size_t: number of sources, at least 1
+ * @return True, if the socket is served
+ *         False, otherwise
+ */
+bool stats_socket_open(struct StatsSocket *stats_socket, const char *path, const struct Stats *const *sources,
+                       size_t source_count) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof (address.sun_path)) {
+        fprintf(stderr, "stats_socket_open - path of the socket is too long\n");
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    strcpy(stats_socket->path, path);
+    stats_socket->source_count = source_count;
+
+    stats_socket->sources = (const struct Stats **) malloc(source_count * sizeof (struct Stats *));
+    stats_socket->snapshot = (struct Stats *) malloc(sizeof (struct Stats));
+    stats_socket->scratch = (struct Stats *) malloc(sizeof (struct Stats));
+    if (stats_socket->sources == NULL || stats_socket->snapshot == NULL || stats_socket->scratch == NULL)
+        goto FREE;
+    memcpy(stats_socket->sources, sources, source_count * sizeof (struct Stats *));
+
+    stats_socket->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (stats_socket->fd < 0) {
+        perror("socket() - stats_socket_open");
+        goto FREE;
+    }
+
+    unlink(path);
+    if (bind(stats_socket->fd, (struct sockaddr *) &address, sizeof (address)) < 0 || listen(stats_socket->fd, 16) < 0) {
+        perror("bind() - stats_socket_open");
+        goto FAIL;
+    }
+
+    stats_socket->stop = eventfd(0, EFD_CLOEXEC);
+    if (stats_socket->stop < 0)
+        goto FAIL;
+    if (pthread_create(&stats_socket->thread, NULL, serve_stats, stats_socket) != 0) {
+        close(stats_socket->stop);
+        goto FAIL;
+    }
+    return true;
+
+    FAIL:
+    close(stats_socket->fd);
+    unlink(path);
+    FREE:
+    free(stats_socket->sources);
+    free(stats_socket->snapshot);
+    free(stats_socket->scratch);
+    return false;
+}
+
+/**
+ * Stops the thread, closes the socket and removes its file
+ * @param stats_socket
+ */
+void stats_socket_close(struct StatsSocket *stats_socket) {
+    eventfd_write(stats_socket->stop, 1);
+    pthread_join(stats_socket->thread, NULL);
+    close(stats_socket->stop);
+    close(stats_socket->fd);
+    unlink(stats_socket->path);
+    free(stats_socket->sources);
+    free(stats_socket->snapshot);
+    free(stats_socket->scratch);
+}
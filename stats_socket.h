@@ -0,0 +1,38 @@
+#ifndef DHCP_V1_STATS_SOCKET_H
+#define DHCP_V1_STATS_SOCKET_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/un.h>
+
+#include "stats.h"
+
+/**
+ * StatsSocket structure, UNIX domain stream socket served by its own thread. A client sends "text" or "binary" and
+ * gets the stats in that form, then the connection is closed. Nothing is sent to the event loops: the thread reads
+ * the stats while the workers keep writing them, and sends the sum of every source.
+ *  - fd - int: listening socket
+ *  - stop - int: eventfd that asks the thread to stop
+ *  - thread - pthread_t: thread that serves the socket
+ *  - sources - **Stats: stats of every writer
+ *  - source_count - size_t: number of sources
+ *  - snapshot - *Stats: sum of the sources, sent to the current client
+ *  - scratch - *Stats: copy of one source, added to snapshot
+ *  - path - char[]: path of the socket, removed when the socket is closed
+ */
+struct StatsSocket {
+    int fd;
+    int stop;
+    pthread_t thread;
+    const struct Stats **sources;
+    size_t source_count;
+    struct Stats *snapshot;
+    struct Stats *scratch;
+    char path[sizeof (((struct sockaddr_un *) 0)->sun_path)];
+};
+
+bool stats_socket_open(struct StatsSocket *stats_socket, const char *path, const struct Stats *const *sources,
+                       size_t source_count);
+void stats_socket_close(struct StatsSocket *stats_socket);
+
+#endif //DHCP_V1_STATS_SOCKET_H
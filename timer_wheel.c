@@ -0,0 +1,149 @@
+#include <string.h>
+
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * Links an entry in the slot that matches its deadline, deadlines beyond the last level wait in its farthest slot and
+ * are placed again when they cascade
+ * @param wheel
+ * @param entry - *TimerEntry: entry that is not in a slot, expires is at least wheel->now
+ */
+static void place(struct TimerWheel *wheel, struct TimerEntry *entry) {
+    struct TimerEntry **slot = NULL;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS && slot == NULL; level++) {
+        int shift = level * TIMER_WHEEL_SLOT_BITS;
+
+        if ((entry->expires >> shift) - (wheel->now >> shift) < TIMER_WHEEL_SLOTS)
+            slot = &wheel->slots[level][(entry->expires >> shift) & SLOT_MASK];
+    }
+    if (slot == NULL) {
+        int shift = (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_SLOT_BITS;
+        slot = &wheel->slots[TIMER_WHEEL_LEVELS - 1][((wheel->now >> shift) + SLOT_MASK) & SLOT_MASK];
+    }
+
+    entry->slot = slot;
+    entry->previous = NULL;
+    entry->next = *slot;
+    if (*slot != NULL)
+        (*slot)->previous = entry;
+    *slot = entry;
+}
+
+/**
+ * Takes an entry out of its slot
+ */
+static void unlink_entry(struct TimerEntry *entry) {
+    if (entry->previous != NULL)
+        entry->previous->next = entry->next;
+    else
+        *entry->slot = entry->next;
+    if (entry->next != NULL)
+        entry->next->previous = entry->previous;
+}
+
+/**
+ * Moves the entries of a slot of a higher level to the slots that match their deadline
+ */
+static void cascade(struct TimerWheel *wheel, int level, uint32_t slot) {
+    struct TimerEntry *entry = wheel->slots[level][slot], *next;
+
+    wheel->slots[level][slot] = NULL;
+    for (; entry != NULL; entry = next) {
+        next = entry->next;
+        place(wheel, entry);
+    }
+}
+
+/**
+ * Initializes an empty wheel
+ * @param wheel
+ * @param now - uint64_t: current tick
+ */
+void timer_wheel_init(struct TimerWheel *wheel, uint64_t now) {
+    memset(wheel->slots, 0, sizeof (wheel->slots));
+    wheel->now = now;
+    wheel->count = 0;
+}
+
+void timer_entry_init(struct TimerEntry *entry, void *data) {
+    entry->data = data;
+    entry->scheduled = false;
+    entry->slot = NULL;
+    entry->previous = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * Schedules an entry, an entry that is already scheduled is moved to its new deadline
+ * @param wheel
+ * @param entry
+ * @param expires - uint64_t: tick at which the entry expires, deadlines that already passed expire on the next tick
+ */
+void timer_wheel_schedule(struct TimerWheel *wheel, struct TimerEntry *entry, uint64_t expires) {
+    if (entry->scheduled)
+        timer_wheel_cancel(wheel, entry);
+
+    entry->expires = expires > wheel->now ? expires : wheel->now + 1;
+    entry->scheduled = true;
+    place(wheel, entry);
+    wheel->count++;
+}
+
+/**
+ * Takes an entry out of the wheel, entries that are not scheduled are ignored
+ * @param wheel
+ * @param entry
+ */
+void timer_wheel_cancel(struct TimerWheel *wheel, struct TimerEntry *entry) {
+    if (!entry->scheduled)
+        return;
+
+    unlink_entry(entry);
+    entry->scheduled = false;
+    entry->previous = NULL;
+    entry->next = NULL;
+    wheel->count--;
+}
+
+/**
+ * Advances the wheel tick by tick up to @param now
+ * @param wheel
+ * @param now - uint64_t: current tick, ticks in the past are ignored
+ * @return list of the expired entries, linked by next; they are no longer scheduled
+ *         NULL, if no entry expired
+ */
+struct TimerEntry *timer_wheel_advance(struct TimerWheel *wheel, uint64_t now) {
+    struct TimerEntry *expired = NULL, *entry, *next;
+
+    while (wheel->now < now) {
+        wheel->now++;
+
+        if (wheel->count == 0) {
+            wheel->now = now;
+            break;
+        }
+
+        for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            int shift = level * TIMER_WHEEL_SLOT_BITS;
+
+            if ((wheel->now & ((1ull << shift) - 1)) == 0)
+                cascade(wheel, level, (wheel->now >> shift) & SLOT_MASK);
+        }
+
+        entry = wheel->slots[0][wheel->now & SLOT_MASK];
+        wheel->slots[0][wheel->now & SLOT_MASK] = NULL;
+        for (; entry != NULL; entry = next) {
+            next = entry->next;
+            entry->scheduled = false;
+            entry->previous = NULL;
+            entry->next = expired;
+            expired = entry;
+            wheel->count--;
+        }
+    }
+
+    return expired;
+}
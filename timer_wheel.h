@@ -0,0 +1,47 @@
+#ifndef DHCP_V1_TIMER_WHEEL_H
+#define DHCP_V1_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+
+/**
+ * TimerEntry structure, a deadline kept by a timer wheel, embedded in the object it expires
+ *  - expires - uint64_t: tick at which the entry expires
+ *  - data - *void: object that expires
+ *  - scheduled - bool: True, while the entry is in a wheel
+ *  - slot - **TimerEntry: head of the slot the entry is in
+ *  - previous, next - *TimerEntry: entries of the same slot; next also links the entries returned by timer_wheel_advance()
+ */
+struct TimerEntry {
+    uint64_t expires;
+    void *data;
+    bool scheduled;
+    struct TimerEntry **slot;
+    struct TimerEntry *previous;
+    struct TimerEntry *next;
+};
+
+/**
+ * TimerWheel structure, hierarchical timer wheel: level i has TIMER_WHEEL_SLOTS slots of 64^i ticks each. Entries
+ * cascade to a lower level when the wheel reaches their slot, so scheduling, cancelling and expiring are O(1) amortized.
+ *  - now - uint64_t: last tick the wheel was advanced to
+ *  - count - uint32_t: number of scheduled entries
+ *  - slots - *TimerEntry[][]: entries of every slot of every level
+ */
+struct TimerWheel {
+    uint64_t now;
+    uint32_t count;
+    struct TimerEntry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+void timer_wheel_init(struct TimerWheel *wheel, uint64_t now);
+void timer_entry_init(struct TimerEntry *entry, void *data);
+void timer_wheel_schedule(struct TimerWheel *wheel, struct TimerEntry *entry, uint64_t expires);
+void timer_wheel_cancel(struct TimerWheel *wheel, struct TimerEntry *entry);
+struct TimerEntry *timer_wheel_advance(struct TimerWheel *wheel, uint64_t now);
+
+#endif //DHCP_V1_TIMER_WHEEL_H
@@ -0,0 +1,216 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "udp_socket.h"
+
+/**
+ * Opens a non blocking UDP socket bound to the given port on every address, it reports the local address of every
+ * datagram it receives
+ * @param udp
+ * @param port - uint16_t: port in host byte order
+ * @param receive_capacity - size_t: maximum number of datagrams received by one call
+ * @param send_capacity - size_t: maximum number of replies queued before a flush
+ * @param reuse_port - bool: True, if other sockets share the port; the kernel spreads the datagrams between them by
+ *        the hash of the source address, so every client keeps talking to the same socket
+ * @return True, if the socket is bound
+ *         False, otherwise
+ */
+bool udp_socket_open(struct UdpSocket *udp, uint16_t port, size_t receive_capacity, size_t send_capacity,
+                     bool reuse_port) {
+    struct sockaddr_in local;
+    int enable = 1;
+
+    memset(udp, 0, sizeof (struct UdpSocket));
+    udp->receive_capacity = receive_capacity;
+    udp->send_capacity = send_capacity;
+    udp->receive_headers = (struct mmsghdr *) calloc(receive_capacity, sizeof (struct mmsghdr));
+    udp->receive_vectors = (struct iovec *) calloc(receive_capacity, sizeof (struct iovec));
+    udp->receive_controls = (char (*)[UDP_CONTROL_LENGTH]) calloc(receive_capacity, UDP_CONTROL_LENGTH);
+    udp->replies = (struct UdpReply *) calloc(send_capacity, sizeof (struct UdpReply));
+    udp->send_headers = (struct mmsghdr *) calloc(send_capacity, sizeof (struct mmsghdr));
+    udp->send_vectors = (struct iovec *) calloc(send_capacity, sizeof (struct iovec));
+    udp->send_controls = (char (*)[UDP_CONTROL_LENGTH]) calloc(send_capacity, UDP_CONTROL_LENGTH);
+    udp->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+
+    if (udp->receive_headers == NULL || udp->receive_vectors == NULL || udp->receive_controls == NULL ||
+        udp->replies == NULL || udp->send_headers == NULL || udp->send_vectors == NULL || udp->send_controls == NULL ||
+        udp->fd < 0) {
+        udp_socket_close(udp);
+        return false;
+    }
+
+    if (setsockopt(udp->fd, IPPROTO_IP, IP_PKTINFO, &enable, sizeof (enable)) < 0 ||
+        (reuse_port && setsockopt(udp->fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof (enable)) < 0)) {
+        udp_socket_close(udp);
+        return false;
+    }
+
+    memset(&local, 0, sizeof (local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(udp->fd, (struct sockaddr *) &local, sizeof (local)) < 0) {
+        udp_socket_close(udp);
+        return false;
+    }
+    return true;
+}
+
+void udp_socket_close(struct UdpSocket *udp) {
+    if (udp->fd >= 0)
+        close(udp->fd);
+    free(udp->receive_headers);
+    free(udp->receive_vectors);
+    free(udp->receive_controls);
+    free(udp->replies);
+    free(udp->send_headers);
+    free(udp->send_vectors);
+    free(udp->send_controls);
+    udp->fd = -1;
+}
+
+/**
+ * @return local address a datagram was received on, INADDR_ANY if its header does not tell
+ */
+static struct in_addr local_address(struct msghdr *header) {
+    struct in_addr address = {.s_addr = htonl(INADDR_ANY)};
+
+    for (struct cmsghdr *control = CMSG_FIRSTHDR(header); control != NULL; control = CMSG_NXTHDR(header, control)) {
+        if (control->cmsg_level == IPPROTO_IP && control->cmsg_type == IP_PKTINFO) {
+            struct in_pktinfo information;
+
+            memcpy(&information, CMSG_DATA(control), sizeof (information));
+            address = information.ipi_spec_dst;
+        }
+    }
+    return address;
+}
+
+/**
+ * Receives with one system call as many datagrams as the batch still has room for. Every datagram becomes a request
+ * of the batch, with the local address it was received on.
+ * @param udp
+ * @param batch
+ * @return number of datagrams received, 0 if none was waiting
+ *         -1, on failure
+ */
+int udp_receive(struct UdpSocket *udp, struct Batch *batch) {
+    size_t wanted = batch->capacity - batch->count;
+    int received;
+
+    if (wanted > udp->receive_capacity)
+        wanted = udp->receive_capacity;
+    if (wanted == 0)
+        return 0;
+
+    for (size_t i = 0; i < wanted; i++) {
+        struct BatchRequest *request = &batch->requests[batch->count + i];
+
+        udp->receive_vectors[i].iov_base = request->datagram;
+        udp->receive_vectors[i].iov_len = sizeof (request->datagram);
+        memset(&udp->receive_headers[i].msg_hdr, 0, sizeof (struct msghdr));
+        udp->receive_headers[i].msg_hdr.msg_name = &request->from;
+        udp->receive_headers[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+        udp->receive_headers[i].msg_hdr.msg_iov = &udp->receive_vectors[i];
+        udp->receive_headers[i].msg_hdr.msg_iovlen = 1;
+        udp->receive_headers[i].msg_hdr.msg_control = udp->receive_controls[i];
+        udp->receive_headers[i].msg_hdr.msg_controllen = UDP_CONTROL_LENGTH;
+    }
+
+    received = recvmmsg(udp->fd, udp->receive_headers, (unsigned int) wanted, MSG_DONTWAIT, NULL);
+    if (received < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < received; i++) {
+        struct BatchRequest *request = batch_next_request(batch);
+
+        request->length = udp->receive_headers[i].msg_len;
+        request->from_length = udp->receive_headers[i].msg_hdr.msg_namelen;
+        request->destination = local_address(&udp->receive_headers[i].msg_hdr);
+        batch_push(batch);
+    }
+
+    udp->received += (uint64_t) received;
+    return received;
+}
+
+/**
+ * Queues a datagram, it is sent by the next flush. The queue is flushed first when it is full.
+ * @param udp
+ * @param to
+ * @param to_length
+ * @param source - in_addr: local address the datagram is sent from, INADDR_ANY to let the kernel choose
+ * @param data
+ * @param length - size_t: at most UDP_REPLY_MAX_LENGTH bytes
+ */
+void udp_queue_reply(struct UdpSocket *udp, const struct sockaddr_in *to, socklen_t to_length, struct in_addr source,
+                     const void *data, size_t length) {
+    struct UdpReply *reply;
+
+    if (length > UDP_REPLY_MAX_LENGTH)
+        return;
+    if (udp->send_count == udp->send_capacity)
+        udp_flush(udp);
+
+    reply = &udp->replies[udp->send_count++];
+    reply->to = *to;
+    reply->to_length = to_length;
+    reply->source = source;
+    reply->length = length;
+    memcpy(reply->data, data, length);
+}
+
+/**
+ * Sends every queued datagram with as few sendmmsg() calls as possible. Datagrams the socket can not take right away
+ * are dropped, clients retry their requests.
+ * @param udp
+ */
+void udp_flush(struct UdpSocket *udp) {
+    size_t sent = 0;
+
+    for (size_t i = 0; i < udp->send_count; i++) {
+        udp->send_vectors[i].iov_base = udp->replies[i].data;
+        udp->send_vectors[i].iov_len = udp->replies[i].length;
+        memset(&udp->send_headers[i].msg_hdr, 0, sizeof (struct msghdr));
+        udp->send_headers[i].msg_hdr.msg_name = &udp->replies[i].to;
+        udp->send_headers[i].msg_hdr.msg_namelen = udp->replies[i].to_length;
+        udp->send_headers[i].msg_hdr.msg_iov = &udp->send_vectors[i];
+        udp->send_headers[i].msg_hdr.msg_iovlen = 1;
+
+        if (udp->replies[i].source.s_addr != htonl(INADDR_ANY)) {
+            struct in_pktinfo information = {.ipi_ifindex = 0, .ipi_spec_dst = udp->replies[i].source};
+            struct msghdr *header = &udp->send_headers[i].msg_hdr;
+            struct cmsghdr *control;
+
+            header->msg_control = udp->send_controls[i];
+            header->msg_controllen = UDP_CONTROL_LENGTH;
+            control = CMSG_FIRSTHDR(header);
+            control->cmsg_level = IPPROTO_IP;
+            control->cmsg_type = IP_PKTINFO;
+            control->cmsg_len = CMSG_LEN(sizeof (information));
+            memcpy(CMSG_DATA(control), &information, sizeof (information));
+        }
+    }
+
+    while (sent < udp->send_count) {
+        int result = sendmmsg(udp->fd, udp->send_headers + sent, (unsigned int) (udp->send_count - sent), 0);
+
+        if (result < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                perror("sendmmsg() - udp_flush");
+            /* the datagram at the head of the queue is dropped, the rest is still tried */
+            udp->dropped++;
+            sent++;
+            continue;
+        }
+        sent += (size_t) result;
+        udp->sent += (uint64_t) result;
+    }
+
+    udp->send_count = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef DHCP_V1_UDP_SOCKET_H
+#define DHCP_V1_UDP_SOCKET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "batch.h"
+
+#define UDP_REPLY_MAX_LENGTH 64
+#define UDP_CONTROL_LENGTH CMSG_SPACE(sizeof (struct in_pktinfo))
+
+/**
+ * UdpReply structure, a datagram waiting to be flushed
+ *  - to - sockaddr_in: destination of the datagram
+ *  - to_length - socklen_t: length of to
+ *  - source - in_addr: local address the datagram is sent from, INADDR_ANY to let the kernel choose
+ *  - length - size_t: bytes used in data
+ *  - data - char[]: payload
+ */
+struct UdpReply {
+    struct sockaddr_in to;
+    socklen_t to_length;
+    struct in_addr source;
+    size_t length;
+    char data[UDP_REPLY_MAX_LENGTH];
+};
+
+/**
+ * UdpSocket structure, non blocking socket that receives and sends datagrams in batches. The local address of every
+ * datagram is received with it, so that a reply leaves from the address its request was sent to.
+ *  - fd - int: socket
+ *  - receive_headers, receive_vectors, receive_controls - used by recvmmsg(), one per request slot of a batch
+ *  - receive_capacity - size_t: maximum number of datagrams received by one call
+ *  - replies - *UdpReply: datagrams queued since the last flush
+ *  - send_headers, send_vectors, send_controls - used by sendmmsg(), one per queued reply
+ *  - send_capacity - size_t: maximum number of queued replies, the queue is flushed when full
+ *  - send_count - size_t: number of queued replies
+ *  - received, sent, dropped - uint64_t: datagrams received, sent and replies that could not be sent
+ */
+struct UdpSocket {
+    int fd;
+    struct mmsghdr *receive_headers;
+    struct iovec *receive_vectors;
+    char (*receive_controls)[UDP_CONTROL_LENGTH];
+    size_t receive_capacity;
+
+    struct UdpReply *replies;
+    struct mmsghdr *send_headers;
+    struct iovec *send_vectors;
+    char (*send_controls)[UDP_CONTROL_LENGTH];
+    size_t send_capacity;
+    size_t send_count;
+
+    uint64_t received;
+    uint64_t sent;
+    uint64_t dropped;
+};
+
+bool udp_socket_open(struct UdpSocket *udp, uint16_t port, size_t receive_capacity, size_t send_capacity,
+                     bool reuse_port);
+void udp_socket_close(struct UdpSocket *udp);
+int udp_receive(struct UdpSocket *udp, struct Batch *batch);
+void udp_queue_reply(struct UdpSocket *udp, const struct sockaddr_in *to, socklen_t to_length, struct in_addr source,
+                     const void *data, size_t length);
+void udp_flush(struct UdpSocket *udp);
+
+#endif //DHCP_V1_UDP_SOCKET_H
@@ -0,0 +1,265 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+#include "wg_config.h"
+#include "address.h"
+
+#define WG_CONFIG_INITIAL_LINES 64
+#define WG_CONFIG_INITIAL_PEERS 16
+
+static const struct {
+    const char *name;
+    enum WgConfigKey kind;
+} KEYS[] = {
+        {"Address", WG_CONFIG_KEY_ADDRESS},
+        {"AutoConfigurable", WG_CONFIG_KEY_AUTO_CONFIGURABLE},
+        {"SaveConfig", WG_CONFIG_KEY_SAVE_CONFIG},
+        {"PublicKey", WG_CONFIG_KEY_PUBLIC_KEY},
+        {"AllowedIPs", WG_CONFIG_KEY_ALLOWED_IPS},
+        {"Endpoint", WG_CONFIG_KEY_ENDPOINT},
+};
+
+/**
+ * Reads the whole file with as few system calls as its size allows
+ * @return True, if the file was read
+ *         False, otherwise
+ */
+static bool read_file(struct WgConfig *config, const char *path) {
+    struct stat status;
+    size_t capacity;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+    capacity = fstat(fd, &status) == 0 && status.st_size > 0 ? (size_t) status.st_size + 1 : 4096;
+    config->text = (char *) malloc(capacity);
+
+    while (config->text != NULL) {
+        ssize_t length;
+
+        if (config->length + 1 == capacity) {
+            char *text = (char *) realloc(config->text, capacity * 2);
+
+            if (text == NULL)
+                break;
+            config->text = text;
+            capacity *= 2;
+        }
+
+        length = read(fd, config->text + config->length, capacity - 1 - config->length);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0) {
+            close(fd);
+            config->text[config->length] = '\0';
+            return length == 0;
+        }
+        config->length += (size_t) length;
+    }
+    close(fd);
+    return false;
+}
+
+static char *trim(char *text) {
+    char *end = text + strlen(text);
+
+    while (*text == ' ' || *text == '\t')
+        text++;
+    while (end > text && isspace((unsigned char) end[-1]))
+        end--;
+    *end = '\0';
+    return text;
+}
+
+static enum WgConfigKey key_kind(const char *key) {
+    for (size_t i = 0; i < sizeof (KEYS) / sizeof (KEYS[0]); i++)
+        if (strcasecmp(key, KEYS[i].name) == 0)
+            return KEYS[i].kind;
+    return WG_CONFIG_KEY_OTHER;
+}
+
+/**
+ * Splits a "Key = value" line in place. Keys are made of letters only, so a line such as a bare base64 key, which ends
+ * with '=', is left whole.
+ * @return True, if the line is a "Key = value" line
+ *         False, otherwise
+ */
+static bool split_line(struct WgConfigLine *line) {
+    char *separator = strchr(line->key, '='), *end;
+
+    if (separator == NULL || separator == line->key)
+        return false;
+    for (end = separator; end > line->key && (end[-1] == ' ' || end[-1] == '\t'); end--);
+    if (end == line->key)
+        return false;
+    for (char *current = line->key; current < end; current++)
+        if (!isalpha((unsigned char) *current))
+            return false;
+
+    *end = '\0';
+    line->value = trim(separator + 1);
+    line->kind = key_kind(line->key);
+    return true;
+}
+
+/**
+ * Reads the first address of an Address value, "10.0.0.1/24, fd00::1/64" gives 10.0.0.1/24. An address without mask
+ * is a host address.
+ */
+static bool parse_address(struct WgConfig *config, const char *value) {
+    char text[INET6_ADDRSTRLEN + 8], *mask, *end;
+    size_t length = strcspn(value, ",");
+    long prefix_length;
+
+    if (length >= sizeof (text))
+        return false;
+    memcpy(text, value, length);
+    text[length] = '\0';
+
+    mask = strchr(text, '/');
+    if (mask != NULL)
+        *mask++ = '\0';
+    if (!address_parse(trim(text), &config->address))
+        return false;
+
+    if (mask == NULL) {
+        config->prefix_length = address_is_ipv4(&config->address) ? 32 : 128;
+    } else {
+        prefix_length = strtol(mask, &end, 10);
+        if (end == mask || *trim(end) != '\0' || prefix_length < 0 ||
+            prefix_length > (address_is_ipv4(&config->address) ? 32 : 128))
+            return false;
+        config->prefix_length = (int) prefix_length;
+    }
+    config->has_address = true;
+    return true;
+}
+
+static bool add_line(struct WgConfig *config, size_t *capacity, char *text) {
+    if (config->line_count == *capacity) {
+        struct WgConfigLine *lines = (struct WgConfigLine *) realloc(config->lines,
+                                                                     *capacity * 2 * sizeof (struct WgConfigLine));
+        if (lines == NULL)
+            return false;
+        config->lines = lines;
+        *capacity *= 2;
+    }
+    config->lines[config->line_count++] = (struct WgConfigLine) {.key = trim(text), .kind = WG_CONFIG_KEY_NONE};
+    return true;
+}
+
+static bool add_peer(struct WgConfig *config, size_t *capacity) {
+    if (config->peer_count == *capacity) {
+        struct WgConfigPeer *peers = (struct WgConfigPeer *) realloc(config->peers,
+                                                                     *capacity * 2 * sizeof (struct WgConfigPeer));
+        if (peers == NULL)
+            return false;
+        config->peers = peers;
+        *capacity *= 2;
+    }
+    config->peers[config->peer_count++] = (struct WgConfigPeer) {.line = config->line_count - 1};
+    return true;
+}
+
+/**
+ * Gives a line its section and its meaning. Only the first Address of the [Interface] section is used.
+ */
+static bool parse_line(struct WgConfig *config, size_t *peer_capacity, enum WgConfigSection *section) {
+    struct WgConfigLine *line = &config->lines[config->line_count - 1];
+    struct WgConfigPeer *peer = config->peer_count > 0 ? &config->peers[config->peer_count - 1] : NULL;
+
+    if (line->key[0] == '[') {
+        if (strcasecmp(line->key, "[Interface]") == 0)
+            *section = WG_CONFIG_SECTION_INTERFACE;
+        else if (strcasecmp(line->key, "[Peer]") == 0)
+            *section = WG_CONFIG_SECTION_PEER;
+        else
+            *section = WG_CONFIG_SECTION_OTHER;
+        line->section = *section;
+        return *section != WG_CONFIG_SECTION_PEER || add_peer(config, peer_capacity);
+    }
+
+    line->section = *section;
+    if (line->key[0] == '#' || !split_line(line))
+        return true;
+
+    switch (line->kind) {
+        case WG_CONFIG_KEY_ADDRESS:
+            if (*section <= WG_CONFIG_SECTION_INTERFACE && !config->has_address && !parse_address(config, line->value)) {
+                fprintf(stderr, "wg_config_load - line %zu - invalid address %s\n", config->line_count, line->value);
+                return false;
+            }
+            break;
+        case WG_CONFIG_KEY_AUTO_CONFIGURABLE:
+            if (*section <= WG_CONFIG_SECTION_INTERFACE)
+                config->auto_configurable = strcasecmp(line->value, "true") == 0;
+            break;
+        case WG_CONFIG_KEY_PUBLIC_KEY:
+            if (*section == WG_CONFIG_SECTION_PEER)
+                peer->public_key = line->value;
+            break;
+        case WG_CONFIG_KEY_ALLOWED_IPS:
+            if (*section == WG_CONFIG_SECTION_PEER)
+                peer->allowed_ips = line->value;
+            break;
+        case WG_CONFIG_KEY_ENDPOINT:
+            if (*section == WG_CONFIG_SECTION_PEER)
+                peer->endpoint = line->value;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+/**
+ * Reads a wg-quick config file once and parses it in one pass. Blank lines, comments and lines of any length are
+ * accepted.
+ * @param config
+ * @param path - *char: config file
+ * @return True, if the file was read and its address, if any, is valid
+ *         False, otherwise
+ */
+bool wg_config_load(struct WgConfig *config, const char *path) {
+    enum WgConfigSection section = WG_CONFIG_SECTION_NONE;
+    size_t line_capacity = WG_CONFIG_INITIAL_LINES, peer_capacity = WG_CONFIG_INITIAL_PEERS;
+    char *current, *end;
+
+    memset(config, 0, sizeof (struct WgConfig));
+    config->lines = (struct WgConfigLine *) malloc(line_capacity * sizeof (struct WgConfigLine));
+    config->peers = (struct WgConfigPeer *) malloc(peer_capacity * sizeof (struct WgConfigPeer));
+    if (config->lines == NULL || config->peers == NULL || !read_file(config, path))
+        goto FAIL;
+
+    end = config->text + config->length;
+    for (current = config->text; current < end;) {
+        char *newline = (char *) memchr(current, '\n', (size_t) (end - current));
+
+        if (newline == NULL)
+            newline = end;
+        *newline = '\0';
+        if (!add_line(config, &line_capacity, current) || !parse_line(config, &peer_capacity, &section))
+            goto FAIL;
+        current = newline + 1;
+    }
+    return true;
+
+    FAIL:
+    wg_config_destroy(config);
+    return false;
+}
+
+void wg_config_destroy(struct WgConfig *config) {
+    free(config->text);
+    free(config->lines);
+    free(config->peers);
+    memset(config, 0, sizeof (struct WgConfig));
+}
@@ -0,0 +1,91 @@
+#ifndef DHCP_V1_WG_CONFIG_H
+#define DHCP_V1_WG_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+/**
+ * Section a line of the config file belongs to
+ */
+enum WgConfigSection {
+    WG_CONFIG_SECTION_NONE,
+    WG_CONFIG_SECTION_INTERFACE,
+    WG_CONFIG_SECTION_PEER,
+    WG_CONFIG_SECTION_OTHER
+};
+
+/**
+ * Keys the server looks at, every other "Key = value" line is WG_CONFIG_KEY_OTHER
+ */
+enum WgConfigKey {
+    WG_CONFIG_KEY_NONE,
+    WG_CONFIG_KEY_OTHER,
+    WG_CONFIG_KEY_ADDRESS,
+    WG_CONFIG_KEY_AUTO_CONFIGURABLE,
+    WG_CONFIG_KEY_SAVE_CONFIG,
+    WG_CONFIG_KEY_PUBLIC_KEY,
+    WG_CONFIG_KEY_ALLOWED_IPS,
+    WG_CONFIG_KEY_ENDPOINT
+};
+
+/**
+ * WgConfigLine structure, one line of the config file, trimmed
+ *  - key - *char: key of a "Key = value" line, otherwise the whole line: a section header, a comment, a blank line or
+ *          anything the server does not understand
+ *  - value - *char: value of a "Key = value" line, NULL for other lines
+ *  - kind - WgConfigKey: key of the line, WG_CONFIG_KEY_NONE when value is NULL
+ *  - section - WgConfigSection: section the line belongs to, a section header belongs to the section it opens
+ */
+struct WgConfigLine {
+    char *key;
+    char *value;
+    enum WgConfigKey kind;
+    enum WgConfigSection section;
+};
+
+/**
+ * WgConfigPeer structure, a [Peer] section; values point in the text of the config, NULL when absent
+ *  - public_key - *char
+ *  - allowed_ips - *char
+ *  - endpoint - *char: host:port as written
+ *  - line - size_t: index of the [Peer] line
+ */
+struct WgConfigPeer {
+    const char *public_key;
+    const char *allowed_ips;
+    const char *endpoint;
+    size_t line;
+};
+
+/**
+ * WgConfig structure, a wg-quick config file read once and split in lines in place. Every component reads it from
+ * here instead of reopening the file.
+ *  - text - *char: content of the file, lines and values are NUL terminated in it
+ *  - length - size_t: length of the file
+ *  - lines - *WgConfigLine: lines of the file, in order
+ *  - line_count - size_t: number of lines
+ *  - peers - *WgConfigPeer: [Peer] sections, in order
+ *  - peer_count - size_t: number of [Peer] sections
+ *  - auto_configurable - bool: True, if the [Interface] section asks for the DHCP server
+ *  - has_address - bool: True, if the [Interface] section has an address
+ *  - address - in6_addr: first address of the [Interface] section, IPv4-mapped for IPv4
+ *  - prefix_length - int: mask of that address
+ */
+struct WgConfig {
+    char *text;
+    size_t length;
+    struct WgConfigLine *lines;
+    size_t line_count;
+    struct WgConfigPeer *peers;
+    size_t peer_count;
+    bool auto_configurable;
+    bool has_address;
+    struct in6_addr address;
+    int prefix_length;
+};
+
+bool wg_config_load(struct WgConfig *config, const char *path);
+void wg_config_destroy(struct WgConfig *config);
+
+#endif //DHCP_V1_WG_CONFIG_H